@@ -0,0 +1,60 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Host benchmarks of the firmware modules that don't need the Pico SDK (see bench/Makefile).
+// The times are measured on the host: they compare two implementations, they are not the times
+// of the RP2040. On x86 the unit is the cycle of the time stamp counter, elsewhere the nanosecond.
+#if defined(__x86_64__) || defined(__i386__)
+#define BENCH_UNIT                          "cycles"
+#else
+#define BENCH_UNIT                          "ns"
+#endif
+
+#define BENCH_SEED                          0x57544C42  // "WTLB": the runs are reproducible
+
+/*
+ * Function: bench_ticks()
+ * Description: This function reads the time stamp counter (x86) or the monotonic clock (ns).
+ */
+static inline uint64_t bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*
+ * Function: bench_rand()
+ * Description: This function returns a pseudo random number (xorshift32): the same sequence on every host.
+ */
+static inline uint32_t bench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/*
+ * Function: bench_range()
+ * Description: This function returns a pseudo random number in [min, max].
+ */
+static inline int32_t bench_range(uint32_t *state, int32_t min, int32_t max)
+{
+    return min + (int32_t)(bench_rand(state) % (uint32_t)(max - min + 1));
+}
+
+#endif // BENCH_H
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/wlt_fmt.h"
+#include "bench.h"
+
+// Formatter (wlt_fmt.c) against snprintf: the same text for BENCH_FMT_VALUES random values of each
+// directive used by the firmware, and the time of a call. The readings are hundredths, snprintf
+// gets them as double (what the firmware did before the formatter).
+#define BENCH_FMT_VALUES                    200000
+#define BENCH_FMT_BUF_LEN                   96
+// same template as API_INFO_REPLY (include/wlt_tcp.h)
+#define BENCH_FMT_INFO                      "{\"T\":%.2f,\"TF\":\"%s\",\"H\":%.2f,\"G\":%u}"
+
+typedef enum {
+    BENCH_FMT_CENTI,                    // %.2f, range of the readings
+    BENCH_FMT_CENTI_WIDE,               // %.2f, range of an int32_t
+    BENCH_FMT_TENTHS,                   // %.1f
+    BENCH_FMT_INT,                      // %d
+    BENCH_FMT_UINT,                     // %u
+    BENCH_FMT_HEX,                      // %03x (chunk headers)
+    BENCH_FMT_INFO_JSON,                // reply of /api/v1/info
+    BENCH_FMT_CASES
+} bench_fmt_case_t;
+
+static const char *const bench_fmt_names[BENCH_FMT_CASES] = {
+    "%.2f reading", "%.2f int32", "%.1f", "%d", "%u", "%03x", "info JSON"
+};
+
+static int32_t bench_values[BENCH_FMT_VALUES][2];
+
+/*
+ * Function: bench_fmt_one()
+ * Description: This function formats a value with the formatter of the firmware.
+ */
+static int bench_fmt_one(bench_fmt_case_t c, char *buf, size_t max, const int32_t *v)
+{
+    switch (c) {
+        case BENCH_FMT_CENTI:
+        case BENCH_FMT_CENTI_WIDE:
+            return fmt_format(buf, max, "%.2f", v[0]);
+        case BENCH_FMT_TENTHS:
+            return fmt_format(buf, max, "%.1f", v[0]);
+        case BENCH_FMT_INT:
+            return fmt_format(buf, max, "%d", v[0]);
+        case BENCH_FMT_UINT:
+            return fmt_format(buf, max, "%u", (unsigned int)v[0]);
+        case BENCH_FMT_HEX:
+            return fmt_format(buf, max, "%03x", (unsigned int)v[0]);
+        case BENCH_FMT_INFO_JSON:
+        default:
+            return fmt_format(buf, max, BENCH_FMT_INFO, v[0], (v[1] & 1) ? "F" : "C", v[1], (unsigned int)v[1]);
+    }
+}
+
+/*
+ * Function: bench_snprintf_one()
+ * Description: This function formats a value with snprintf.
+ */
+static int bench_snprintf_one(bench_fmt_case_t c, char *buf, size_t max, const int32_t *v)
+{
+    switch (c) {
+        case BENCH_FMT_CENTI:
+        case BENCH_FMT_CENTI_WIDE:
+            return snprintf(buf, max, "%.2f", v[0] / 100.0);
+        case BENCH_FMT_TENTHS:
+            return snprintf(buf, max, "%.1f", v[0] / 10.0);
+        case BENCH_FMT_INT:
+            return snprintf(buf, max, "%d", v[0]);
+        case BENCH_FMT_UINT:
+            return snprintf(buf, max, "%u", (unsigned int)v[0]);
+        case BENCH_FMT_HEX:
+            return snprintf(buf, max, "%03x", (unsigned int)v[0]);
+        case BENCH_FMT_INFO_JSON:
+        default:
+            return snprintf(buf, max, BENCH_FMT_INFO, v[0] / 100.0, (v[1] & 1) ? "F" : "C", v[1] / 100.0, (unsigned int)v[1]);
+    }
+}
+
+/*
+ * Function: bench_fmt_fill()
+ * Description: This function generates the random values of a case.
+ */
+static void bench_fmt_fill(bench_fmt_case_t c, uint32_t *seed)
+{
+    for (int i = 0; i < BENCH_FMT_VALUES; i++) {
+        switch (c) {
+            case BENCH_FMT_CENTI:
+                bench_values[i][0] = bench_range(seed, -4000, 12500);
+                break;
+            case BENCH_FMT_TENTHS:
+                bench_values[i][0] = bench_range(seed, -100000, 100000);
+                break;
+            case BENCH_FMT_HEX:
+                bench_values[i][0] = bench_range(seed, 0, 0xFFFF);
+                break;
+            case BENCH_FMT_INFO_JSON:
+                bench_values[i][0] = bench_range(seed, -4000, 12500);
+                bench_values[i][1] = bench_range(seed, 0, 10000);
+                break;
+            default:
+                bench_values[i][0] = (int32_t)bench_rand(seed);
+                break;
+        }
+    }
+}
+
+/*
+ * Function: bench_fmt_check()
+ * Description: This function compares the text and the length of the two implementations, with a
+ * buffer large enough and with a truncated one (snprintf semantic).
+ * It returns the number of values with a different result.
+ */
+static int bench_fmt_check(bench_fmt_case_t c, uint32_t *seed)
+{
+    char a[BENCH_FMT_BUF_LEN];
+    char b[BENCH_FMT_BUF_LEN];
+    int errors = 0;
+
+    for (int i = 0; i < BENCH_FMT_VALUES; i++) {
+        size_t max = (i & 1) ? sizeof(a) : (size_t)(bench_rand(seed) % 12);
+        memset(a, 'x', sizeof(a));
+        memset(b, 'x', sizeof(b));
+        int la = bench_fmt_one(c, a, max, bench_values[i]);
+        int lb = bench_snprintf_one(c, b, max, bench_values[i]);
+        if ((la != lb) || (memcmp(a, b, sizeof(a)) != 0)) {
+            if (errors++ < 5) {
+                printf("  %s: value %d max %u: fmt \"%.*s\" (%d), snprintf \"%.*s\" (%d)\n",
+                    bench_fmt_names[c], bench_values[i][0], (unsigned int)max,
+                    (int)((max > 0) ? strnlen(a, max) : 0), a, la, (int)((max > 0) ? strnlen(b, max) : 0), b, lb);
+            }
+        }
+    }
+    return errors;
+}
+
+/*
+ * Function: bench_fmt_time()
+ * Description: This function measures the time of the calls of an implementation.
+ * It returns the ticks per call.
+ */
+static double bench_fmt_time(bench_fmt_case_t c, int (*format)(bench_fmt_case_t, char *, size_t, const int32_t *))
+{
+    char buf[BENCH_FMT_BUF_LEN];
+    volatile int sink = 0;
+
+    uint64_t start = bench_ticks();
+    for (int i = 0; i < BENCH_FMT_VALUES; i++) {
+        sink += format(c, buf, sizeof(buf), bench_values[i]);
+    }
+    uint64_t ticks = bench_ticks() - start;
+    (void)sink;
+    return (double)ticks / BENCH_FMT_VALUES;
+}
+
+int main(void)
+{
+    uint32_t seed = BENCH_SEED;
+    int failed = 0;
+
+    printf("fmt_format() vs snprintf, %d random values per case (%s per call)\n", BENCH_FMT_VALUES, BENCH_UNIT);
+    printf("%-14s %10s %10s %10s %7s\n", "case", "mismatch", "fmt", "snprintf", "ratio");
+    for (int c = 0; c < BENCH_FMT_CASES; c++) {
+        bench_fmt_fill(c, &seed);
+        int errors = bench_fmt_check(c, &seed);
+        double t_fmt = bench_fmt_time(c, bench_fmt_one);
+        double t_snprintf = bench_fmt_time(c, bench_snprintf_one);
+        printf("%-14s %10d %10.1f %10.1f %6.2fx\n", bench_fmt_names[c], errors, t_fmt, t_snprintf, t_snprintf / t_fmt);
+        failed |= (errors != 0);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include "include/wlt_fmt.h"
+
+// Code size of the formatter against snprintf: the same reply of /api/v1/info is built with one or
+// the other (BENCH_SNPRINTF) in a static executable, bench/Makefile compares the two sizes.
+// The text is written with write(): only the formatter under test is linked.
+#ifdef BENCH_SNPRINTF
+#include <stdio.h>
+#endif
+
+int main(int argc, char **argv)
+{
+    char buf[64];
+    int32_t t = (argc > 1) ? atoi(argv[1]) : 2150;
+    int32_t h = (argc > 2) ? atoi(argv[2]) : 4575;
+    int len;
+
+#ifdef BENCH_SNPRINTF
+    len = snprintf(buf, sizeof(buf), "{\"T\":%.2f,\"TF\":\"%s\",\"H\":%.2f,\"G\":%u}\n", t / 100.0, "C", h / 100.0, 1u);
+#else
+    len = fmt_format(buf, sizeof(buf), "{\"T\":%.2f,\"TF\":\"%s\",\"H\":%.2f,\"G\":%u}\n", t, "C", h, 1u);
+#endif
+    if ((len > 0) && (len < (int)sizeof(buf))) {
+        return (write(STDOUT_FILENO, buf, len) == len) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    return EXIT_FAILURE;
+}
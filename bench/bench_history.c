@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/wlt_codec.h"
+#include "include/wlt_history.h"
+#include "bench.h"
+
+// Codec (wlt_codec.c) and history (wlt_history.c) on a synthetic series of readings: a random walk
+// of temperature and humidity polled every 10 s, with gaps (device off) and spikes (bad readings).
+// - codec: bytes per sample and time of encode / decode, the decoded series must be the encoded one
+// - history: every entry kept by each tier must be the aggregate computed by brute force from
+//   all the samples (the interval of a tier starts at a multiple of its resolution)
+#define BENCH_HIST_SAMPLES                  400000  // ~46 days at 10 s: all the tiers wrap
+#define BENCH_HIST_POLL_S                   10
+#define BENCH_HIST_CHANNELS                 2
+#define BENCH_HIST_LOOKUPS                  200000
+#define BENCH_HIST_PACKED_LEN               8       // uint32_t time, int16_t T, uint16_t H
+#define BENCH_HIST_T_MIN                    (-4000) // range of the sensor (hundredths of degree)
+#define BENCH_HIST_T_MAX                    12500
+
+typedef struct bench_sample {
+    uint32_t ts;
+    int32_t t;
+    int32_t h;
+} bench_sample_t;
+
+static bench_sample_t bench_samples[BENCH_HIST_SAMPLES];
+static wlt_codec_block_t bench_blocks[BENCH_HIST_SAMPLES / 8];
+
+/*
+ * Function: bench_hist_series()
+ * Description: This function generates the readings (hundredths of degree and of %RH).
+ */
+static void bench_hist_series(uint32_t *seed)
+{
+    uint32_t ts = 5;
+    int32_t t = 2300;
+    int32_t h = 4500;
+
+    for (int i = 0; i < BENCH_HIST_SAMPLES; i++) {
+        ts += (bench_rand(seed) % 50 == 0) ? BENCH_HIST_POLL_S + bench_range(seed, 0, 400) : BENCH_HIST_POLL_S;
+        t += bench_range(seed, -3, 3);
+        h += bench_range(seed, -8, 8);
+        t = (t < BENCH_HIST_T_MIN) ? BENCH_HIST_T_MIN : ((t > BENCH_HIST_T_MAX) ? BENCH_HIST_T_MAX : t);
+        h = (h < 0) ? 0 : ((h > 10000) ? 10000 : h);
+        bench_samples[i].ts = ts;
+        bench_samples[i].t = (bench_rand(seed) % 1000 == 0) ? BENCH_HIST_T_MIN : t;
+        bench_samples[i].h = h;
+    }
+}
+
+/*
+ * Function: bench_codec()
+ * Description: This function encodes the series in blocks, decodes it and compares the two.
+ * It returns the number of samples decoded with a different value.
+ */
+static int bench_codec(void)
+{
+    wlt_codec_state_t state;
+    int32_t values[BENCH_HIST_CHANNELS];
+    int blocks = 0;
+    uint64_t bytes = 0;
+    int errors = 0;
+
+    uint64_t start = bench_ticks();
+    wlt_codec_begin(&bench_blocks[0], &state, BENCH_HIST_CHANNELS, 0, bench_samples[0].ts);
+    for (int i = 0; i < BENCH_HIST_SAMPLES; i++) {
+        values[0] = bench_samples[i].t;
+        values[1] = bench_samples[i].h;
+        if (!wlt_codec_append(&bench_blocks[blocks], &state, bench_samples[i].ts, values)) {
+            blocks++;
+            wlt_codec_begin(&bench_blocks[blocks], &state, BENCH_HIST_CHANNELS, i, bench_samples[i].ts);
+            wlt_codec_append(&bench_blocks[blocks], &state, bench_samples[i].ts, values);
+        }
+    }
+    blocks++;
+    uint64_t encode = bench_ticks() - start;
+
+    int n = 0;
+    start = bench_ticks();
+    for (int b = 0; b < blocks; b++) {
+        uint32_t ts;
+        wlt_codec_rewind(&bench_blocks[b], &state, BENCH_HIST_CHANNELS);
+        while (wlt_codec_next(&bench_blocks[b], &state, &ts, values)) {
+            if ((n >= BENCH_HIST_SAMPLES) || (ts != bench_samples[n].ts) ||
+                (values[0] != bench_samples[n].t) || (values[1] != bench_samples[n].h)) {
+                errors++;
+            }
+            n++;
+        }
+    }
+    uint64_t decode = bench_ticks() - start;
+    for (int b = 0; b < blocks; b++) {
+        bytes += bench_blocks[b].len;
+    }
+    errors += (n != BENCH_HIST_SAMPLES) ? 1 : 0;
+
+    printf("codec: %d samples in %d blocks of %d bytes, %d errors\n", BENCH_HIST_SAMPLES, blocks, WLT_CODEC_BLOCK_BYTES, errors);
+    printf("  %.2f bytes/sample encoded, %.2f with the block headers (%d packed)\n",
+        (double)bytes / BENCH_HIST_SAMPLES, (double)blocks * sizeof(wlt_codec_block_t) / BENCH_HIST_SAMPLES, BENCH_HIST_PACKED_LEN);
+    printf("  encode %.1f, decode %.1f %s/sample\n",
+        (double)encode / BENCH_HIST_SAMPLES, (double)decode / BENCH_HIST_SAMPLES, BENCH_UNIT);
+    return errors;
+}
+
+/*
+ * Function: bench_hist_mean()
+ * Description: This function divides with rounding to the nearest (half away from zero).
+ */
+static int32_t bench_hist_mean(int64_t sum, int64_t n)
+{
+    return (int32_t)((sum >= 0) ? (sum + n / 2) / n : -((-sum + n / 2) / n));
+}
+
+/*
+ * Function: bench_hist_expected()
+ * Description: This function computes by brute force the aggregate of an interval of samples.
+ */
+static void bench_hist_expected(int first, int last, uint32_t start, wlt_hist_agg_t *agg)
+{
+    int64_t t_sum = 0;
+    int64_t h_sum = 0;
+
+    memset(agg, 0, sizeof(*agg));
+    agg->ts = start;
+    agg->t_min = agg->t_max = bench_samples[first].t;
+    agg->h_min = agg->h_max = bench_samples[first].h;
+    for (int i = first; i <= last; i++) {
+        t_sum += bench_samples[i].t;
+        h_sum += bench_samples[i].h;
+        agg->t_min = (bench_samples[i].t < agg->t_min) ? bench_samples[i].t : agg->t_min;
+        agg->t_max = (bench_samples[i].t > agg->t_max) ? bench_samples[i].t : agg->t_max;
+        agg->h_min = (bench_samples[i].h < agg->h_min) ? bench_samples[i].h : agg->h_min;
+        agg->h_max = (bench_samples[i].h > agg->h_max) ? bench_samples[i].h : agg->h_max;
+    }
+    agg->count = (last - first + 1 > UINT16_MAX) ? UINT16_MAX : (uint16_t)(last - first + 1);
+    agg->t_mean = bench_hist_mean(t_sum, last - first + 1);
+    agg->h_mean = bench_hist_mean(h_sum, last - first + 1);
+}
+
+/*
+ * Function: bench_hist_equal()
+ * Description: This function compares two aggregates field by field (not the padding).
+ */
+static bool bench_hist_equal(const wlt_hist_agg_t *a, const wlt_hist_agg_t *b)
+{
+    return (a->ts == b->ts) && (a->count == b->count) &&
+           (a->t_min == b->t_min) && (a->t_max == b->t_max) && (a->t_mean == b->t_mean) &&
+           (a->h_min == b->h_min) && (a->h_max == b->h_max) && (a->h_mean == b->h_mean);
+}
+
+/*
+ * Function: bench_hist_check()
+ * Description: This function compares the entries kept by a tier with the brute force aggregates:
+ * the sequence number of an entry is the index of its interval from the first sample.
+ * It returns the number of entries with a different value.
+ */
+static int bench_hist_check(int tier)
+{
+    uint32_t res = wlt_history_res(tier);
+    uint32_t first = wlt_history_first(tier);
+    uint32_t end = wlt_history_end(tier);
+    uint32_t seq = 0;
+    int errors = 0;
+
+    for (int i = 0; i < BENCH_HIST_SAMPLES; seq++) {
+        wlt_hist_agg_t expected;
+        wlt_hist_agg_t agg = { 0 };
+        int last = i;
+        uint32_t start = bench_samples[i].ts;
+        if (res > 0) {
+            start -= start % res;
+            while ((last + 1 < BENCH_HIST_SAMPLES) && (bench_samples[last + 1].ts - start < res)) {
+                last++;
+            }
+        }
+        if (seq >= first) {
+            bench_hist_expected(i, last, start, &expected);
+            if (!wlt_history_get(tier, seq, &agg) || !bench_hist_equal(&agg, &expected)) {
+                if (errors++ < 5) {
+                    printf("  tier %d entry %u: ts %u count %u T %d/%d/%d H %u/%u/%u, expected ts %u count %u T %d/%d/%d H %u/%u/%u\n",
+                        tier, seq, agg.ts, agg.count, agg.t_min, agg.t_max, agg.t_mean, agg.h_min, agg.h_max, agg.h_mean,
+                        expected.ts, expected.count, expected.t_min, expected.t_max, expected.t_mean,
+                        expected.h_min, expected.h_max, expected.h_mean);
+                }
+            }
+        }
+        i = last + 1;
+    }
+    if (seq != end) {
+        printf("  tier %d: %u entries, %u expected\n", tier, end, seq);
+        errors++;
+    }
+    return errors;
+}
+
+/*
+ * Function: bench_history()
+ * Description: This function adds the series to the history, checks the tiers and measures
+ * the time of an add and of the read of an entry.
+ * It returns the number of errors.
+ */
+static int bench_history(uint32_t *seed)
+{
+    static const int blocks[WLT_HIST_TIERS] = { WLT_HIST_RAW_BLOCKS, WLT_HIST_1M_BLOCKS, WLT_HIST_15M_BLOCKS };
+    int errors = 0;
+
+    uint64_t start = bench_ticks();
+    for (int i = 0; i < BENCH_HIST_SAMPLES; i++) {
+        wlt_history_add(bench_samples[i].ts, bench_samples[i].t, bench_samples[i].h);
+    }
+    uint64_t add = bench_ticks() - start;
+    printf("history: %d samples, add %.1f %s/sample\n", BENCH_HIST_SAMPLES, (double)add / BENCH_HIST_SAMPLES, BENCH_UNIT);
+
+    for (int tier = 0; tier < WLT_HIST_TIERS; tier++) {
+        uint32_t first = wlt_history_first(tier);
+        uint32_t entries = wlt_history_end(tier) - first;
+        wlt_hist_agg_t agg;
+        volatile uint32_t sink = 0;
+
+        start = bench_ticks();
+        for (int k = 0; k < BENCH_HIST_LOOKUPS; k++) {
+            if (wlt_history_get(tier, first + bench_rand(seed) % entries, &agg)) {
+                sink += agg.count;
+            }
+        }
+        uint64_t get = bench_ticks() - start;
+        (void)sink;
+
+        int tier_errors = bench_hist_check(tier);
+        errors += tier_errors;
+        printf("  tier %5us: %6u entries kept, %5.2f bytes/entry, get %.1f %s, %d errors\n",
+            wlt_history_res(tier), entries, (double)blocks[tier] * sizeof(wlt_codec_block_t) / entries,
+            (double)get / BENCH_HIST_LOOKUPS, BENCH_UNIT, tier_errors);
+    }
+    return errors;
+}
+
+/*
+ * Function: bench_hist_time()
+ * Description: This function checks that the device time goes on after 49.7 days of uptime (the
+ * milliseconds since boot don't fit in 32 bits anymore).
+ * It returns the number of errors.
+ */
+static int bench_hist_time(void)
+{
+    uint64_t wrap_ms = (uint64_t)UINT32_MAX + 1;
+
+    if ((wlt_history_time(wrap_ms + 1000) != wlt_history_time(wrap_ms - 1000) + 2) ||
+        (wlt_history_time(wrap_ms) != wlt_history_time(0) + (uint32_t)(wrap_ms / 1000))) {
+        printf("device time: wraps after 49.7 days\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    uint32_t seed = BENCH_SEED;
+    int errors;
+
+    bench_hist_series(&seed);
+    errors = bench_codec();
+    errors += bench_history(&seed);
+    errors += bench_hist_time();
+    return (errors != 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/wlt.h"
+#include "include/wlt_global.h"
+#include "include/wlt_schema.h"
+#include "bench.h"
+
+wlt_error_t parse_post_body(char *body, size_t content_length);
+
+// Lookup of the parameters of the API in the schema (wlt_schema.c): the binary searches of
+// wlt_schema_find_group() / wlt_schema_find_field() against the loops of strcmp on the lists of keys
+// that the parser used before (one list per group, in the order of the enums, every key compared).
+// The keys are the ones of a POST with all the parameters, plus some unknown ones.
+// The checks of the values that depend on other fields of the item (TH of an output and its DT)
+// are done too, and through the parser of the API (wlt_api.c) a rejected item must leave the
+// configuration as it was.
+#define BENCH_SCHEMA_LOOKUPS                1000000
+#define BENCH_SCHEMA_OLD_GROUPS             3
+
+typedef struct bench_schema_group {
+    const char *key;
+    const char *const *keys;
+    int count;
+} bench_schema_group_t;
+
+// globals of the firmware (wlt.c)
+wlt_run_time_config_t *prtconfig;
+wlt_config_data_t *pconfig;
+
+static wlt_run_time_config_t bench_rt_config;
+
+// lists of keys of the old parser (wlt_api.c)
+static const char *const bench_old_wifi[] = { "DEVNAME", "MODE", "SSID", "PASS" };
+static const char *const bench_old_settings[] = { "TF", "OF", "PT", "TH", "WT" };
+static const char *const bench_old_outputs[] = { "GPIO", "DT", "TH", "TR" };
+
+static const bench_schema_group_t bench_old_groups[BENCH_SCHEMA_OLD_GROUPS] = {
+    { "WIFI", bench_old_wifi, 4 },
+    { "SETTINGS", bench_old_settings, 5 },
+    { "OUTS", bench_old_outputs, 4 },
+};
+
+// pairs group / key looked up (NULL key: the group only)
+static const char *const bench_keys[][2] = {
+    { "WIFI", "DEVNAME" }, { "WIFI", "MODE" }, { "WIFI", "SSID" }, { "WIFI", "PASS" }, { "WIFI", "IP" },
+    { "SETTINGS", "TF" }, { "SETTINGS", "OF" }, { "SETTINGS", "PT" }, { "SETTINGS", "TH" },
+    { "SETTINGS", "WT" }, { "SETTINGS", "XX" },
+    { "OUTS", "GPIO" }, { "OUTS", "DT" }, { "OUTS", "TH" }, { "OUTS", "TR" },
+    { "DATA", NULL },
+};
+
+#define BENCH_SCHEMA_KEYS                   ((int)(sizeof(bench_keys) / sizeof(bench_keys[0])))
+
+/*
+ * Function: bench_old_find()
+ * Description: This function looks for a group and a key as the old parser did: a loop of strcmp on
+ * the groups, then on all the keys of the group.
+ * It returns the index of the key in its list, -1 if the group is unknown, -2 if the key is unknown.
+ */
+static int bench_old_find(const char *group_key, const char *key)
+{
+    const bench_schema_group_t *group = NULL;
+    int found = -2;
+
+    for (int i = 0; i < BENCH_SCHEMA_OLD_GROUPS; i++) {
+        if (strcmp(group_key, bench_old_groups[i].key) == 0) {
+            group = &bench_old_groups[i];
+        }
+    }
+    if (group == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < group->count; i++) {
+        if (strcmp(key, group->keys[i]) == 0) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+/*
+ * Function: bench_schema_check_lookup()
+ * Description: This function checks that the schema finds the same groups and keys as the old lists.
+ * It returns the number of differences.
+ */
+static int bench_schema_check_lookup(void)
+{
+    int errors = 0;
+
+    for (int k = 0; k < BENCH_SCHEMA_KEYS; k++) {
+        const wlt_schema_group_t *group = wlt_schema_find_group(bench_keys[k][0]);
+        const wlt_schema_field_t *field = NULL;
+        int old = bench_old_find(bench_keys[k][0], (bench_keys[k][1] != NULL) ? bench_keys[k][1] : "");
+
+        if ((group != NULL) && (bench_keys[k][1] != NULL)) {
+            field = wlt_schema_find_field(group, bench_keys[k][1]);
+        }
+        if (((group == NULL) != (old == -1)) || ((field == NULL) != (old < 0)) ||
+            ((field != NULL) && (strcmp(field->key, bench_keys[k][1]) != 0))) {
+            printf("  %s.%s: schema %s, old lists %d\n", bench_keys[k][0], bench_keys[k][1],
+                (field != NULL) ? field->key : "-", old);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/*
+ * Function: bench_schema_lookup()
+ * Description: This function measures the two lookups on random keys of the list.
+ */
+static void bench_schema_lookup(uint32_t *seed)
+{
+    static int order[BENCH_SCHEMA_LOOKUPS];
+    volatile uintptr_t sink = 0;
+
+    for (int i = 0; i < BENCH_SCHEMA_LOOKUPS; i++) {
+        order[i] = bench_rand(seed) % BENCH_SCHEMA_KEYS;
+    }
+
+    uint64_t start = bench_ticks();
+    for (int i = 0; i < BENCH_SCHEMA_LOOKUPS; i++) {
+        const char *const *pair = bench_keys[order[i]];
+        const wlt_schema_group_t *group = wlt_schema_find_group(pair[0]);
+        if ((group != NULL) && (pair[1] != NULL)) {
+            sink += (uintptr_t)wlt_schema_find_field(group, pair[1]);
+        }
+    }
+    uint64_t schema = bench_ticks() - start;
+
+    start = bench_ticks();
+    for (int i = 0; i < BENCH_SCHEMA_LOOKUPS; i++) {
+        const char *const *pair = bench_keys[order[i]];
+        sink += (uintptr_t)bench_old_find(pair[0], (pair[1] != NULL) ? pair[1] : "");
+    }
+    uint64_t old = bench_ticks() - start;
+    (void)sink;
+
+    printf("lookup of %d keys: schema %.1f, old lists %.1f %s/key (x%.2f)\n", BENCH_SCHEMA_LOOKUPS,
+        (double)schema / BENCH_SCHEMA_LOOKUPS, (double)old / BENCH_SCHEMA_LOOKUPS, BENCH_UNIT,
+        (double)old / (double)schema);
+}
+
+/*
+ * Function: bench_schema_output()
+ * Description: This function sets DT and TH of the first output (in this order or the reverse one)
+ * and checks the item as the API does.
+ * It returns true if the output is accepted.
+ */
+static bool bench_schema_output(const char *dt, const char *th, bool th_first)
+{
+    const wlt_schema_group_t *group = wlt_schema_find_group("OUTS");
+    wlt_error_t res;
+
+    memset(&bench_rt_config, 0, sizeof(bench_rt_config));
+    res = wlt_schema_set(prtconfig, group, 0, th_first ? "TH" : "DT", th_first ? th : dt);
+    if (res == WLT_SUCCESS) {
+        res = wlt_schema_set(prtconfig, group, 0, th_first ? "DT" : "TH", th_first ? dt : th);
+    }
+    if (res == WLT_SUCCESS) {
+        res = wlt_schema_check(prtconfig, group, 0);
+    }
+    return (res == WLT_SUCCESS);
+}
+
+/*
+ * Function: bench_schema_check_outputs()
+ * Description: This function checks the range of the threshold of an output for each data type.
+ * It returns the number of errors.
+ */
+static int bench_schema_check_outputs(void)
+{
+    static const struct {
+        const char *dt;
+        const char *th;
+        bool valid;
+    } cases[] = {
+        { "T", "-40.00", true }, { "T", "125", true }, { "T", "-40.01", false }, { "T", "125.01", false },
+        { "H", "0", true }, { "H", "95", true }, { "H", "100.00", true }, { "H", "-0.01", false },
+        { "H", "100.01", false }, { "H", "120", false },
+        { "P", "125", true }, { "P", "2147483647", false }, { "NULL", "-40", true },
+    };
+    int errors = 0;
+
+    printf("threshold of the outputs:\n");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        for (int th_first = 0; th_first < 2; th_first++) {
+            if (bench_schema_output(cases[i].dt, cases[i].th, th_first) != cases[i].valid) {
+                printf("  DT %s TH %s: %s expected\n", cases[i].dt, cases[i].th, cases[i].valid ? "valid" : "invalid");
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+/*
+ * Function: bench_schema_post()
+ * Description: This function sends a body to the parser of the API (the body is changed in place).
+ * It returns true if the parameters are accepted.
+ */
+static bool bench_schema_post(const char *body)
+{
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "%s", body);
+    return (parse_post_body(buf, strlen(buf)) == WLT_SUCCESS);
+}
+
+/*
+ * Function: bench_schema_check_api()
+ * Description: This function checks that the API applies an item only if it's valid: an output
+ * with a threshold out of the range of its data type leaves the previous values.
+ * It returns the number of errors.
+ */
+static int bench_schema_check_api(void)
+{
+    const outputs_t *output = &bench_rt_config.data.outputs[0];
+    int errors = 0;
+
+    printf("items rejected by the API:\n");
+    memset(&bench_rt_config, 0, sizeof(bench_rt_config));
+    if (!bench_schema_post("{\"OUTS\":[{\"GPIO\":\"15\",\"DT\":\"T\",\"TH\":\"25.50\",\"TR\":\"H\"}]}") ||
+        (output->gpio_num != 15) || (output->data_type != WLT_DATA_TYPE_TEMP) || (output->threshold != 2550)) {
+        printf("  valid output not applied\n");
+        errors++;
+    }
+    if (bench_schema_post("{\"OUTS\":[{\"GPIO\":\"16\",\"DT\":\"H\",\"TH\":\"120\"}]}") ||
+        (output->gpio_num != 15) || (output->data_type != WLT_DATA_TYPE_TEMP) || (output->threshold != 2550)) {
+        printf("  output with TH out of the range of DT: GPIO %u DT %d TH %d\n",
+            output->gpio_num, output->data_type, (int)output->threshold);
+        errors++;
+    }
+    if (bench_schema_post("{\"SETTINGS\":{\"PT\":\"30\",\"TF\":\"K\"}}") ||
+        (bench_rt_config.data.settings.options.poll_time != 0)) {
+        printf("  settings with an invalid TF: PT %u\n", (unsigned int)bench_rt_config.data.settings.options.poll_time);
+        errors++;
+    }
+    return errors;
+}
+
+int main(void)
+{
+    uint32_t seed = BENCH_SEED;
+    int errors;
+
+    prtconfig = &bench_rt_config;
+    errors = bench_schema_check_lookup();
+    bench_schema_lookup(&seed);
+    errors += bench_schema_check_outputs();
+    errors += bench_schema_check_api();
+    printf("%s\n", (errors == 0) ? "ok" : "FAILED");
+    return (errors != 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
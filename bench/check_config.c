@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/wlt.h"
+#include "include/wlt_global.h"
+#include "include/wlt_schema.h"
+#include "include/wlt_config.h"
+#include "sim/sim_eeprom.h"
+
+// Write-behind of the configuration (wlt_config.c) on the simulated EEPROM: the API changes
+// go through wlt_schema_set() and wlt_update_and_save_config() as in the server, the main loop
+// is simulated by check_run_ms() (wlt_check_config_commit() and i2c_eeprom_process() every ms).
+// What is saved is read back from the slots of the EEPROM.
+#define CHECK(cond)                         check_assert((cond), #cond, __LINE__)
+
+// globals of the firmware (wlt.c)
+wlt_run_time_config_t *prtconfig;
+wlt_config_data_t *pconfig;
+uint32_t wlt_sample_gen = 0;
+
+static wlt_run_time_config_t check_rt_config;
+static wlt_config_data_t check_config;
+static uint32_t check_core1_updates = 0;
+static int check_failed = 0;
+
+/*
+ * Function: wlt_core1_send_config()
+ * Description: This function replaces the queue to core 1: it counts the updates.
+ */
+void wlt_core1_send_config(const wlt_data_t *data)
+{
+    check_core1_updates++;
+}
+
+/*
+ * Function: check_assert()
+ * Description: This function reports a failed check.
+ */
+static void check_assert(bool ok, const char *cond, int line)
+{
+    if (!ok) {
+        printf("  FAILED line %d: %s\n", line, cond);
+        check_failed++;
+    }
+}
+
+/*
+ * Function: check_run_ms()
+ * Description: This function runs the main loop for ms milliseconds of simulated time.
+ */
+static void check_run_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        sim_time_advance_us(1000);
+        wlt_check_config_commit();
+        i2c_eeprom_process();
+    }
+}
+
+/*
+ * Function: check_set()
+ * Description: This function sets a parameter as the API does (group SETTINGS or WIFI).
+ */
+static void check_set(const char *group, const char *key, const char *value)
+{
+    wlt_error_t res = wlt_schema_set(prtconfig, wlt_schema_find_group(group), 0, key, value);
+    CHECK(res == WLT_SUCCESS);
+}
+
+/*
+ * Function: check_saved()
+ * Description: This function reads the newest record of the two slots of the EEPROM.
+ * It returns its generation, 0 if no slot holds a record.
+ */
+static uint32_t check_saved(wlt_config_data_t *config)
+{
+    static const int slots[WLT_CONFIG_SLOTS] = { WLT_CONFIG_SLOT_A_ADDR, WLT_CONFIG_SLOT_B_ADDR };
+    uint32_t gen = 0;
+
+    for (int i = 0; i < WLT_CONFIG_SLOTS; i++) {
+        wlt_config_header_t header;
+        memcpy(&header, &sim_eeprom_mem[slots[i]], sizeof(header));
+        if ((header.magic == WLT_CONFIG_MAGIC) && (header.gen > gen)) {
+            gen = header.gen;
+            memcpy(config, &sim_eeprom_mem[slots[i] + sizeof(header)], sizeof(*config));
+        }
+    }
+    return gen;
+}
+
+/*
+ * Function: check_boot()
+ * Description: This function starts from an empty EEPROM and saves the first configuration.
+ */
+static void check_boot(void)
+{
+    wlt_config_data_t saved;
+
+    printf("boot: empty EEPROM, first save\n");
+    prtconfig = &check_rt_config;
+    pconfig = &check_config;
+    sim_eeprom_erase();
+    CHECK(wlt_config_read(pconfig) == EE_NOT_FOUND);
+    memset(prtconfig, 0, sizeof(*prtconfig));
+    check_set("WIFI", "DEVNAME", "boot");
+    check_set("SETTINGS", "PT", "10");
+    CHECK(wlt_commit_config() == EE_PENDING);
+    check_run_ms(100);
+    CHECK(check_saved(&saved) == 1);
+    CHECK(strcmp((char *)saved.devicename, "boot") == 0);
+}
+
+/*
+ * Function: check_dirty()
+ * Description: A persisted change is saved at the end of the quiet period, not before;
+ * a change to the same value doesn't mark the configuration dirty.
+ */
+static void check_dirty(void)
+{
+    wlt_config_data_t saved;
+    uint32_t writes = sim_eeprom_stats.page_writes;
+    uint32_t updates = check_core1_updates;
+
+    printf("dirty: saved after %d ms of quiet\n", WLT_CONFIG_COMMIT_DELAY_MS);
+    check_set("SETTINGS", "PT", "20");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, true) == WLT_CONFIG_DEFERRED);
+    CHECK(check_core1_updates == updates + 1);
+    check_run_ms(WLT_CONFIG_COMMIT_DELAY_MS - 1);
+    CHECK(sim_eeprom_stats.page_writes == writes);
+    CHECK(check_saved(&saved) == 1);
+    check_run_ms(100);
+    CHECK(check_saved(&saved) == 2);
+    CHECK(saved.settings.options.poll_time == 20);
+
+    writes = sim_eeprom_stats.page_writes;
+    check_set("SETTINGS", "PT", "20");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, true) == EE_SUCCESS);
+    check_run_ms(2 * WLT_CONFIG_COMMIT_DELAY_MS);
+    CHECK(sim_eeprom_stats.page_writes == writes);
+}
+
+/*
+ * Function: check_quiet_period()
+ * Description: Every change restarts the quiet period: a burst of changes is a single write.
+ */
+static void check_quiet_period(void)
+{
+    wlt_config_data_t saved;
+    uint32_t gen = check_saved(&saved);
+    char name[8];
+
+    printf("quiet period: 10 changes, 1 s apart\n");
+    for (int i = 0; i < 10; i++) {
+        snprintf(name, sizeof(name), "burst%d", i);
+        check_set("WIFI", "DEVNAME", name);
+        CHECK(wlt_update_and_save_config(prtconfig, pconfig, true) == WLT_CONFIG_DEFERRED);
+        check_run_ms(1000);
+        CHECK(check_saved(&saved) == gen);
+    }
+    check_run_ms(WLT_CONFIG_COMMIT_DELAY_MS - 1000 - 1);
+    CHECK(check_saved(&saved) == gen);
+    check_run_ms(100);
+    CHECK(check_saved(&saved) == gen + 1);
+    CHECK(strcmp((char *)saved.devicename, "burst9") == 0);
+}
+
+/*
+ * Function: check_transient()
+ * Description: A change with persist=false is applied (core 1 gets it) but never saved by itself;
+ * wlt_commit_config() saves it, then there is nothing left to save.
+ */
+static void check_transient(void)
+{
+    wlt_config_data_t saved;
+    uint32_t gen = check_saved(&saved);
+    uint32_t writes = sim_eeprom_stats.page_writes;
+    uint32_t updates = check_core1_updates;
+
+    printf("transient: persist=false, then /api/v1/commit\n");
+    check_set("WIFI", "DEVNAME", "transient");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, false) == WLT_CONFIG_TRANSIENT);
+    CHECK(check_core1_updates == updates + 1);
+    check_run_ms(3 * WLT_CONFIG_COMMIT_DELAY_MS);
+    CHECK(sim_eeprom_stats.page_writes == writes);
+    CHECK(check_saved(&saved) == gen);
+    CHECK(strcmp((char *)saved.devicename, "burst9") == 0);
+
+    CHECK(wlt_commit_config() == EE_PENDING);
+    check_run_ms(100);
+    CHECK(check_saved(&saved) == gen + 1);
+    CHECK(strcmp((char *)saved.devicename, "transient") == 0);
+    CHECK(wlt_commit_config() == EE_SUCCESS);
+}
+
+/*
+ * Function: check_transient_then_persist()
+ * Description: A later persisted change saves the transient changes made before it; a commit
+ * during the quiet period saves at once and cancels the deferred write.
+ */
+static void check_transient_then_persist(void)
+{
+    wlt_config_data_t saved;
+    uint32_t gen = check_saved(&saved);
+    uint32_t writes;
+
+    printf("transient, then a persisted change\n");
+    check_set("WIFI", "DEVNAME", "later");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, false) == WLT_CONFIG_TRANSIENT);
+    check_set("SETTINGS", "PT", "30");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, true) == WLT_CONFIG_DEFERRED);
+    check_run_ms(WLT_CONFIG_COMMIT_DELAY_MS + 100);
+    CHECK(check_saved(&saved) == gen + 1);
+    CHECK(strcmp((char *)saved.devicename, "later") == 0);
+    CHECK(saved.settings.options.poll_time == 30);
+
+    printf("commit during the quiet period\n");
+    check_set("SETTINGS", "PT", "40");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, true) == WLT_CONFIG_DEFERRED);
+    check_run_ms(1000);
+    CHECK(wlt_commit_config() == EE_PENDING);
+    check_run_ms(100);
+    CHECK(check_saved(&saved) == gen + 2);
+    CHECK(saved.settings.options.poll_time == 40);
+    writes = sim_eeprom_stats.page_writes;
+    check_run_ms(2 * WLT_CONFIG_COMMIT_DELAY_MS);
+    CHECK(sim_eeprom_stats.page_writes == writes);
+}
+
+/*
+ * Function: check_write_error()
+ * Description: A record that the EEPROM fails to write is written again at the end of another
+ * quiet period.
+ */
+static void check_write_error(void)
+{
+    wlt_config_data_t saved;
+    uint32_t gen = check_saved(&saved);
+
+    printf("write error: written again after a quiet period\n");
+    check_set("SETTINGS", "PT", "50");
+    CHECK(wlt_update_and_save_config(prtconfig, pconfig, true) == WLT_CONFIG_DEFERRED);
+    sim_eeprom_fail_writes = 1;
+    check_run_ms(WLT_CONFIG_COMMIT_DELAY_MS + 100);
+    CHECK(sim_eeprom_fail_writes == 0);
+    CHECK(check_saved(&saved) == gen);
+    check_run_ms(WLT_CONFIG_COMMIT_DELAY_MS + 100);
+    CHECK(check_saved(&saved) == gen + 1);
+    CHECK(saved.settings.options.poll_time == 50);
+}
+
+/*
+ * Function: check_commit_busy()
+ * Description: A commit while a record is being written doesn't wait for the EEPROM (it's called
+ * by the network callbacks): the main loop saves it when the EEPROM is free.
+ */
+static void check_commit_busy(void)
+{
+    wlt_config_data_t saved;
+    uint32_t gen = check_saved(&saved);
+    uint64_t start;
+
+    printf("commit while the EEPROM is writing\n");
+    check_set("SETTINGS", "PT", "55");
+    CHECK(wlt_commit_config() == EE_PENDING);
+    CHECK(i2c_eeprom_busy());
+    check_set("SETTINGS", "PT", "60");
+    start = time_us_64();
+    CHECK(wlt_commit_config() == EE_PENDING);
+    CHECK(time_us_64() == start);
+    check_run_ms(100);
+    CHECK(check_saved(&saved) == gen + 2);
+    CHECK(saved.settings.options.poll_time == 60);
+}
+
+/*
+ * Function: check_reboot()
+ * Description: After a reboot the last saved configuration is loaded.
+ */
+static void check_reboot(void)
+{
+    wlt_config_data_t config;
+    wlt_run_time_config_t rt_config;
+
+    printf("reboot: the last configuration is loaded\n");
+    memset(&config, 0, sizeof(config));
+    memset(&rt_config, 0, sizeof(rt_config));
+    CHECK(wlt_config_read(&config) == EE_SUCCESS);
+    wlt_load_config(&rt_config, &config);
+    CHECK(strcmp((char *)rt_config.net_config.devicename, "later") == 0);
+    CHECK(rt_config.data.settings.options.poll_time == 60);
+}
+
+int main(void)
+{
+    wlt_config_stats_t stats;
+
+    check_boot();
+    check_dirty();
+    check_quiet_period();
+    check_transient();
+    check_transient_then_persist();
+    check_write_error();
+    check_commit_busy();
+    check_reboot();
+    wlt_config_get_stats(&stats);
+    printf("%u configurations written (%u pages, %u skipped), %u unchanged, %u EEPROM page writes\n",
+        stats.writes, stats.pages_written, stats.pages_skipped, stats.unchanged, sim_eeprom_stats.page_writes);
+    printf("%s\n", (check_failed == 0) ? "ok" : "FAILED");
+    return (check_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
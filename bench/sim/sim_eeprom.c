@@ -0,0 +1,124 @@
+#include "sim_eeprom.h"
+
+uint8_t sim_eeprom_mem[SIM_EEPROM_LEN];
+sim_eeprom_stats_t sim_eeprom_stats;
+int sim_eeprom_fail_writes = 0;
+
+static uint64_t sim_now_us = 0;         // simulated clock
+static uint64_t sim_busy_until = 0;     // end of the write cycle in progress
+static int sim_addr = 0;                // address counter of the EEPROM
+static uint32_t sim_seed = 0x45455032;  // duration of the write cycles
+
+static struct i2c_inst {
+    int dummy;
+} sim_i2c[2];
+
+i2c_inst_t *i2c0 = &sim_i2c[0];
+i2c_inst_t *i2c1 = &sim_i2c[1];
+
+/*
+ * Function: sim_eeprom_erase()
+ * Description: This function sets the EEPROM as it comes from the factory (all bytes 0xFF).
+ */
+void sim_eeprom_erase(void)
+{
+    memset(sim_eeprom_mem, 0xFF, sizeof(sim_eeprom_mem));
+}
+
+/*
+ * Function: sim_time_advance_us()
+ * Description: This function moves the simulated clock forward.
+ */
+void sim_time_advance_us(uint64_t us)
+{
+    sim_now_us += us;
+}
+
+absolute_time_t get_absolute_time(void)
+{
+    return sim_now_us;
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return sim_now_us + us;
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return sim_now_us + (uint64_t)ms * 1000;
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return sim_now_us >= t;
+}
+
+uint64_t time_us_64(void)
+{
+    return sim_now_us;
+}
+
+unsigned int i2c_init(i2c_inst_t *i2c, unsigned int baudrate)
+{
+    return baudrate;
+}
+
+void gpio_set_function(unsigned int gpio, int fn)
+{
+}
+
+void gpio_pull_up(unsigned int gpio)
+{
+}
+
+/*
+ * Function: i2c_write_timeout_us()
+ * Description: This function receives the address (2 bytes) and the data of a page write: the bytes
+ * after the end of the page wrap to its beginning, as in the 24LC256.
+ */
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, unsigned int timeout_us)
+{
+    sim_time_advance_us(SIM_EEPROM_BYTE_US * (len + 1));
+    if (sim_now_us < sim_busy_until) {
+        sim_eeprom_stats.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    if (len < 2) {
+        return (int)len;
+    }
+    if ((len > 2) && (sim_eeprom_fail_writes > 0)) {
+        sim_eeprom_fail_writes--;
+        sim_eeprom_stats.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    sim_addr = ((src[0] << 8) | src[1]) % SIM_EEPROM_LEN;
+    if (len > 2) {
+        int page = sim_addr & ~(SIM_EEPROM_PAGE_LEN - 1);
+        for (size_t i = 2; i < len; i++) {
+            sim_eeprom_mem[page + ((sim_addr - page + (int)i - 2) % SIM_EEPROM_PAGE_LEN)] = src[i];
+        }
+        sim_seed = sim_seed * 1103515245 + 12345;
+        sim_busy_until = sim_now_us + 3000 + (sim_seed >> 16) % 2000;
+        sim_eeprom_stats.page_writes++;
+    }
+    return (int)len;
+}
+
+/*
+ * Function: i2c_read_timeout_us()
+ * Description: This function reads from the address counter (sequential read).
+ */
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, unsigned int timeout_us)
+{
+    sim_time_advance_us(SIM_EEPROM_BYTE_US * (len + 1));
+    if (sim_now_us < sim_busy_until) {
+        sim_eeprom_stats.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = sim_eeprom_mem[sim_addr];
+        sim_addr = (sim_addr + 1) % SIM_EEPROM_LEN;
+    }
+    return (int)len;
+}
@@ -0,0 +1,26 @@
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <stdint.h>
+#include "sim_sdk.h"
+
+// Simulated 24LC256 on the I2C bus: a page write starts a write cycle of 3-5 ms, the EEPROM doesn't
+// acknowledge its address (NACK) until the cycle is over. Each transfer moves the simulated clock
+// by the time of its bytes at 400 kHz, so the busy waits of the driver end.
+#define SIM_EEPROM_LEN                      0x8000
+#define SIM_EEPROM_PAGE_LEN                 64
+#define SIM_EEPROM_BYTE_US                  25      // 9 bits at 400 kHz (rounded up)
+
+typedef struct sim_eeprom_stats {
+    uint32_t page_writes;               // page writes accepted
+    uint32_t nacks;                     // transfers refused during a write cycle
+} sim_eeprom_stats_t;
+
+extern uint8_t sim_eeprom_mem[SIM_EEPROM_LEN];
+extern sim_eeprom_stats_t sim_eeprom_stats;
+extern int sim_eeprom_fail_writes;      // next page writes refused (NACK), as a faulty EEPROM
+
+void sim_eeprom_erase(void);
+void sim_time_advance_us(uint64_t us);
+
+#endif // SIM_EEPROM_H
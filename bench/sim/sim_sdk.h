@@ -0,0 +1,62 @@
+#ifndef SIM_SDK_H
+#define SIM_SDK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Declarations of the Pico SDK and of lwIP used by the firmware modules built on the host by the
+// harnesses of bench/ (the headers pico/*.h, hardware/*.h and lwip/*.h of this directory include
+// this one). The functions are implemented by sim_eeprom.c: a simulated 24LC256 and a simulated
+// clock that goes on only when the harness moves it.
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t err_t;
+
+#define ERR_OK                              0
+#define ERR_MEM                             -1
+
+typedef struct ip4_addr {
+    u32_t addr;
+} ip_addr_t;
+
+struct pbuf {
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+struct tcp_pcb;
+
+// time (microseconds of the simulated clock)
+typedef uint64_t absolute_time_t;
+
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_us(uint64_t us);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+bool time_reached(absolute_time_t t);
+uint64_t time_us_64(void);
+static inline void tight_loop_contents(void) {}
+
+// I2C of the EEPROM
+#define PICO_OK                             0
+#define PICO_ERROR_GENERIC                  -1
+#define PICO_ERROR_TIMEOUT                  -2
+#define GPIO_FUNC_I2C                       3
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t *i2c0;
+extern i2c_inst_t *i2c1;
+
+unsigned int i2c_init(i2c_inst_t *i2c, unsigned int baudrate);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, unsigned int timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, unsigned int timeout_us);
+void gpio_set_function(unsigned int gpio, int fn);
+void gpio_pull_up(unsigned int gpio);
+
+#endif // SIM_SDK_H
@@ -8,6 +8,9 @@
 #include "general.h"
 #include "include/dht20.h"
 
+static volatile dht20_state_t dht20_state = DHT20_STATE_IDLE;
+static uint8_t dht20_loop;
+
 /*
  * Function: DHT20_init()
  * Check connection and verifiy if the sensor is inizialized
@@ -35,53 +38,127 @@ int DHT20_init(void)
 }
 
 /*
- * Function: DHT20_read_data()
- * Start measure procedere and ready the reply when the device is ready 
+ * Function: DHT20_crc8()
+ * CRC-8 of the measure (polynomial 0x31, initial value 0xFF)
  */
-int DHT20_read_data(float *temp, float *hum)
+static uint8_t DHT20_crc8(const uint8_t *data, size_t len)
 {
-    int ret = 0;
-    int temperature = 0;
-    int humidity = 0;
-    uint8_t buf[6] = {DHT20_READ,0,0,0,0,0};
-    uint8_t loop;
+    uint8_t crc = DHT20_CRC_INIT;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ DHT20_CRC_POLY) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/*
+ * Function: DHT20_alarm_callback()
+ * The conversion time is expired: the main loop can poll the sensor.
+ * It runs in the timer IRQ, the I2C transfers are left to DHT20_process().
+ */
+static int64_t DHT20_alarm_callback(alarm_id_t id, void *user_data)
+{
+    dht20_state = DHT20_STATE_POLL;
+    // no reschedule
+    return 0;
+}
+
+/*
+ * Function: DHT20_wait()
+ * Arm the alarm that ends the wait of the conversion
+ */
+static int DHT20_wait(void)
+{
+    // set the state before arming the alarm, the callback can run at once
+    dht20_state = DHT20_STATE_WAIT;
+    if (add_alarm_in_ms(DHT20_WAIT_MEAS_MS, DHT20_alarm_callback, NULL, true) < 0) {
+        printf("Unable to arm the DHT20 alarm\n");
+        dht20_state = DHT20_STATE_IDLE;
+        return DHT20_READ_ERROR;
+    }
+    return DHT20_READ_BUSY;
+}
 
-    // start measure
+/*
+ * Function: DHT20_start()
+ * Trigger a measure: the result is returned by DHT20_process() when it's ready
+ */
+int DHT20_start(void)
+{
+    uint8_t buf[3] = {DHT20_START_MEASURE, 0x33, 0x00};
+
+    if (dht20_state != DHT20_STATE_IDLE) {
+        return DHT20_READ_BUSY;
+    }
+    if (i2c_write_timeout_us(I2C_PORT_SENS, DHT20_I2C_ADDRESS, buf, sizeof(buf), false, DHT20_I2C_TIMEOUT_US) != sizeof(buf)) {
+        printf("Unable to trigger the DHT20 measure\n");
+        return DHT20_READ_ERROR;
+    }
+    dht20_loop = DTH20_WAIT_MEAS_LOOP;
+    return DHT20_wait();
+}
+
+/*
+ * Function: DHT20_process()
+ * Advance the acquisition, it's called from the main loop and never waits.
+ * When the measure is completed the values are returned in hundredths of degree Celsius and of %RH.
+ */
+int DHT20_process(int32_t *temp, int32_t *hum)
+{
+    uint8_t buf[DHT20_MEAS_LEN];
+    uint32_t temperature;
+    uint32_t humidity;
+
+    switch (dht20_state) {
+        case DHT20_STATE_IDLE:
+            return DHT20_READ_IDLE;
+
+        case DHT20_STATE_WAIT:
+            return DHT20_READ_BUSY;
+
+        case DHT20_STATE_POLL:
+        default:
+            break;
+    }
+
+    // read status, data and CRC in one transfer
     memset(buf,0x0,sizeof(buf));
-    buf[0] = DHT20_START_MEASURE;
-    buf[1] = 0x33;
-    buf[2] = 0x00;
-    i2c_write_blocking(I2C_PORT_SENS,DHT20_I2C_ADDRESS,buf,3,false);
-    
-    // read the response waiting until it's ready
-    // TODO: modificare e leggere direttamente 6 bytes con il primo che e' lo status
-    loop = DTH20_WAIT_MEAS_LOOP;
-    do {
-        memset(buf,0x0,sizeof(buf));
-        sleep_ms(DHT20_WAIT_MEAS_MS);
-        i2c_read_blocking(I2C_PORT_SENS,DHT20_I2C_ADDRESS,buf,6,false);
-        PRINT_I2C_DEBUG("--> loop = %d, from sensor: buf[0] = %02x\n",loop,buf[0]);
-        loop--;
-    } while (((buf[0] & 0x80) == 0x80) && (loop > 0));
-    if(loop == 0)
-    {
-        PRINT_I2C_DEBUG("Unable to read measure within %d milleseconds\n",(DHT20_WAIT_MEAS_MS*DTH20_WAIT_MEAS_LOOP));
-        ret = -1;
-        return ret;
+    if (i2c_read_timeout_us(I2C_PORT_SENS, DHT20_I2C_ADDRESS, buf, sizeof(buf), false, DHT20_I2C_TIMEOUT_US) != sizeof(buf)) {
+        printf("Unable to read the DHT20 measure\n");
+        dht20_state = DHT20_STATE_IDLE;
+        return DHT20_READ_ERROR;
     }
-    
+    PRINT_I2C_DEBUG("--> loop = %d, from sensor: buf[0] = %02x\n",dht20_loop,buf[0]);
+    if ((buf[0] & DHT20_STATUS_BUSY) == DHT20_STATUS_BUSY) {
+        // conversion not completed yet: wait again
+        if (--dht20_loop == 0) {
+            PRINT_I2C_DEBUG("Unable to read measure within %d milleseconds\n",(DHT20_WAIT_MEAS_MS*DTH20_WAIT_MEAS_LOOP));
+            dht20_state = DHT20_STATE_IDLE;
+            return DHT20_READ_ERROR;
+        }
+        return DHT20_wait();
+    }
+    dht20_state = DHT20_STATE_IDLE;
+    PRINT_I2C_DEBUG("--> from sensor: buf[] = %02x,%02x,%02x,%02x,%02x (CRC %02x)\n",buf[1],buf[2],buf[3],buf[4],buf[5],buf[6]);
+    if (DHT20_crc8(buf, DHT20_MEAS_LEN - 1) != buf[6]) {
+        printf("Wrong CRC of the DHT20 measure\n");
+        return DHT20_READ_ERROR;
+    }
+
     // measure is ready
-    i2c_read_blocking(I2C_PORT_SENS,DHT20_I2C_ADDRESS,buf,6,false);
-    PRINT_I2C_DEBUG("--> from sensor: buf[] = %02x,%02x,%02x,%02x,%02x\n",buf[1],buf[2],buf[3],buf[4],buf[5]);
-    humidity = (buf[1]<<8) | ((buf[2]));
-    humidity = ((humidity << 4) | ((buf[3] & 0xF0)>>4));
+    humidity = ((uint32_t)buf[1] << 12) | ((uint32_t)buf[2] << 4) | ((buf[3] & 0xF0) >> 4);
     PRINT_I2C_DEBUG("humidity = 0x%X\n",humidity);
-    temperature = ((buf[3] & 0x0F)<< 16) | (buf[4]<<8) | buf[5];
+    temperature = ((uint32_t)(buf[3] & 0x0F) << 16) | ((uint32_t)buf[4] << 8) | buf[5];
     PRINT_I2C_DEBUG("temperature = 0x%X\n",temperature);
-    *hum = ((float)humidity / 1048576)*100;
-    *temp = (((float)temperature / 1048576)*200)-50;
-    PRINT_I2C_DEBUG("*** TEMPERATURE = %.2f C\n",*temp);
-    PRINT_I2C_DEBUG("*** HUMIDITY = %.2f %%RH\n",*hum);
+    // RH = raw / 2^20 * 100 and T = raw / 2^20 * 200 - 50, in hundredths (rounded to the nearest):
+    // 10000 / 2^20 = 625 / 2^16 and 20000 / 2^20 = 1250 / 2^16, the products fit in 32 bits
+    *hum = (int32_t)(((humidity * 625u) + 0x8000u) >> 16);
+    *temp = (int32_t)(((temperature * 1250u) + 0x8000u) >> 16) - 5000;
+    PRINT_I2C_DEBUG("*** TEMPERATURE = %d (1/100) C\n",(int)*temp);
+    PRINT_I2C_DEBUG("*** HUMIDITY = %d (1/100) %%RH\n",(int)*hum);
 
-    return ret;
+    return DHT20_READ_OK;
 }
@@ -5,6 +5,20 @@
 #include "include/general.h"
 #include "include/eeprom_24LC256.h"
 
+// page waiting to be written
+typedef struct eeprom_job {
+    BYTE cmd[EEPROM_PAGE_LEN + 2];      // address (big endian) and data
+    int len;                            // bytes of data
+    bool last;                          // last page of the write: the callback is called
+    eeprom_write_cb_t cb;
+    void *arg;
+} eeprom_job_t;
+
+static eeprom_job_t eeprom_queue[EEPROM_QUEUE_PAGES];
+static int eeprom_head = 0;
+static int eeprom_count = 0;
+static bool eeprom_writing = false;     // the first page of the queue is in its write cycle
+static absolute_time_t eeprom_deadline;
 
 // Initialise EEPROM interface
 void i2c_eeprom_init(void)
@@ -59,7 +73,9 @@ int i2c_eeprom_read(int addr, BYTE *data, int dlen)
 {
     int ret;
     BYTE cmd[2] = {(BYTE)(addr >> 8), (BYTE)addr};
-        
+
+    // the EEPROM doesn't answer during a write cycle
+    i2c_eeprom_flush();
     ret = i2c_write_timeout_us(I2C_PORT, EEPROM_ADDR, cmd, sizeof(cmd), 1, EEPROM_XFER_US);
     if ((ret != PICO_ERROR_GENERIC) && (ret != PICO_ERROR_TIMEOUT))
     {
@@ -76,35 +92,135 @@ int i2c_eeprom_read(int addr, BYTE *data, int dlen)
     return ret;
 }
     
-// Write to EEPROM
-int i2c_eeprom_write(int addr, BYTE *data, int dlen)
+// Function: i2c_eeprom_ready()
+// The EEPROM acknowledges its address only when the write cycle is done (the byte read is discarded)
+static bool i2c_eeprom_ready(void)
+{
+    BYTE dummy;
+
+    return i2c_read_timeout_us(I2C_PORT, EEPROM_ADDR, &dummy, 1, false, EEPROM_POLL_US) > 0;
+}
+
+// Function: i2c_eeprom_done()
+// The first page of the queue is done: with an error the other pages of the same write are dropped
+static void i2c_eeprom_done(int result)
+{
+    eeprom_job_t *job;
+
+    eeprom_writing = false;
+    do {
+        job = &eeprom_queue[eeprom_head];
+        eeprom_head = (eeprom_head + 1) % EEPROM_QUEUE_PAGES;
+        eeprom_count--;
+    } while ((result != EE_SUCCESS) && !job->last && (eeprom_count > 0));
+    if (result != EE_SUCCESS) {
+        PRINT_DEBUG("%s: Write failed at address %04X\n", __FUNCTION__, (job->cmd[0] << 8) | job->cmd[1]);
+    }
+    if (((result != EE_SUCCESS) || job->last) && (job->cb != NULL)) {
+        job->cb(result, job->arg);
+    }
+}
+
+// Function: i2c_eeprom_process()
+// Advance the queue of the writes: send the next page, or check if the page sent is written.
+// It never waits for the write cycle.
+void i2c_eeprom_process(void)
+{
+    while (eeprom_count > 0) {
+        eeprom_job_t *job = &eeprom_queue[eeprom_head];
+        int ret;
+
+        if (!eeprom_writing) {
+            ret = i2c_write_timeout_us(I2C_PORT, EEPROM_ADDR, job->cmd, job->len + 2, false, EEPROM_XFER_US);
+            if ((ret == PICO_ERROR_GENERIC) || (ret == PICO_ERROR_TIMEOUT)) {
+                PRINT_DEBUG("%s: Error: %d\n", __FUNCTION__, ret);
+                i2c_eeprom_done(EE_ERROR);
+                continue;
+            }
+            eeprom_writing = true;
+            eeprom_deadline = make_timeout_time_us(EEPROM_WRITE_US);
+            return;
+        }
+        if (!i2c_eeprom_ready()) {
+            if (time_reached(eeprom_deadline)) {
+                i2c_eeprom_done(EE_ERROR);
+                continue;
+            }
+            return;
+        }
+        i2c_eeprom_done(EE_SUCCESS);
+    }
+}
+
+// Function: i2c_eeprom_flush()
+// Wait until all the queued writes are done
+void i2c_eeprom_flush(void)
+{
+    while (eeprom_count > 0) {
+        i2c_eeprom_process();
+        tight_loop_contents();
+    }
+}
+
+// Function: i2c_eeprom_busy()
+bool i2c_eeprom_busy(void)
+{
+    return (eeprom_count > 0);
+}
+
+// Function: i2c_eeprom_write_async()
+// Queue a write (the data is copied), split in pages. If the queue is full it waits for a free slot.
+// It returns EE_PENDING: cb gets the result (EE_SUCCESS or EE_ERROR), also when dlen is 0
+int i2c_eeprom_write_async(int addr, const BYTE *data, int dlen, eeprom_write_cb_t cb, void *arg)
 {
-    BYTE cmd[EEPROM_PAGE_LEN+2];
-    int n;
     int i = 0;
     int a = (addr & (EEPROM_PAGE_LEN - 1));
-    int ret = EE_SUCCESS;
-    
+
+    if ((addr < EEPROM_START_ADDR) || (dlen <= 0) || (addr + dlen > EEPROM_MEM_LENGHT)) {
+        if (cb != NULL) {
+            cb((dlen == 0) ? EE_SUCCESS : EE_ERROR, arg);
+        }
+        return EE_PENDING;
+    }
     while (dlen > 0)
     {
-        n = a + dlen > EEPROM_PAGE_LEN ? EEPROM_PAGE_LEN - a : dlen;
-        cmd[0] = (BYTE)((addr + i) >> 8);
-        cmd[1] = (BYTE)(addr + i);
-        memcpy(&cmd[2], &data[i], n);
-        ret = i2c_write_timeout_us(I2C_PORT, EEPROM_ADDR, cmd, n + 2, 0, EEPROM_XFER_US);
-        if((ret == PICO_ERROR_GENERIC) || (ret == PICO_ERROR_TIMEOUT))
-        {
-            PRINT_DEBUG("%s: Write only %d bytes, Error: %d",__FUNCTION__, i, ret);
-            ret = EE_ERROR;
-            break;
+        eeprom_job_t *job;
+        int n = a + dlen > EEPROM_PAGE_LEN ? EEPROM_PAGE_LEN - a : dlen;
+
+        while (eeprom_count == EEPROM_QUEUE_PAGES) {
+            i2c_eeprom_process();
+            tight_loop_contents();
         }
-        else
-            ret = EE_SUCCESS;
+        job = &eeprom_queue[(eeprom_head + eeprom_count) % EEPROM_QUEUE_PAGES];
+        job->cmd[0] = (BYTE)((addr + i) >> 8);
+        job->cmd[1] = (BYTE)(addr + i);
+        memcpy(&job->cmd[2], &data[i], n);
+        job->len = n;
+        job->last = (n == dlen);
+        job->cb = cb;
+        job->arg = arg;
+        eeprom_count++;
         i += n;
         dlen -= n;
         a = 0;
-        busy_wait_us(EEPROM_WRITE_US);
     }
-    return ret;
+    // the first page goes out now
+    i2c_eeprom_process();
+    return EE_PENDING;
+}
+
+// Function: i2c_eeprom_write_done()
+static void i2c_eeprom_write_done(int result, void *arg)
+{
+    *(int *)arg = result;
 }
 
+// Write to EEPROM (it waits until the data is written)
+int i2c_eeprom_write(int addr, BYTE *data, int dlen)
+{
+    int ret = EE_PENDING;
+
+    i2c_eeprom_write_async(addr, data, dlen, i2c_eeprom_write_done, &ret);
+    i2c_eeprom_flush();
+    return ret;
+}
@@ -1,65 +0,0 @@
-
-const unsigned char favicon_ico[] = {
-#if 1
-    // monochrome (blue) favicon.ico
-    0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x10, 0x10, 0x10, 0x00, 0x01, 0x00,
-    0x04, 0x00, 0x28, 0x01, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x28, 0x00,
-    0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x01, 0x00,
-    0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x01, 0x11, 0x11, 0x10, 0x00, 0x00, 0x00, 0x00, 0x01, 0x11, 0x11, 0x10,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x01, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x11,
-    0x11, 0x10, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x01, 0x10, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x11, 0x10, 0x00, 0x00, 0x00,
-    0x00, 0x01, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x11,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x01, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFC, 0x3F, 0x00, 0x00, 0xF8, 0x1F,
-    0x00, 0x00, 0xF8, 0x1F, 0x00, 0x00, 0xFC, 0x3F, 0x00, 0x00, 0xFE, 0x7F,
-    0x00, 0x00, 0xFE, 0x41, 0x00, 0x00, 0xFE, 0x7F, 0x00, 0x00, 0xFE, 0x43,
-    0x00, 0x00, 0xFE, 0x7F, 0x00, 0x00, 0xFE, 0x47, 0x00, 0x00, 0xFE, 0x7F,
-    0x00, 0x00, 0xFE, 0x4F, 0x00, 0x00, 0xFE, 0x7F, 0x00, 0x00, 0xFE, 0x7F,
-    0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00
-#else
-    // colored favicon.ico
-    0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x10, 0x10, 0x10, 0x00, 0x01, 0x00,
-    0x04, 0x00, 0x28, 0x01, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x28, 0x00,
-    0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x01, 0x00,
-    0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0xFF, 0x9D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xF2,
-    0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x9D, 0xFF, 0x00, 0x00, 0x00,
-    0xFF, 0x00, 0xFF, 0x00, 0x08, 0x00, 0x00, 0xC3, 0xFF, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x13, 0x33, 0x11, 0x11, 0x33,
-    0x31, 0x11, 0x11, 0x33, 0x31, 0x66, 0x66, 0x13, 0x33, 0x11, 0x13, 0x33,
-    0x16, 0x66, 0x66, 0x61, 0x33, 0x31, 0x13, 0x33, 0x16, 0x66, 0x66, 0x61,
-    0x33, 0x31, 0x33, 0x33, 0x31, 0x66, 0x66, 0x13, 0x33, 0x33, 0x33, 0x33,
-    0x33, 0x16, 0x61, 0x31, 0x13, 0x33, 0x33, 0x33, 0x33, 0x16, 0x61, 0x33,
-    0x33, 0x33, 0x33, 0x33, 0x33, 0x10, 0x01, 0x33, 0x33, 0x33, 0x33, 0x33,
-    0x33, 0x10, 0x01, 0x31, 0x13, 0x33, 0x33, 0x33, 0x33, 0x12, 0x21, 0x33,
-    0x33, 0x33, 0x33, 0x33, 0x33, 0x17, 0x71, 0x33, 0x33, 0x33, 0x33, 0x33,
-    0x33, 0x17, 0x71, 0x31, 0x13, 0x33, 0x13, 0x33, 0x33, 0x14, 0x41, 0x33,
-    0x33, 0x31, 0x13, 0x33, 0x33, 0x15, 0x51, 0x33, 0x33, 0x31, 0x11, 0x33,
-    0x33, 0x13, 0x31, 0x31, 0x13, 0x11, 0x11, 0x13, 0x33, 0x11, 0x11, 0x33,
-    0x31, 0x11, 0xE0, 0x07, 0x00, 0x00, 0xC0, 0x03, 0x00, 0x00, 0x80, 0x01,
-    0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0xC0, 0x03,
-    0x00, 0x00, 0xE0, 0x07, 0x00, 0x00
-#endif
-};
-
-const unsigned int favicon_ico_len = sizeof(favicon_ico);
-
@@ -16,10 +16,29 @@
 
 #define DHT20_WAIT_MEAS_MS          80
 #define DTH20_WAIT_MEAS_LOOP        5
+#define DHT20_STATUS_BUSY           0x80
+#define DHT20_MEAS_LEN              7       // status, 5 bytes of data (20 bits RH, 20 bits T), CRC
+#define DHT20_CRC_INIT              0xFF
+#define DHT20_CRC_POLY              0x31
+#define DHT20_I2C_TIMEOUT_US        5000    // max time of a single I2C transfer
+
+// Return values of DHT20_start() and DHT20_process()
+#define DHT20_READ_OK               0       // measure completed, values updated
+#define DHT20_READ_ERROR            -1      // measure failed
+#define DHT20_READ_BUSY             1       // measure in progress
+#define DHT20_READ_IDLE             2       // no measure in progress
+
+// Acquisition state machine: the conversion time is waited through an alarm, so the
+// main loop (and the network stack) is never blocked by the sensor
+typedef enum {
+    DHT20_STATE_IDLE,       // no measure in progress
+    DHT20_STATE_WAIT,       // measure triggered, waiting for the alarm
+    DHT20_STATE_POLL,       // alarm expired: read the status (and the data if ready)
+} dht20_state_t;
 
-float C2F(float temperature);
 int DHT20_init(void);
-int DHT20_read_data(float *temp, float *hum);
+int DHT20_start(void);
+int DHT20_process(int32_t *temp, int32_t *hum);
 
 #endif // DHT20_H
 
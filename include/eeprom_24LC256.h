@@ -1,8 +1,11 @@
 #ifndef EEPROM_24LC256_H
 #define EEPROM_24LC256_H
 
+#include <stdbool.h>
+
 #define EE_SUCCESS              0
 #define EE_ERROR                -1
+#define EE_PENDING              1       // write queued, the callback tells when it's done
 
 // I2C defines
 // This example will use I2C0 on GPIO14 (SDA) and GPIO15 (SCL) running at 400KHz.
@@ -18,20 +21,34 @@
 // therefore the address is 1010100 = 0x54 
 #define EEPROM_ADDR             0x54
 #define EEPROM_PAGE_LEN         64
-#define EEPROM_WRITE_US         11000
+#define EEPROM_WRITE_US         11000   // max time of the write cycle of a page
 #define EEPROM_XFER_US          100000
+#define EEPROM_POLL_US          1000    // max time of the transfer that checks if the write cycle is done
+#define EEPROM_QUEUE_PAGES      8       // pages queued by i2c_eeprom_write_async()
 
 #define EEPROM_MEM_LENGHT       0x8000
 #define EEPROM_START_ADDR       0x0
 #define EEPROM_STOP_ADDR        (EEPROM_MEM_LENGHT - 1)
 
-#define EEPROM_CTRL_WORD        "WifiLightThermo\0"
+#define EEPROM_CTRL_WORD        "WLightThermo-v2\0"   // thresholds in hundredths (int32_t)
+#define EEPROM_CTRL_WORD_V1     "WifiLightThermo\0"   // legacy layout: thresholds stored as float
 #define EEPROM_CTRL_WORD_LEN    16
 
+// The writes are queued a page at a time: the page is sent to the EEPROM, then the end of its
+// write cycle is detected by polling (the EEPROM doesn't acknowledge its address until it's done,
+// usually 3-5 ms) from i2c_eeprom_process(), called by the main loop. The callback of a write is
+// called when all its pages are written, or at the first error (the other pages are dropped).
+// The blocking functions wait until the queue is empty.
+typedef void (*eeprom_write_cb_t)(int result, void *arg);
+
 // Function prototypes
 void i2c_eeprom_init(void);
 int i2c_eeprom_dump(void);
 int i2c_eeprom_read(int addr, BYTE *data, int dlen);
 int i2c_eeprom_write(int addr, BYTE *data, int dlen);
+int i2c_eeprom_write_async(int addr, const BYTE *data, int dlen, eeprom_write_cb_t cb, void *arg);
+void i2c_eeprom_process(void);
+void i2c_eeprom_flush(void);
+bool i2c_eeprom_busy(void);
 
 #endif // EEPROM_24LC256_H 
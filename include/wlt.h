@@ -34,6 +34,7 @@
 #define RGB_LED_ON_WIFI_FAIL                RGB_COLOR_YELLOW
 #define RGB_LED_ON_TIME_MS                  1000 // LED on time in milliseconds
 #define RGB_LED_OFF_TIME_MS                 1000 // LED off time in milliseconds
+#define WLT_HEARTBEAT_TIME_MS               1000 // toggle time of the LED of the CYW43 (main loop running)
 
 typedef enum wlt_wifi_mode {
     WLT_WIFI_MODE_STA = 0,
@@ -79,26 +80,41 @@ typedef struct wlt_net_config {
 #define POLL_READ_TIME_MAX      63  // Maximum poll read sensor time in seconds (6 bits)
 #define POLL_READ_TIME_DFLT     30  // Default poll read sensor time in seconds
 
-#define MAX_THR_HUM_VALUE       100.0f
-#define MIN_THR_HUM_VALUE       0.0f
-#define MAX_THR_TEMP_VALUE      125.0f
-#define MIN_THR_TEMP_VALUE      -40.0f
+#define MAX_THR_HUM_VALUE       10000   // hundredths of %RH
+#define MIN_THR_HUM_VALUE       0       // hundredths of %RH
+#define MAX_THR_TEMP_VALUE      12500   // hundredths of degree Celsius
+#define MIN_THR_TEMP_VALUE      -4000   // hundredths of degree Celsius
+
+// Options packed in settings_t (saved in the EEPROM as a whole): name and number of bits, from bit 0
+#define WLT_SETTINGS_OPTIONS(X) \
+    X(t_format,     1)  /* Bit 0 - Temperature format 0 = Celsius, 1 = Fahrenheit */ \
+    X(out_format,   1)  /* Bit 1 - Output format 0 = CSV, 1 = TXT */ \
+    X(poll_time,    6)  /* Bit 2-7 - Poll time in seconds (0-63 seconds) */ \
+    X(trd_hyst,     3)  /* Bit 8-10 - Number of consecutive read to trigger thresholds */ \
+    X(sens_avail,   1)  /* Bit 11 - Sensor availability: 0 = not available, 1 = available */ \
+    X(data_valid,   1)  /* Bit 12 - tell me if data read from sensor is valid: 0 = not valid, 1 = valid */ \
+    X(theme,        1)  /* Bit 13 - Web page theme: 0 = dark, 1 = light */ \
+    X(reserved,     2)  /* Bit 14-15 - Reserved for future use */
+
+#define WLT_SETTINGS_BITFIELD(name, bits)   uint16_t name : bits;
+#define WLT_SETTINGS_POSITION(name, bits)   SETTINGS_SHIFT_##name, SETTINGS_LAST_##name = SETTINGS_SHIFT_##name + (bits) - 1,
+#define WLT_SETTINGS_WIDTH(name)            (SETTINGS_LAST_##name - SETTINGS_SHIFT_##name + 1)
+
+// first and last bit of each option (SETTINGS_SHIFT_<name>, SETTINGS_LAST_<name>)
+enum {
+    WLT_SETTINGS_OPTIONS(WLT_SETTINGS_POSITION)
+    SETTINGS_BITS
+};
 
 typedef union settings {
     uint16_t all_options;
     struct {
-        uint8_t t_format    : 1; // Bit 0 - Temperature format 0 = Celsius, 1 = Fahrenheit
-        uint8_t out_format  : 1; // Bit 1 - Output format 0 = CSV, 1 = TXT
-        uint8_t poll_time   : 6; // Bit 2-7 - Poll time in seconds (0-63 seconds)
-        
-        uint8_t trd_hyst    : 3; // Bit 8-10 - Number of consecutive read to trigger thresholds
-        uint8_t sens_avail  : 1; // Bit 11 - Sensor availability: 0 = not available, 1 = available
-        uint8_t data_valid  : 1; // Bit 12 - tell me if data read from sensor is valid: 0 = not valid, 1 = valid
-        uint8_t theme       : 1; // Bit 13 - Web page theme: 0 = dark, 1 = light
-        uint8_t reserved    : 2; // Bit 14-15 - Reserved for future use
+        WLT_SETTINGS_OPTIONS(WLT_SETTINGS_BITFIELD)
     } options;
 } settings_t;
 
+_Static_assert(SETTINGS_BITS == 8 * sizeof(uint16_t), "the options must fill settings_t.all_options");
+
 typedef enum {
     TRD_TRIGGER_NONE,   // No trigger
     TRD_TRIGGER_HIGH,   // Trigger when value is up the threshold
@@ -110,7 +126,7 @@ typedef struct wlt_outputs {
     wlt_data_type_t data_type;  // data type to output on the GPIOs (temperature, humidity, pressure)
     trd_trigger_t trigger;      // type of trigger to decide the GPIO state
     uint8_t gpio_num;           // GPIO number to output the signal
-    float threshold;            // threshold to compare the data with to decide the GPIO state
+    int32_t threshold;          // threshold to compare the data with to decide the GPIO state (hundredths, as the data)
 } outputs_t;
 
 typedef struct wlt_outputs_rt {
@@ -119,9 +135,9 @@ typedef struct wlt_outputs_rt {
 } wlt_outputs_rt_t;
 
 typedef struct wlt_data {
-    float           temperature;
-    float           humidity;
-    float           pressure; // for future use, not available with DHT20 sensor
+    int32_t         temperature;    // hundredths of degree Celsius (control loop copy, see wlt_sample.h)
+    int32_t         humidity;       // hundredths of %RH (control loop copy, see wlt_sample.h)
+    int32_t         pressure;       // for future use, not available with DHT20 sensor
     settings_t      settings;
     outputs_t       outputs[OUTPUT_GPIO_MAX];
 } wlt_data_t;
@@ -154,44 +170,12 @@ typedef struct wlt_rgb_led {
     uint64_t last_change; // Last time the LED color was changed
 } wlt_rgb_led_t;
 
-// API JSON parameters enums
-typedef struct api_parse_key 
-{
-    char *key;
-    wlt_error_t (*parse_func)(char *value);
-} api_parse_key_t;
-
+// Groups of parameters of the API (same order as the groups of the schema, see wlt_schema.c)
 typedef enum {
-    PARAMS_WIFI,
-    PARAMS_SETTINGS,
     PARAMS_OUTPUTS,
+    PARAMS_SETTINGS,
+    PARAMS_WIFI,
     PARAMS_MAX
 } params_type_t;
 
-// TODO: add ip, netmask, gateway parameters when in AP mode
-typedef enum {
-    WIFI_DEVICENAME,
-    WIFI_MODE,
-    WIFI_SSID,
-    WIFI_PASS,
-    WIFI_PARAM_MAX
-} wifi_param_t;\
-
-typedef enum {
-    SETTINGS_TEMP_FORMAT,
-    SETTINGS_OUTPUT_FORMAT,
-    SETTINGS_POLL_TIME,
-    SETTINGS_TRD_HYSTERIS,
-    SETTINGS_THEME,
-    SETTINGS_MAX
-} settings_param_t;
-
-typedef enum {
-    OUTPUTS_GPIO,
-    OUTPUTS_DATA_TYPE,
-    OUTPUTS_THRESHOLD,
-    OUTPUTS_TRIGGER,
-    OUTPUTS_MAX
-} outputs_param_t;
-
 #endif // WLT_H
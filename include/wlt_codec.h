@@ -0,0 +1,50 @@
+#ifndef WLT_CODEC_H
+#define WLT_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Compressed blocks of time series: each sample is a timestamp and up to WLT_CODEC_CHANNELS_MAX
+// integer values (fixed point, e.g. hundredths of degree).
+// - the timestamps are stored as delta of delta: 0 for a regular poll time (1 byte)
+// - the values are stored as the difference with the previous sample of the same channel
+// Both are zigzag encoded (small negative numbers stay small) and written as varints: 7 bits per
+// byte, the high bit set when more bytes follow.
+// Each block starts from its header (no state from the previous blocks): it can be decoded on its
+// own, a store finds a sample by looking for its block first.
+// The block is made of fixed size fields only. wlt_codec_encode() / wlt_codec_decode() work on any
+// buffer, for containers of another size (e.g. the EEPROM pages of the journal).
+#define WLT_CODEC_CHANNELS_MAX              8
+#ifndef WLT_CODEC_BLOCK_BYTES
+#define WLT_CODEC_BLOCK_BYTES               120     // encoded samples of a block
+#endif
+#define WLT_CODEC_VARINT_MAX                5       // bytes of a 32 bits varint
+
+typedef struct wlt_codec_block {
+    uint32_t seq;                       // sequence number of the first sample (set by the store)
+    uint32_t ts;                        // timestamp of the first sample
+    uint16_t count;                     // samples in the block
+    uint16_t len;                       // bytes used in data
+    uint8_t data[WLT_CODEC_BLOCK_BYTES];
+} wlt_codec_block_t;
+
+// State of the encoder (last sample appended) or of the decoder (last sample read): after
+// reading all the samples of a block the decoder is where the encoder was.
+typedef struct wlt_codec_state {
+    uint8_t channels;
+    uint16_t index;                     // next sample of the block (block functions)
+    uint16_t pos;                       // next byte of the block (block functions)
+    uint32_t ts;                        // previous timestamp
+    uint32_t delta;                     // previous timestamp delta
+    int32_t values[WLT_CODEC_CHANNELS_MAX];
+} wlt_codec_state_t;
+
+void wlt_codec_reset(wlt_codec_state_t *state, uint8_t channels, uint32_t ts);
+int wlt_codec_encode(uint8_t *buf, int max, wlt_codec_state_t *state, uint32_t ts, const int32_t *values);
+int wlt_codec_decode(const uint8_t *buf, int len, wlt_codec_state_t *state, uint32_t *ts, int32_t *values);
+void wlt_codec_begin(wlt_codec_block_t *block, wlt_codec_state_t *state, uint8_t channels, uint32_t seq, uint32_t ts);
+bool wlt_codec_append(wlt_codec_block_t *block, wlt_codec_state_t *state, uint32_t ts, const int32_t *values);
+void wlt_codec_rewind(const wlt_codec_block_t *block, wlt_codec_state_t *state, uint8_t channels);
+bool wlt_codec_next(const wlt_codec_block_t *block, wlt_codec_state_t *state, uint32_t *ts, int32_t *values);
+
+#endif // WLT_CODEC_H
@@ -0,0 +1,65 @@
+#ifndef WLT_CONFIG_H
+#define WLT_CONFIG_H
+
+#include <stdint.h>
+#include "wlt.h"
+
+// The configuration is saved in two slots (A/B) of the EEPROM, a write goes to the slot that
+// doesn't hold the current configuration: if it's interrupted (power cut) the other slot is still
+// valid. Each record has a header with a generation number (incremented at every write), the
+// version of the layout of the payload and a CRC-32: at boot the newest valid record is used,
+// the older versions are converted (wlt_config_migrate()).
+// The configuration saved before the slots (a single wlt_config_data_t at address 0, told by its
+// signature) is read when no slot is valid, the first write goes to slot B and keeps it.
+#define WLT_CONFIG_SLOT_A_ADDR              0x0000
+#define WLT_CONFIG_SLOT_B_ADDR              0x0200
+#define WLT_CONFIG_SLOT_LEN                 0x0200  // the journal starts after slot B
+#define WLT_CONFIG_SLOTS                    2
+#define WLT_CONFIG_RECORD_LEN               (sizeof(wlt_config_header_t) + sizeof(wlt_config_data_t))
+#define WLT_CONFIG_MAGIC                    0x43544C57  // "WLTC"
+#define WLT_CONFIG_CRC_INIT                 0xFFFFFFFF  // CRC-32 (IEEE 802.3)
+#define WLT_CONFIG_CRC_POLY                 0xEDB88320  // reflected polynomial
+
+// Versions of the layout of the payload: the fields can be added at the end of the structure
+// without a new version (the missing ones keep the value set by the caller), any other change
+// needs a new version and its conversion in wlt_config_migrate().
+#define WLT_CONFIG_VERSION_V1               1       // thresholds stored as float
+#define WLT_CONFIG_VERSION_V2               2       // thresholds in hundredths (int32_t)
+#define WLT_CONFIG_VERSION                  WLT_CONFIG_VERSION_V2
+
+#define EE_NOT_FOUND                        -2      // no valid configuration in the EEPROM
+
+// Write-behind of the changes (see wlt_update_and_save_config()): the configuration is saved when
+// no other change comes for WLT_CONFIG_COMMIT_DELAY_MS, a burst of changes costs a single write.
+#ifndef WLT_CONFIG_COMMIT_DELAY_MS
+#define WLT_CONFIG_COMMIT_DELAY_MS          5000
+#endif
+#define WLT_CONFIG_DEFERRED                 2       // changes applied, saved at the end of the quiet period
+#define WLT_CONFIG_TRANSIENT                3       // changes applied, not saved (lost at reboot)
+
+typedef struct wlt_config_header {
+    uint32_t magic;
+    uint32_t gen;                       // generation of the record (the highest is the newest)
+    uint16_t version;                   // layout of the payload
+    uint16_t len;                       // bytes of the payload
+    uint32_t crc;                       // CRC-32 of the header (computed with crc = 0) and of the payload
+} wlt_config_header_t;
+
+// Counters of the writes (since boot): a write goes only to the pages of the record that change
+typedef struct wlt_config_stats {
+    uint32_t writes;                    // configurations written
+    uint32_t unchanged;                 // writes skipped: same configuration as the current one
+    uint32_t pages_written;
+    uint32_t pages_skipped;             // pages of the record already up to date in the slot
+} wlt_config_stats_t;
+
+int wlt_config_read(wlt_config_data_t *config);
+int wlt_config_write(const wlt_config_data_t *config);
+void wlt_config_get_stats(wlt_config_stats_t *stats);
+void wlt_update_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config);
+void wlt_load_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config);
+int wlt_update_and_save_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config, bool persist);
+int wlt_commit_config(void);
+void wlt_check_config_commit(void);
+
+#endif // WLT_CONFIG_H
@@ -0,0 +1,32 @@
+#ifndef WLT_CORE1_H
+#define WLT_CORE1_H
+
+#include "include/wlt.h"
+#include "include/wlt_spsc.h"
+
+// Core 1 runs the control loop (sensor acquisition, outputs, UART), core 0 the network.
+// They share no data: the samples go to core 0 and the configuration changes go to core 1
+// through two single producer / single consumer rings.
+#define WLT_SAMPLE_RING_SLOTS       8       // samples waiting for core 0 (power of 2)
+#define WLT_CTRL_RING_SLOTS         4       // configuration changes waiting for core 1 (power of 2)
+#define WLT_CORE1_TICK_MS           10      // period of the control loop
+
+// event of a new sample sent from core 1 to core 0 (the values are read with wlt_sample_read())
+typedef struct wlt_sample_msg {
+    int8_t result;                          // DHT20_READ_OK, DHT20_READ_ERROR or DHT20_READ_IDLE (sensor not available)
+    bool outputs_changed;                   // the state of an output has changed
+    bool gpio_state[OUTPUT_GPIO_MAX];       // state of the outputs after the sample
+} wlt_sample_msg_t;
+
+// configuration sent from core 0 to core 1
+typedef struct wlt_ctrl_msg {
+    settings_t settings;
+    outputs_t outputs[OUTPUT_GPIO_MAX];
+} wlt_ctrl_msg_t;
+
+void wlt_core1_launch(const wlt_run_time_config_t *config);
+void wlt_core1_send_config(const wlt_data_t *data);
+void wlt_core1_flush_config(void);
+bool wlt_core1_get_sample(wlt_sample_msg_t *sample);
+
+#endif // WLT_CORE1_H
@@ -0,0 +1,31 @@
+#ifndef WLT_FMT_H
+#define WLT_FMT_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FMT_NUM_MAX_LEN                     16  // room for any number written by the formatter
+#define FMT_CENTI_INT_MAX                   1000000 // max integer part parsed by fmt_parse_centi()
+
+// Fixed point formatter: the RP2040 has no FPU, the readings are formatted from integers
+// (hundredths of degree or of %RH) without the float support of the printf family.
+//
+// fmt_format() expands a template with the snprintf semantic (the return value is the length of
+// the whole text, the text doesn't fit if it's >= max). Supported directives:
+//   %s         string
+//   %c         character
+//   %d %u %x   int, unsigned int, hex (optional '0' flag and width, e.g. %03x)
+//   %.Nf       fixed point: the argument is an int32_t scaled by 10^N (e.g. %.2f takes hundredths)
+//   %%         percent sign
+// NOTE: %.Nf takes an integer, never pass a float.
+
+int32_t fmt_centi(float value);
+int32_t fmt_centi_c2f(int32_t centi_c);
+bool fmt_parse_centi(const char *text, int32_t *value);
+int fmt_fixed(char *buf, size_t max, int32_t value, uint8_t decimals);
+int fmt_vformat(char *buf, size_t max, const char *tmpl, va_list args);
+int fmt_format(char *buf, size_t max, const char *tmpl, ...);
+
+#endif // WLT_FMT_H
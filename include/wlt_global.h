@@ -3,16 +3,14 @@
 
 extern wlt_run_time_config_t *prtconfig;
 extern wlt_config_data_t *pconfig;
+extern uint32_t wlt_sample_gen;
 
-extern float C2F(float temperature);
 extern int check_wifi_password(const char *password);
 extern void fix_devname(const char *src, size_t src_len, char *dest, size_t dest_len);
-extern void wlt_update_and_save_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config);
-
-
-// favicon.ico
-extern const unsigned char favicon_ico[];
-extern const unsigned int favicon_ico_len;
+extern int wlt_update_and_save_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config, bool persist);
+extern int wlt_commit_config(void);
+extern bool wlt_update_outputs_state(wlt_run_time_config_t *config);
+extern void wlt_send_to_uart(int32_t temperature, int32_t humidity, uint8_t temp_format, uint8_t out_format);
 
 
 #endif // WLT_GLOBAL_H
@@ -0,0 +1,65 @@
+#ifndef WLT_HISTORY_H
+#define WLT_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// History of the readings in RAM, at several resolutions (tiers):
+// - raw samples (more than the last hour at 10 s poll time)
+// - 1 minute aggregates (more than the last day)
+// - 15 minutes aggregates (more than the last 30 days), downsampled from the 1 minute aggregates
+// Each tier is a ring of compressed blocks (wlt_codec.h): when it's full, the oldest block is
+// overwritten. The entries take about 3 bytes for a raw sample and 9 bytes for an aggregate
+// with a regular poll time, the number of entries kept depends on how much the readings move.
+// The aggregates are updated at every sample (the interval in progress is readable too).
+// The timestamps are in seconds of device time: seconds since boot, going on from the last sample
+// of the journal at boot (wlt_journal.h) so the samples of the previous boots come first (the time
+// the device is off is not counted).
+#ifndef WLT_HIST_RAW_BLOCKS
+#define WLT_HIST_RAW_BLOCKS                 16      // ~40 samples each
+#endif
+#ifndef WLT_HIST_1M_BLOCKS
+#define WLT_HIST_1M_BLOCKS                  128     // ~13 aggregates each
+#endif
+#ifndef WLT_HIST_15M_BLOCKS
+#define WLT_HIST_15M_BLOCKS                 256     // ~12 aggregates each
+#endif
+
+#define WLT_HIST_RES_RAW                    0       // resolution of the tiers (seconds)
+#define WLT_HIST_RES_1M                     60
+#define WLT_HIST_RES_15M                    900
+
+typedef enum {
+    WLT_HIST_TIER_RAW,
+    WLT_HIST_TIER_1M,
+    WLT_HIST_TIER_15M,
+    WLT_HIST_TIERS
+} wlt_hist_tier_t;
+
+// aggregate of the samples of an interval (a raw sample is returned as an interval of one sample)
+typedef struct wlt_hist_agg {
+    uint32_t ts;                // start of the interval
+    uint16_t count;             // number of samples
+    int16_t t_min;
+    int16_t t_max;
+    int16_t t_mean;
+    uint16_t h_min;
+    uint16_t h_max;
+    uint16_t h_mean;
+} wlt_hist_agg_t;
+
+// Entries are addressed by sequence number (0 = first entry ever written), so a reader going
+// through a tier is not confused by the entries added in the meantime: the valid ones are
+// in [wlt_history_first(), wlt_history_end()), the last one can be the interval in progress.
+void wlt_history_set_epoch(uint32_t epoch);
+uint32_t wlt_history_time(uint64_t ms_since_boot);
+void wlt_history_add(uint32_t ts, int32_t temperature, int32_t humidity);
+int wlt_history_tier(uint32_t res);
+int wlt_history_select(uint32_t from);
+uint32_t wlt_history_res(int tier);
+uint32_t wlt_history_first(int tier);
+uint32_t wlt_history_end(int tier);
+uint32_t wlt_history_find(int tier, uint32_t from);
+bool wlt_history_get(int tier, uint32_t seq, wlt_hist_agg_t *agg);
+
+#endif // WLT_HISTORY_H
@@ -0,0 +1,63 @@
+#ifndef WLT_HTTP_H
+#define WLT_HTTP_H
+
+#include "stdbool.h"
+#include "lwip/pbuf.h"
+#include "wlt_ws.h"
+
+#define HTTP_METHOD_MAX_LEN                 8
+#define HTTP_PATH_MAX_LEN                   64
+#define HTTP_QUERY_MAX_LEN                  192
+#define HTTP_LINE_MAX_LEN                   96  // longer header lines are truncated (we don't need their tail)
+#define HTTP_ETAG_MAX_LEN                   48  // room for a couple of validators (If-None-Match can be a list)
+
+#define HTTP_HDR_CONTENT_LENGTH             "content-length"
+#define HTTP_HDR_IF_NONE_MATCH              "if-none-match"
+#define HTTP_HDR_ACCEPT_ENCODING            "accept-encoding"
+#define HTTP_HDR_CONNECTION                 "connection"
+#define HTTP_HDR_UPGRADE                    "upgrade"
+#define HTTP_HDR_WS_KEY                     "sec-websocket-key"
+#define HTTP_HDR_WS_VERSION                 "sec-websocket-version"
+
+typedef enum {
+    HTTP_PARSE_METHOD,      // request line: method
+    HTTP_PARSE_PATH,        // request line: path
+    HTTP_PARSE_QUERY,       // request line: query string (after '?')
+    HTTP_PARSE_VERSION,     // request line: protocol version
+    HTTP_PARSE_HEADER,      // header lines, until the empty line
+    HTTP_PARSE_BODY,        // body, Content-Length bytes
+    HTTP_PARSE_DONE,        // request complete
+    HTTP_PARSE_ERROR        // malformed or too large request
+} http_parse_state_t;
+
+// Resumable HTTP request parser: it keeps only the fields used by the server.
+// The body is stored in a buffer provided by the caller.
+typedef struct http_request {
+    http_parse_state_t state;
+    uint16_t pos;                               // write position in the field being parsed
+    char method[HTTP_METHOD_MAX_LEN];
+    char path[HTTP_PATH_MAX_LEN];
+    uint8_t path_len;
+    char query[HTTP_QUERY_MAX_LEN];
+    char line[HTTP_LINE_MAX_LEN];               // current header line (or protocol version)
+    char if_none_match[HTTP_ETAG_MAX_LEN];
+    int content_length;
+    char *body;
+    int body_len;
+    int body_max;
+    bool http_1_0;
+    bool conn_close;
+    bool conn_keep_alive;
+    bool accept_gzip;
+    bool conn_upgrade;                          // Connection: Upgrade
+    bool upgrade_websocket;                     // Upgrade: websocket
+    uint8_t ws_version;                         // Sec-WebSocket-Version
+    char ws_key[WS_KEY_MAX_LEN];                // Sec-WebSocket-Key
+} http_request_t;
+
+void http_parser_init(http_request_t *req, char *body, int body_max);
+int http_parser_feed(http_request_t *req, const char *data, int len);
+http_parse_state_t http_parser_feed_pbuf(http_request_t *req, struct pbuf *p, u16_t *used);
+bool http_etag_match(const char *if_none_match, const char *etag);
+
+#endif // WLT_HTTP_H
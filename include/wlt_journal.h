@@ -0,0 +1,42 @@
+#ifndef WLT_JOURNAL_H
+#define WLT_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "eeprom_24LC256.h"
+#include "wlt_codec.h"
+
+// Journal of the samples in the EEPROM, after the configuration area: a circular log of pages,
+// each page is written once (when it's full) and never updated, the oldest one is overwritten
+// when the journal is full (every page is written once per turn: the wear is spread evenly).
+// Each page has a sequence number and a CRC: page n is always in slot n % WLT_JOURNAL_PAGES, so
+// at boot the last page written is found with a binary search on the sequence numbers.
+// A page that is not complete (power cut while writing it) fails the CRC and is skipped.
+// The samples are compressed (wlt_codec.h, about 15 samples per page): the samples not written yet
+// (less than WLT_JOURNAL_FLUSH_S seconds) are lost on a power cut.
+#define WLT_JOURNAL_START_ADDR              0x0400  // the configuration area is before
+#define WLT_JOURNAL_PAGES                   ((EEPROM_MEM_LENGHT - WLT_JOURNAL_START_ADDR) / EEPROM_PAGE_LEN)
+#define WLT_JOURNAL_HEADER_LEN              12      // seq, ts, count, len, crc
+#define WLT_JOURNAL_DATA_LEN                (EEPROM_PAGE_LEN - WLT_JOURNAL_HEADER_LEN)
+#define WLT_JOURNAL_CHANNELS                2       // T, H (hundredths)
+#define WLT_JOURNAL_FLUSH_S                 600     // max age of the samples kept in RAM
+#define WLT_JOURNAL_CRC_INIT                0xFFFF  // CRC-16/CCITT
+#define WLT_JOURNAL_CRC_POLY                0x1021
+
+typedef struct wlt_journal_page {
+    uint32_t seq;                       // sequence number of the page
+    uint32_t ts;                        // time of the first sample
+    uint8_t count;                      // samples in the page
+    uint8_t len;                        // bytes used in data
+    uint16_t crc;                       // CRC of the page (computed with crc = 0)
+    uint8_t data[WLT_JOURNAL_DATA_LEN];
+} wlt_journal_page_t;
+
+typedef void (*wlt_journal_cb_t)(uint32_t ts, int32_t temperature, int32_t humidity);
+
+bool wlt_journal_init(wlt_journal_cb_t replay);
+void wlt_journal_add(uint32_t ts, int32_t temperature, int32_t humidity);
+void wlt_journal_flush(void);
+uint32_t wlt_journal_last_ts(void);
+
+#endif // WLT_JOURNAL_H
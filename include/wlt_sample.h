@@ -0,0 +1,24 @@
+#ifndef WLT_SAMPLE_H
+#define WLT_SAMPLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Last reading of the sensor, published by the control loop (core 1) and read by the web server,
+// the event streams and any other consumer (core 0).
+typedef struct wlt_sample {
+    int32_t temperature;        // hundredths of degree Celsius
+    int32_t humidity;           // hundredths of %RH
+    uint64_t timestamp_ms;      // time of the reading (ms since boot: 64 bits, 32 would wrap after 49.7 days)
+    uint32_t gen;               // number of the reading (incremented at every read, also when it fails)
+    bool valid;                 // false if the read failed or the sensor is not available
+} wlt_sample_t;
+
+// The snapshot is protected by a sequence lock: the writer makes the sequence odd while it updates
+// the values, the readers copy them and retry if the sequence was odd or has changed.
+// There must be only one writer, and a reader must not interrupt the writer on the same core
+// (it would wait forever): the readers run on core 0, the writer on core 1.
+void wlt_sample_publish(const wlt_sample_t *sample);
+void wlt_sample_read(wlt_sample_t *sample);
+
+#endif // WLT_SAMPLE_H
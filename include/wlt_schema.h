@@ -0,0 +1,68 @@
+#ifndef WLT_SCHEMA_H
+#define WLT_SCHEMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wlt.h"
+
+// Schema of the configuration: each parameter of the API is described once (key, type, range,
+// position in wlt_run_time_config_t and in the EEPROM record) and the same tables drive the
+// parser of the POST requests, the checks of the values, the JSON of /api/v1/settings and the
+// copy between the runtime configuration and the record saved in the EEPROM.
+// The parameters are in groups (the keys of the JSON: "OUTS", "SETTINGS", "WIFI"), a group is an
+// object or an array of objects (one per item, e.g. the outputs).
+// The groups and the fields of each group are sorted by key: they are found with a binary search,
+// the JSON lists them in the same order.
+#define WLT_SCHEMA_RENDER_END               (-1)    // no more fragments
+
+typedef enum {
+    WLT_SCHEMA_STRING,                  // text (size with the terminator)
+    WLT_SCHEMA_INT,                     // integer in [min, max]
+    WLT_SCHEMA_ENUM,                    // integer, written as the name of its value
+    WLT_SCHEMA_CENTI,                   // hundredths (int32_t), written with two decimals
+    WLT_SCHEMA_IPV4                     // IPv4 address (u32_t in network order)
+} wlt_schema_type_t;
+
+// flags of a field
+#define WLT_SCHEMA_PERSIST                  0x01    // saved in the EEPROM
+#define WLT_SCHEMA_READ_ONLY                0x02    // not set by the API (ignored)
+#define WLT_SCHEMA_WRITE_ONLY               0x04    // not shown by the API (e.g. the password)
+
+typedef struct wlt_schema_field {
+    const char *key;
+    uint8_t type;                       // wlt_schema_type_t
+    uint8_t flags;
+    uint8_t size;                       // bytes of the member (the same in the EEPROM record)
+    uint8_t shift;                      // bit field: first bit and number of bits (0: the whole member)
+    uint8_t width;
+    uint16_t offset;                    // offset in the runtime configuration (in the item for the arrays)
+    uint16_t saved_offset;              // offset in the EEPROM record (persisted fields)
+    int32_t min;                        // range of the integers
+    int32_t max;
+    const char *const *names;           // enumerations: name of each value, NULL terminated
+    bool (*check)(const char *value);   // more checks of the text of the value (NULL: none)
+} wlt_schema_field_t;
+
+typedef struct wlt_schema_group {
+    const char *key;
+    const wlt_schema_field_t *fields;   // sorted by key
+    uint8_t count;
+    uint8_t items;                      // 1: object, more: array of objects
+    uint16_t offset;                    // offset of the first item (runtime configuration)
+    uint16_t saved_offset;              // offset of the first item (EEPROM record)
+    uint16_t stride;                    // bytes between two items (in both)
+    bool (*check)(const uint8_t *item); // checks between the fields of an item, once all are set (NULL: none)
+} wlt_schema_group_t;
+
+const wlt_schema_group_t *wlt_schema_group(int index);
+const wlt_schema_group_t *wlt_schema_find_group(const char *key);
+const wlt_schema_field_t *wlt_schema_find_field(const wlt_schema_group_t *group, const char *key);
+wlt_error_t wlt_schema_set(wlt_run_time_config_t *config, const wlt_schema_group_t *group, int item, const char *key, const char *value);
+wlt_error_t wlt_schema_check(const wlt_run_time_config_t *config, const wlt_schema_group_t *group, int item);
+void wlt_schema_copy_item(wlt_run_time_config_t *dst, const wlt_run_time_config_t *src, const wlt_schema_group_t *group, int item);
+int wlt_schema_render(char *buf, size_t max, int part, const wlt_run_time_config_t *config);
+void wlt_schema_pack(const wlt_run_time_config_t *rt_config, wlt_config_data_t *config);
+void wlt_schema_unpack(const wlt_config_data_t *config, wlt_run_time_config_t *rt_config);
+
+#endif // WLT_SCHEMA_H
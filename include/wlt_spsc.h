@@ -0,0 +1,26 @@
+#ifndef WLT_SPSC_H
+#define WLT_SPSC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Lock-free single producer / single consumer ring, used to pass messages between the cores.
+// head is written only by the producer and tail only by the consumer: each side reads the index
+// of the other one, a memory barrier orders the copy of the item and the update of the index.
+// The number of slots must be a power of 2, one slot is always left empty.
+typedef struct spsc_ring {
+    volatile uint32_t head;         // next slot to write (producer)
+    volatile uint32_t tail;         // next slot to read (consumer)
+    uint32_t mask;                  // slots - 1
+    size_t item_size;
+    uint8_t *items;                 // slots * item_size bytes
+    volatile uint32_t dropped;      // items not pushed because the ring was full (producer)
+} spsc_ring_t;
+
+bool spsc_init(spsc_ring_t *ring, void *items, uint32_t slots, size_t item_size);
+bool spsc_push(spsc_ring_t *ring, const void *item);
+bool spsc_pop(spsc_ring_t *ring, void *item);
+bool spsc_empty(const spsc_ring_t *ring);
+
+#endif // WLT_SPSC_H
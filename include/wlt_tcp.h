@@ -4,117 +4,45 @@
 #include "stdbool.h"
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
+#include "wlt_http.h"
+#include "wlt_web_routes.h"
 
 #define TCP_PORT                            80
+#ifndef WLT_HTTP_MAX_CONN
+#define WLT_HTTP_MAX_CONN                   4   // connection slots allocated at boot (build option)
+#endif
+#ifndef WLT_HTTP_BACKLOG
+#define WLT_HTTP_BACKLOG                    2   // connections waiting in the accept backlog (build option)
+#endif
 #define POLL_TIME_S                         5
+#define HTTP_KEEPALIVE_TIMEOUT_S            15  // close a persistent connection after this idle time (multiple of POLL_TIME_S)
+#define HTTP_LONGPOLL_TIMEOUT_S             30  // max time a /api/v1/info?since= request waits for a new sample (multiple of POLL_TIME_S)
+#define HTTP_KEEPALIVE_MAX_REQ              100 // max number of requests served on a persistent connection
+#define HTTP_STREAM_RING_SIZE               1024 // ring buffer of the replies generated by fragments (largest fragment ~1 KB)
+#define HTTP_RENDER_CACHE_ENTRIES           3   // pre-rendered pages: /home, /api/v1/info and a spare one while a stale copy is in flight
+#define HTTP_RENDER_HDR_MAX                 96
+#define HTTP_RENDER_BODY_MAX                1024
+#define HTTP_CACHE_MAX_AGE_S                86400 // static assets can be cached by the browser for one day
 #define HTTP_GET                            "GET"
 #define HTTP_POST                           "POST"
-#define HTTP_RESPONSE_HEADERS               "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: text/%s; charset=utf-8\nConnection: close\r\n\r\n"
-#define HTTP_RESPONSE_HEADERS_IMAGE         "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: image/%s\nConnection: close\r\n\r\n"
-#define HTTP_RESPONSE_HEADERS_JSON          "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: application/%s\nConnection: close\r\n\r\n"
-
-// **** STYLE SHEET ****
-#define STYLE_CSS                           "body {\
-font-family: Arial, sans-serif;\
-background-color: #f4f6f8;\
-color: #333;\
-display: flex;\
-justify-content: center;\
-align-items: flex-start;\
-min-height: 100vh;\
-padding-top: 50px;\
-margin: 0;\
-}\
-.form-container {\
-background-color: #ffffff;\
-padding: 30px;\
-border-radius: 8px;\
-box-shadow: 0 4px 12px rgba(0, 0, 0, 0.1);\
-width: 300px;\
-}\
-h2 {\
-color: #2c3e50;\
-margin-bottom: 20px;\
-text-align: center;\
-}\
-label {\
-display: block;\
-margin-bottom: 6px;\
-font-weight: 500;\
-color: #34495e;\
-}\
-input[type=\"text\"],\
-input[type=\"password\"] {\
-width: 100%%;\
-padding: 8px;\
-margin-bottom: 16px;\
-border: 1px solid #ccd6dd;\
-border-radius: 4px;\
-font-size: 14px;\
-transition: border-color 0.3s ease;\
-}\
-input[type=\"text\"]:focus {\
-border-color: #3498db;\
-outline: none;\
-}\
-input[type=\"submit\"] {\
-width: 100%%;\
-padding: 10px;\
-background-color: #3498db;\
-color: white;\
-border: none;\
-border-radius: 4px;\
-font-size: 16px;\
-cursor: pointer;\
-transition: background-color 0.3s ease;\
-}\
-input[type=\"submit\"]:hover {\
-background-color: #2980b9;\
-}\r\n"
-
-#define STYLE_FORM_DARK         ":root{--bg: #121212;--fg: #e0e0e0;--border: #444;--accent: #00f;}\
-body{font-family: Arial, sans-serif;background: var(--bg);color: var(--fg);margin: 10px;font-size: 14px;}\
-.container{max-width: 320px;margin: auto;}\
-.row{display: flex;align-items: center;margin-bottom: 8px;}\
-label{flex: 1;}\
-input[type=\"text\"],input[type=\"password\"]{flex: 2;padding: 4px;border: 1px solid var(--border);background: var(--bg);color: var(--fg);}\
-.inline{display: flex;gap: 10px;margin-bottom: 8px;}\
-button{width: 100%;padding: 6px;background: var(--accent);color: white;border: none;}\
-hr {border: none;border-top: 1px solid var(--border);}\r\n"
-
-#define STYLE_FORM_LIGHT        ":root{--bg: #ffffff;--fg: #111;--border: #ccc;--accent: #00f;}\
-body{font-family: Arial, sans-serif;background: var(--bg);color: var(--fg);margin: 10px;font-size: 14px;}\
-.container{max-width: 320px;margin: auto;}\
-.row{display: flex;align-items: center;margin-bottom: 8px;}\
-label{flex: 1;}\
-input[type=\"text\"],input[type=\"password\"]{flex: 2;padding: 4px;border: 1px solid var(--border);background: var(--bg);color: var(--fg);}\
-.inline{display: flex;gap: 10px;margin-bottom: 8px;}\
-button{width: 100%;padding: 6px;background: var(--accent);color: white;border: none;}\
-hr{border: none;border-top: 1px solid var(--border);}\r\n"
-
-#define STYLE_CSS_DARK                      "body{margin:0;background:#000;color:#0f0;font:48px monospace;\
-display:flex;align-items:center;justify-content:center;height:100vh}\
-#c{width:320px}\
-.r{display:flex;justify-content:space-between;margin:12px 0}\
-.l{color:#777;font-size:18px}\
-.v{font-weight:bold}\
-.d{color:#ffffff;font-size:18px;text-align:center;margin-top:20px}\
-.t{color:#ffffff;font-size:18px}\
-.led{width: 16px;height:16px;border-radius:50%;display:inline-block;margin-right:8px;}\
-.led.off{background-color:#555;box-shadow: inset 0 0 5px #222;}\
-.led.on{background-color:#00cc00;box-shadow: 0 0 10px #00ff00;}\r\n"
-
-#define STYLE_CSS_LIGHT                     "body{margin:0;background:#ffffff;color:#0000ff;font:48px monospace;\
-display:flex;align-items:center;justify-content:center;height:100vh}\
-#c{width:320px}\
-.r{display:flex;justify-content:space-between;margin:12px 0}\
-.l{color:#484848;font-size:18px}\
-.v{font-weight:bold}\
-.d{color:#000000;font-size:18px;text-align:center;margin-top:20px}\
-.t{color:#000000;font-size:18px}\
-.led{width: 16px;height:16px;border-radius:50%;display:inline-block;margin-right:8px;}\
-.led.off{background-color:#555;box-shadow: inset 0 0 5px #222;}\
-.led.on{background-color:#00cc00;box-shadow: 0 0 10px #00ff00;}\r\n"
+#define HTTP_CONN_CLOSE                     "close"
+#define HTTP_CONN_KEEP_ALIVE                "keep-alive"
+// The templates below are expanded by fmt_format() (wlt_fmt.h): %.2f takes hundredths (int32_t), not a float
+#define HTTP_RESPONSE_HEADERS               "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: text/%s; charset=utf-8\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_HEADERS_IMAGE         "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: image/%s\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_HEADERS_JSON          "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: application/%s\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_HEADERS_ASSET         "HTTP/1.1 200 OK\nContent-Length: %d\nContent-Type: %s\n%sETag: %s\nCache-Control: max-age=%d\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_NOT_MODIFIED          "HTTP/1.1 304 Not Modified\n%sETag: %s\nCache-Control: max-age=%d\nConnection: %s\r\n\r\n"
+#define HTTP_HDR_GZIP                       "Content-Encoding: gzip\nVary: Accept-Encoding\n"
+#define HTTP_HDR_VARY                       "Vary: Accept-Encoding\n"
+#define HTTP_RESPONSE_HEADERS_CACHED        "HTTP/1.1 200 OK\nContent-Length: %d\nContent-Type: %s\nConnection: "
+#define HTTP_RESPONSE_HEADERS_STREAM        "HTTP/1.1 200 OK\nContent-Type: %s\n%sConnection: %s\r\n\r\n"
+#define HTTP_HDR_CHUNKED                    "Transfer-Encoding: chunked\n"
+#define HTTP_CHUNK_HDR                      "%03x\r\n"  // fixed size chunk header (the fragments are shorter than the ring)
+#define HTTP_CHUNK_HDR_LEN                  5
+#define HTTP_CHUNK_LAST                     "0\r\n\r\n"
+#define HTTP_CONTENT_TYPE_HTML              "text/html; charset=utf-8"
+#define HTTP_CONTENT_TYPE_JSON              "application/json"
 
 // **** HOME PAGE ****
 #define HOME_REPLY_HEAD                    "<!doctype html>\
@@ -278,8 +206,7 @@ document.getElementById(\"datetime\").textContent = new Date().toLocaleString();
 <input type=\"number\" id=\"ptime\" name=\"ptime\" min=\"%d\" max=\"%d\" step=\"1\" value=\"%d\">\
 </div>"
 
-// I need to change the form to use links for setting thresholds
-// due the limitation in the lenght of the TCP message in the web server implementation using lwIP
+// the thresholds are set in dedicated pages
 #define ADVANCED_REPLY_FORM_THRESHOLDS  "<div class=\"input-group\">\
 <h3>Threshold config</h3>\
 <hr>\
@@ -357,77 +284,44 @@ document.getElementById(\"datetime\").textContent = new Date().toLocaleString();
 </body>\
 </html>"
 
-#define API_INFO_REPLY                      "{\"T\":%.2f,\"TF\":\"%s\",\"H\":%.2f}"
-
-#define HTTP_RESPONSE_REDIRECT              "HTTP/1.1 302 Redirect\nLocation: http://%s" HOME_URL "\nContent-Length: 0\nConnection: close\r\n\r\n"
-#define HTTP_RESPONSE_BAD_REQUEST           "HTTP/1.1 400 Bad Request\nContent-Length: 0\nConnection: close\r\n\r\n"
-#define HTTP_RESPONSE_NOT_FOUND             "HTTP/1.1 404 Not Found\nContent-Length: 0\nConnection: close\r\n\r\n"
-#define HTTP_RESPONSE_INTERNAL_ERROR        "HTTP/1.1 500 Internal Server Error\nContent-Length: 0\nConnection: close\r\n\r\n"
-#define HTTP_RESPONSE_NOT_IMPL_ERROR        "HTTP/1.1 501 Not implemented\nContent-Length: 0\nConnection: close\r\n\r\n"
-
-#define HTTP_NONE_URL                       "/"
-#define STYLE_URL                           "/style.css"
+// the configuration is applied at once, "saved" tells if it's already in the EEPROM, being written,
+// waiting for the end of the quiet period (deferred) or not to be saved (transient, ?persist=false)
+#define API_SET_PARAMS_ACK                  "{\"status\":\"ok\",\"saved\":\"committed\"}"
+#define API_SET_PARAMS_ACK_PENDING          "{\"status\":\"ok\",\"saved\":\"pending\"}"
+#define API_SET_PARAMS_ACK_DEFERRED         "{\"status\":\"ok\",\"saved\":\"deferred\"}"
+#define API_SET_PARAMS_ACK_TRANSIENT        "{\"status\":\"ok\",\"saved\":\"transient\"}"
+#define API_SET_PARAMS_NACK                 "{\"status\":\"error\"}"
+#define HTTP_PUSH_MAX_CLIENTS               (WLT_HTTP_MAX_CONN - 1) // event stream and WebSocket clients: keep a slot for the web pages
+#define SSE_EVENT_MAX_LEN                   96
+#define SSE_EVENT_SAMPLE                    "event: sample\ndata: {\"T\":%.2f,\"TF\":\"%s\",\"H\":%.2f}\n\n"
+#define SSE_EVENT_OUTPUTS                   "event: outputs\ndata: {\"O\":["
+#define SSE_EVENT_OUTPUTS_END               "]}\n\n"
+#define SSE_HEARTBEAT                       ":\n\n"
+// binary frames pushed to the WebSocket clients (little endian)
+#define WS_EVENT_SAMPLE                     0x01    // type, T (int16, 1/100 of the unit in TF), TF ('C' or 'F'), H (uint16, 1/100)
+#define WS_EVENT_OUTPUTS                    0x02    // type, number of outputs, bitmask of the active outputs
+#define WS_EVENT_MAX_LEN                    8
+#define API_INFO_REPLY                      "{\"T\":%.2f,\"TF\":\"%s\",\"H\":%.2f,\"G\":%u}"
+// /api/v1/history: raw samples [time, T, H], aggregates [time, count, Tmin, Tmax, Tmean, Hmin, Hmax, Hmean]
+#define API_HISTORY_HEAD                    "{\"RES\":%u,\"NOW\":%u,\"S\":["
+#define API_HISTORY_RAW                     "%s[%u,%.2f,%.2f]"
+#define API_HISTORY_AGG                     "%s[%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f]"
+#define API_HISTORY_END                     "]}"
+
+#define HTTP_RESPONSE_REDIRECT              "HTTP/1.1 302 Redirect\nLocation: http://%s" HOME_URL "\nContent-Length: 0\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_BAD_REQUEST           "HTTP/1.1 400 Bad Request\nContent-Length: 0\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_NOT_FOUND             "HTTP/1.1 404 Not Found\nContent-Length: 0\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_INTERNAL_ERROR        "HTTP/1.1 500 Internal Server Error\nContent-Length: 0\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_HEADERS_SSE           "HTTP/1.1 200 OK\nContent-Type: text/event-stream\nCache-Control: no-cache\nConnection: keep-alive\r\n\r\n"
+#define HTTP_RESPONSE_WS_UPGRADE            "HTTP/1.1 101 Switching Protocols\nUpgrade: websocket\nConnection: Upgrade\nSec-WebSocket-Accept: %s\r\n\r\n"
+#define HTTP_RESPONSE_WS_VERSION            "HTTP/1.1 426 Upgrade Required\nSec-WebSocket-Version: 13\nContent-Length: 0\nConnection: %s\r\n\r\n"
+#define HTTP_RESPONSE_UNAVAILABLE           "HTTP/1.1 503 Service Unavailable\nContent-Length: 0\nRetry-After: 1\nConnection: close\r\n\r\n"
+#define HTTP_RESPONSE_NOT_IMPL_ERROR        "HTTP/1.1 501 Not implemented\nContent-Length: 0\nConnection: %s\r\n\r\n"
+
+// the routes of the server are listed in web/routes.txt, these URLs are used in the pages and replies
 #define STYLE_FORM_DARK_URL                 "/style_form_dark.css"
 #define STYLE_FORM_LIGHT_URL                "/style_form_light.css"
-#define STYLE_HOME_DARK_URL                 "/style_dark.css"
-#define STYLE_HOME_LIGHT_URL                "/style_light.css"
-#define FAVICON_URL                         "/favicon.ico"
 #define HOME_URL                            "/home"
-#define SETTINGS_URL                        "/settings"
-#define SETTINGS_FORM_URL                   "/setparams"
-#define ADVANCED_URL                        "/advparams"
-#define ADVANCED_FORM_URL                   "/setadvparams"
-#define SET_HIGH_TEMP_URL                   "/sethightemp"
-#define SET_HIGH_TEMP_FORM_URL              "/sethightempform"
-#define SET_LOW_TEMP_URL                    "/setlowtemp"
-#define SET_LOW_TEMP_FORM_URL               "/setlowtempform"
-#define SET_HIGH_HUM_URL                    "/sethighhum"
-#define SET_HIGH_HUM_FORM_URL               "/sethighhumform"
-#define SET_LOW_HUM_URL                     "/setlowhum"
-#define SET_LOW_HUM_FORM_URL                "/setlowhumform"
-
-#define API_BASE_URL                        "/api"
-#define API_VERS                            "/v1"
-#define API_GET_INFO_URL                    API_BASE_URL API_VERS "/info"
-#define API_GET_SETTINGS_URL                API_BASE_URL API_VERS "/settings"
-#define API_SET_ALL_PARAMS_URL              API_BASE_URL API_VERS "/setallparams"
-#define API_SET_WIFI_PARAMS_URL             API_BASE_URL API_VERS "/setwifiparams"
-#define API_SET_SETTING_PARAMS_URL          API_BASE_URL API_VERS "/setsettingparams"
-#define API_SET_OUT_PARAMS_URL              API_BASE_URL API_VERS "/setoutparams"
-
-enum http_get_req {
-    HTTP_NONE,
-    HTTP_REQ_STYLE,
-    HTTP_REQ_STYLE_FORM_DARK,
-    HTTP_REQ_STYLE_FORM_LIGHT,
-    HTTP_REQ_STYLE_DARK,
-    HTTP_REQ_STYLE_LIGHT,
-    HTTP_REQ_HOME,
-    HTTP_REQ_FAVICON,
-    HTTP_REQ_SETTINGS,
-    HTTP_REQ_SETTINGS_FORM,
-    HTTP_REQ_ADVANCED,
-    HTTP_REQ_ADVANCED_FORM,
-    HTTP_REQ_SET_HIGH_TEMP,
-    HTTP_REQ_SET_HIGH_TEMP_FORM,
-    HTTP_REQ_SET_LOW_TEMP,
-    HTTP_REQ_SET_LOW_TEMP_FORM,
-    HTTP_REQ_SET_HIGH_HUM,
-    HTTP_REQ_SET_HIGH_HUM_FORM,
-    HTTP_REQ_SET_LOW_HUM,
-    HTTP_REQ_SET_LOW_HUM_FORM,
-    HTTP_API_INFO,
-    HTTP_API_GET_SETTINGS,
-    HTTP_GET_REQ_MAX
-};
-
-enum http_post_req {
-    HTTP_API_SET_ALL_PARAMS,
-    HTTP_API_SET_WIFI_PARAMS,
-    HTTP_API_SET_SETTING_PARAMS,
-    HTTP_API_SET_OUT_PARAMS,
-    HTTP_POST_REQ_MAX   
-};
 
 typedef struct TCP_SERVER_T_ {
     struct tcp_pcb *server_pcb;
@@ -435,17 +329,96 @@ typedef struct TCP_SERVER_T_ {
     ip_addr_t gw;
 } TCP_SERVER_T;
 
+#define TCP_STREAM_END                      (-1)
+
+struct TCP_CONNECT_STATE_T_;
+
+// Fill function of a reply generated by fragments: it writes the fragment "part" in buf
+// (snprintf semantic: the fragment doesn't fit if the return value is >= max) and returns
+// its length, or TCP_STREAM_END when the reply is complete.
+typedef int (*tcp_stream_fill_t)(struct TCP_CONNECT_STATE_T_ *con_state, char *buf, size_t max, int part);
+
+// Page rendered once per sample generation, sent (without copy) to all the clients asking for it
+typedef struct tcp_render_entry {
+    tcp_stream_fill_t fill;             // page (fill function of the route), NULL if the entry is empty
+    uint32_t gen;                       // wlt_sample_gen when the page was rendered
+    uint8_t theme;
+    uint8_t t_format;
+    uint8_t refs;                       // connections still sending the page: it can't be rendered again
+    uint16_t hdr_len;
+    uint16_t len;
+    char hdr[HTTP_RENDER_HDR_MAX];      // headers up to "Connection: " (with the Content-Length)
+    char body[HTTP_RENDER_BODY_MAX];
+} tcp_render_entry_t;
+
+// Position of a /api/v1/history reply: the fill function can be called again for the same part
+// (fragment not written), so the position moves to "next" only when the part changes
+typedef enum {
+    TCP_HISTORY_HEAD,
+    TCP_HISTORY_ITEMS,
+    TCP_HISTORY_END,
+    TCP_HISTORY_DONE
+} tcp_history_stage_t;
+
+typedef struct tcp_history_cursor {
+    uint8_t tier;                       // tier of the history (wlt_history.h)
+    uint8_t stage;
+    uint8_t next_stage;
+    uint32_t part;                      // part being generated
+    uint32_t seq;                       // first entry of the fragment
+    uint32_t next_seq;
+    uint32_t items;                     // entries written before the fragment
+    uint32_t next_items;
+    uint32_t to;                        // last time requested (seconds since boot)
+    uint32_t now;                       // time of the request
+} tcp_history_cursor_t;
+
 typedef struct TCP_CONNECT_STATE_T_ {
     struct tcp_pcb *pcb;
     int sent_len;
-    char headers[128];
-    char result[1152];
+    char headers[256];
     int header_len;
-    int result_len;
+    int result_len;     // length of the body written so far
     ip_addr_t *gw;
+    bool keep_alive;    // keep the connection open after the reply (HTTP/1.1 persistent connection)
+    bool busy;          // a reply is in flight, the next request must wait until it's acknowledged
+    struct pbuf *rx_pending;    // bytes received after the request (pipelined), parsed when the reply is complete
+    uint8_t idle_polls; // number of poll intervals without activity
+    uint16_t requests;  // number of requests served on this connection
+    union {
+        http_request_t req;         // request being parsed
+        ws_frame_parser_t ws_rx;    // frames received, after the upgrade to WebSocket
+    };
+    const uint8_t *static_data; // static asset (in flash) still to be written
+    int static_len;             // number of bytes of the static asset still to be written
+    tcp_render_entry_t *render; // cached page being sent (static_data points to its body)
+    tcp_stream_fill_t stream_fill;  // fill function of the reply being generated, NULL when complete
+    uint32_t stream_part;           // next fragment to generate
+    bool chunked;                   // the reply uses "Transfer-Encoding: chunked"
+    uint16_t ring_head;             // write position in the ring
+    uint16_t ring_tail;             // oldest byte not yet acknowledged
+    uint16_t ring_used;             // bytes not yet acknowledged
+    uint16_t ring_wrap;             // end of the data before the write position wrapped (0 if not wrapped)
+    char ring[HTTP_STREAM_RING_SIZE];   // fragments of the reply (and the body of the POST request)
+    bool sse;                           // subscribed to the event stream (/api/v1/stream)
+    bool ws;                            // upgraded to WebSocket (/api/v1/ws)
+    bool ws_closing;                    // close frame sent, close the connection when it's acknowledged
+    bool parked;                        // /api/v1/info?since= waiting for a new sample
+    uint8_t park_polls;                 // number of poll intervals the request has been waiting
+    tcp_history_cursor_t history;       // position of the /api/v1/history reply
+    uint32_t idle_seq;                  // order in which the connections became idle (to shed the oldest)
+    struct TCP_CONNECT_STATE_T_ *next_free; // next slot of the free list
 } TCP_CONNECT_STATE_T;
 
+// events pushed to the subscribers of /api/v1/stream and /api/v1/ws
+typedef enum {
+    TCP_SSE_SAMPLE,                     // new sensor data
+    TCP_SSE_OUTPUTS                     // change of the outputs state
+} tcp_sse_event_t;
+
 bool tcp_server_open(void *arg, const char *ap_name);
+void tcp_server_notify(tcp_sse_event_t event);
+void tcp_server_wake(void);
 void tcp_server_close(TCP_SERVER_T *state);
 
 #endif // WLT_TCP_H
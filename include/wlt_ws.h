@@ -0,0 +1,64 @@
+#ifndef WLT_WS_H
+#define WLT_WS_H
+
+#include "stdbool.h"
+#include "stdint.h"
+#include "stddef.h"
+
+#define WS_KEY_MAX_LEN                      32  // Sec-WebSocket-Key: base64 of 16 bytes (24 chars)
+#define WS_ACCEPT_LEN                       28  // Sec-WebSocket-Accept: base64 of the SHA-1 (20 bytes)
+#define WS_GUID                             "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_MSG_MAX_LEN                      384 // max length of a message received (one byte is reserved for the terminator)
+#define WS_CTRL_MAX_LEN                     125 // max payload of a control frame (RFC 6455)
+#define WS_HDR_MAX_LEN                      4   // header of a frame sent by the server (payload < 64KB, not masked)
+
+#define WS_OPCODE_CONT                      0x0
+#define WS_OPCODE_TEXT                      0x1
+#define WS_OPCODE_BINARY                    0x2
+#define WS_OPCODE_CLOSE                     0x8
+#define WS_OPCODE_PING                      0x9
+#define WS_OPCODE_PONG                      0xA
+
+#define WS_CLOSE_NORMAL                     1000
+#define WS_CLOSE_PROTOCOL_ERROR             1002
+#define WS_CLOSE_UNSUPPORTED                1003
+#define WS_CLOSE_TOO_BIG                    1009
+
+typedef enum {
+    WS_PARSE_HDR,           // first two bytes: FIN, opcode, mask bit, length
+    WS_PARSE_LEN,           // extended payload length (16 or 64 bits)
+    WS_PARSE_MASK,          // masking key
+    WS_PARSE_PAYLOAD,       // payload, unmasked while it's copied
+    WS_PARSE_DONE,          // frame complete
+    WS_PARSE_ERROR          // protocol error or payload too large
+} ws_parse_state_t;
+
+// Resumable parser of the frames sent by the client.
+// Data frames are collected in payload until the message is complete (FIN), control frames
+// (that can be interleaved with the fragments of a message) in ctrl.
+typedef struct ws_frame_parser {
+    ws_parse_state_t state;
+    uint16_t close_code;            // reason of the error (WS_CLOSE_*)
+    uint8_t hdr[2];
+    uint8_t opcode;                 // opcode of the frame being parsed
+    uint8_t msg_opcode;             // opcode of the message being collected (WS_OPCODE_CONT when none)
+    bool fin;
+    uint8_t pos;                    // position in the extended length or in the mask
+    uint8_t len_size;               // size of the extended length (0, 2 or 8 bytes)
+    uint8_t mask[4];
+    uint64_t len;                   // payload length of the frame
+    uint64_t done;                  // payload bytes of the frame already received
+    uint16_t msg_len;
+    uint8_t ctrl_len;
+    char payload[WS_MSG_MAX_LEN];
+    char ctrl[WS_CTRL_MAX_LEN];
+} ws_frame_parser_t;
+
+bool ws_accept_key(const char *key, char *accept, size_t max);
+void ws_parser_init(ws_frame_parser_t *ws);
+int ws_parser_feed(ws_frame_parser_t *ws, const uint8_t *data, int len);
+bool ws_parser_message(ws_frame_parser_t *ws);
+void ws_parser_next(ws_frame_parser_t *ws);
+int ws_frame_header(uint8_t *hdr, uint8_t opcode, size_t len);
+
+#endif // WLT_WS_H
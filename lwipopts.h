@@ -22,6 +22,15 @@
 #define MEM_SIZE                    4000
 #define MEMP_NUM_TCP_SEG            32
 #define MEMP_NUM_ARP_QUEUE          10
+#ifndef WLT_HTTP_MAX_CONN
+#define WLT_HTTP_MAX_CONN           4
+#endif
+#ifndef WLT_HTTP_BACKLOG
+#define WLT_HTTP_BACKLOG            2
+#endif
+// one pcb per HTTP slot and per pending connection, plus one to answer 503 when the slots are full
+#define MEMP_NUM_TCP_PCB            (WLT_HTTP_MAX_CONN + WLT_HTTP_BACKLOG + 1)
+#define TCP_LISTEN_BACKLOG          1
 #define PBUF_POOL_SIZE              24
 #define LWIP_ARP                    1
 #define LWIP_ETHERNET               1
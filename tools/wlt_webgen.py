@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+"""
+wlt_webgen.py - build time generator of the web assets of the firmware.
+
+Every asset given on the command line is minified (CSS/HTML), compressed with
+gzip and written as a const C array in wlt_web_assets.c; wlt_web_assets.h
+contains the asset table (sorted by path) with content type, lengths and a
+strong ETag computed on the content, so nothing has to be formatted or
+compressed at run time.
+
+The routes file lists the dynamic routes of the server (method, path and
+handler); with the assets (GET routes served by tcp_route_asset()) they
+are written in wlt_web_routes.c as a perfect hash table: a route is found with
+one hash of method, path length and path, and one compare.
+
+Usage: wlt_webgen.py --out <dir> --routes <file> <asset> [<asset> ...]
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+CONTENT_TYPES = {
+    ".css": "text/css; charset=utf-8",
+    ".html": "text/html; charset=utf-8",
+    ".htm": "text/html; charset=utf-8",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+    ".svg": "image/svg+xml",
+}
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    # no space is needed around the punctuation (spaces before ':' are kept,
+    # they are meaningful in selectors)
+    text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+    text = re.sub(r":\s+", ":", text)
+    text = text.replace(";}", "}")
+    return text.strip()
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    text = re.sub(r">\s+<", "><", text)
+    text = re.sub(r"\s+", " ", text)
+    return text.strip()
+
+
+MINIFIERS = {
+    ".css": minify_css,
+    ".html": minify_html,
+    ".htm": minify_html,
+}
+
+
+def c_name(path):
+    return "wlt_web_" + re.sub(r"[^0-9A-Za-z]", "_", path.lstrip("/"))
+
+
+def c_array(name, data):
+    lines = ["static const uint8_t %s[%d] = {" % (name, len(data))]
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def etag(data):
+    return '"' + hashlib.sha1(data).hexdigest()[:16] + '"'
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def load_asset(filename):
+    ext = os.path.splitext(filename)[1].lower()
+    if ext not in CONTENT_TYPES:
+        sys.exit("wlt_webgen: unknown content type for %s" % filename)
+    with open(filename, "rb") as f:
+        data = f.read()
+    if ext in MINIFIERS:
+        data = MINIFIERS[ext](data.decode("utf-8")).encode("utf-8")
+    # mtime=0: the output depends only on the content (reproducible builds)
+    gz = gzip.compress(data, compresslevel=9, mtime=0)
+    asset = {
+        "path": "/" + os.path.basename(filename),
+        "type": CONTENT_TYPES[ext],
+        "data": data,
+        "etag": etag(data),
+        "gz": None,
+    }
+    asset["name"] = c_name(asset["path"])
+    if len(gz) < len(data):
+        asset["gz"] = gz
+        asset["gz_etag"] = etag(gz)
+    return asset
+
+
+ROUTE_METHODS = {"GET": 1, "POST": 2}
+ROUTE_ASSET_HANDLER = "tcp_route_asset"
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+
+def load_routes(filename):
+    routes = []
+    with open(filename, "r") as f:
+        for num, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            if len(fields) != 3 or fields[0] not in ROUTE_METHODS or not fields[1].startswith("/"):
+                sys.exit("wlt_webgen: %s:%d: expected <GET|POST> </path> <handler>" % (filename, num))
+            routes.append({"method": fields[0], "path": fields[1], "handler": fields[2], "asset": None})
+    return routes
+
+
+def route_hash(seed, method, path):
+    # FNV-1a of method, length and path (same as wlt_route_hash() in C)
+    h = (FNV_OFFSET ^ seed) & 0xffffffff
+    for b in [ROUTE_METHODS[method], len(path)] + list(path.encode("utf-8")):
+        h = ((h ^ b) * FNV_PRIME) & 0xffffffff
+    return h
+
+
+def perfect_hash(routes):
+    # smallest power of two table (at least twice the routes) with a seed without collisions
+    size = 1
+    while size < 2 * len(routes):
+        size *= 2
+    while True:
+        for seed in range(100000):
+            slots = {}
+            for i, r in enumerate(routes):
+                slot = route_hash(seed, r["method"], r["path"]) & (size - 1)
+                if slot in slots:
+                    break
+                slots[slot] = i
+            else:
+                return seed, size, slots
+        size *= 2
+
+
+def write_file(filename, text):
+    with open(filename, "w") as f:
+        f.write(text)
+
+
+def gen_header(assets):
+    return """// Generated by tools/wlt_webgen.py, do not edit
+#ifndef WLT_WEB_ASSETS_H
+#define WLT_WEB_ASSETS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WLT_WEB_ASSETS_NUM                  %d
+
+typedef struct wlt_web_asset {
+    const char *path;           // URL of the asset
+    uint16_t path_len;          // length of the URL
+    const char *content_type;   // value of the Content-Type header
+    const uint8_t *data;        // content of the asset (minified)
+    uint32_t len;               // length of the content
+    const uint8_t *gz_data;     // gzip content, NULL if gzip doesn't reduce the size
+    uint32_t gz_len;            // length of the gzip content
+    const char *etag;           // strong ETag of the content (quoted)
+    const char *gz_etag;        // strong ETag of the gzip content (quoted)
+} wlt_web_asset_t;
+
+// asset table, sorted by path
+extern const wlt_web_asset_t wlt_web_assets[WLT_WEB_ASSETS_NUM];
+
+#endif // WLT_WEB_ASSETS_H
+""" % len(assets)
+
+
+def gen_source(assets):
+    out = ["// Generated by tools/wlt_webgen.py, do not edit",
+           '#include "wlt_web_assets.h"',
+           ""]
+    for a in assets:
+        out.append("// %s: %d bytes, gzip %s" % (a["path"], len(a["data"]),
+                                                 "%d bytes" % len(a["gz"]) if a["gz"] else "not used"))
+        out.append(c_array(a["name"], a["data"]))
+        if a["gz"]:
+            out.append(c_array(a["name"] + "_gz", a["gz"]))
+        out.append("")
+
+    out.append("const wlt_web_asset_t wlt_web_assets[WLT_WEB_ASSETS_NUM] = {")
+    for a in assets:
+        gz = a["gz"]
+        out.append("    {%s, %d, %s, %s, %d, %s, %d, %s, %s}," % (
+            c_string(a["path"]), len(a["path"]), c_string(a["type"]),
+            a["name"], len(a["data"]),
+            a["name"] + "_gz" if gz else "NULL", len(gz) if gz else 0,
+            c_string(a["etag"]), c_string(a["gz_etag"]) if gz else "NULL"))
+    out.append("};")
+    out.append("")
+    return "\n".join(out)
+
+
+def gen_routes_header(routes, size):
+    protos = sorted(set(r["handler"] for r in routes))
+    return """// Generated by tools/wlt_webgen.py, do not edit
+#ifndef WLT_WEB_ROUTES_H
+#define WLT_WEB_ROUTES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lwip/err.h"
+#include "wlt_web_assets.h"
+
+#define WLT_ROUTES_NUM                      %d
+#define WLT_ROUTES_HASH_SIZE                %d
+
+typedef enum {
+    WLT_ROUTE_NONE,
+    WLT_ROUTE_GET,
+    WLT_ROUTE_POST
+} wlt_route_method_t;
+
+struct TCP_CONNECT_STATE_T_;
+struct tcp_pcb;
+struct wlt_route;
+
+// the handler processes the request and sends the reply
+typedef err_t (*wlt_route_handler_t)(struct TCP_CONNECT_STATE_T_ *con_state, struct tcp_pcb *pcb, const struct wlt_route *route);
+
+typedef struct wlt_route {
+    const char *path;               // URL of the route
+    uint8_t path_len;               // length of the URL
+    uint8_t method;                 // wlt_route_method_t
+    wlt_route_handler_t handler;    // handler of the request
+    const wlt_web_asset_t *asset;   // static asset, NULL for the dynamic routes
+} wlt_route_t;
+
+extern const wlt_route_t wlt_routes[WLT_ROUTES_NUM];
+
+const wlt_route_t *wlt_route_find(wlt_route_method_t method, const char *path, size_t len);
+
+// handlers (implemented by the server)
+%s
+
+#endif // WLT_WEB_ROUTES_H
+""" % (len(routes), size,
+       "\n".join("err_t %s(struct TCP_CONNECT_STATE_T_ *con_state, struct tcp_pcb *pcb, const wlt_route_t *route);" % h
+                 for h in protos))
+
+
+def gen_routes_source(routes, seed, size, slots):
+    out = ["// Generated by tools/wlt_webgen.py, do not edit",
+           "#include <string.h>",
+           '#include "wlt_web_routes.h"',
+           "",
+           "#define WLT_ROUTES_HASH_SEED                %du" % seed,
+           "",
+           "const wlt_route_t wlt_routes[WLT_ROUTES_NUM] = {"]
+    for r in routes:
+        out.append("    {%s, %d, WLT_ROUTE_%s, %s, %s}," % (
+            c_string(r["path"]), len(r["path"]), r["method"], r["handler"],
+            "&wlt_web_assets[%d]" % r["asset"] if r["asset"] is not None else "NULL"))
+    out.append("};")
+    out.append("")
+    out.append("// index + 1 of the route in wlt_routes[], 0 if the slot is empty")
+    out.append("static const uint8_t wlt_routes_hash[WLT_ROUTES_HASH_SIZE] = {")
+    cells = [str(slots[i] + 1) if i in slots else "0" for i in range(size)]
+    for i in range(0, size, 16):
+        out.append("    " + ", ".join(cells[i:i + 16]) + ",")
+    out.append("};")
+    out.append("""
+/*
+ * Function: wlt_route_hash()
+ * Description: This function computes the hash (FNV-1a) of method, path length and path.
+ */
+static uint32_t wlt_route_hash(wlt_route_method_t method, const char *path, size_t len)
+{
+    uint32_t h = %du ^ WLT_ROUTES_HASH_SEED;
+
+    h = (h ^ (uint8_t)method) * %du;
+    h = (h ^ (uint8_t)len) * %du;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)path[i]) * %du;
+    }
+    return h;
+}
+
+/*
+ * Function: wlt_route_find()
+ * Description: This function looks for the route of a request: the hash gives the only candidate,
+ * so the cost doesn't depend on the number of routes.
+ * It returns a pointer to the route or NULL if the route doesn't exist.
+ */
+const wlt_route_t *wlt_route_find(wlt_route_method_t method, const char *path, size_t len)
+{
+    uint8_t index;
+    const wlt_route_t *route;
+
+    if (len > UINT8_MAX) {
+        return NULL;
+    }
+    index = wlt_routes_hash[wlt_route_hash(method, path, len) & (WLT_ROUTES_HASH_SIZE - 1)];
+    if (index == 0) {
+        return NULL;
+    }
+    route = &wlt_routes[index - 1];
+    if ((route->method != method) || (route->path_len != len) || (memcmp(route->path, path, len) != 0)) {
+        return NULL;
+    }
+    return route;
+}
+""" % (FNV_OFFSET, FNV_PRIME, FNV_PRIME, FNV_PRIME))
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the web assets of the firmware")
+    parser.add_argument("--out", required=True, help="output directory")
+    parser.add_argument("--routes", required=True, help="routes file (method, path, handler)")
+    parser.add_argument("assets", nargs="+", help="asset files (served as /<file name>)")
+    args = parser.parse_args()
+
+    assets = [load_asset(f) for f in args.assets]
+    # the asset table is sorted by path
+    assets.sort(key=lambda a: a["path"].encode("utf-8"))
+    for prev, cur in zip(assets, assets[1:]):
+        if prev["path"] == cur["path"]:
+            sys.exit("wlt_webgen: duplicated path %s" % cur["path"])
+
+    routes = load_routes(args.routes)
+    for i, a in enumerate(assets):
+        routes.append({"method": "GET", "path": a["path"], "handler": ROUTE_ASSET_HANDLER, "asset": i})
+    keys = set()
+    for r in routes:
+        if (r["method"], r["path"]) in keys:
+            sys.exit("wlt_webgen: duplicated route %s %s" % (r["method"], r["path"]))
+        if len(r["path"]) > 255:
+            sys.exit("wlt_webgen: route path too long %s" % r["path"])
+        keys.add((r["method"], r["path"]))
+    seed, size, slots = perfect_hash(routes)
+
+    os.makedirs(args.out, exist_ok=True)
+    write_file(os.path.join(args.out, "wlt_web_assets.h"), gen_header(assets))
+    write_file(os.path.join(args.out, "wlt_web_assets.c"), gen_source(assets))
+    write_file(os.path.join(args.out, "wlt_web_routes.h"), gen_routes_header(routes, size))
+    write_file(os.path.join(args.out, "wlt_web_routes.c"), gen_routes_source(routes, seed, size, slots))
+
+
+if __name__ == "__main__":
+    main()
@@ -18,23 +18,33 @@
 #include "include/uart.h"
 #include "include/eeprom_24LC256.h"
 #include "include/rgb.h"
+#include "include/wlt_fmt.h"
+#include "include/wlt_sample.h"
+#include "include/wlt_history.h"
+#include "include/wlt_journal.h"
+#include "include/wlt_config.h"
+#include "include/wlt_core1.h"
 
 // global variables
 wlt_run_time_config_t *prtconfig;
 wlt_config_data_t *pconfig;
+uint32_t wlt_sample_gen = 0;    // bumped when the data shown by the pages changes
 
 /*
  * Function: wlt_update_outputs_state()
  * Description: Update the state of all output GPIOs based on the current sensor data and trigger conditions.
+ * It returns true if the state of an output has changed.
  */
-void wlt_update_outputs_state(wlt_run_time_config_t *config)
+bool wlt_update_outputs_state(wlt_run_time_config_t *config)
 {
+    bool changed = false;
+
     for (int i = 0; i < OUTPUT_GPIO_MAX; i++) {
         outputs_t *output = &config->data.outputs[i];
         wlt_outputs_rt_t *output_rt = &config->outputs_rt[i];
 
         // Determine the current value of the monitored data
-        float current_value = 0.0;
+        int32_t current_value = 0;
         switch (output->data_type) {
             case WLT_DATA_TYPE_TEMP:
                 current_value = config->data.temperature;
@@ -69,6 +79,7 @@ void wlt_update_outputs_state(wlt_run_time_config_t *config)
                 gpio_put(output->gpio_num, 1); // Set GPIO high
                 output_rt->gpio_state = true;
                 output_rt->counter = 0; // Reset counter when triggered
+                changed = true;
                 PRINT_DEBUG("Activate output %d (GPIO=%d)\n", i, output->gpio_num);
             }
         } else {
@@ -77,6 +88,7 @@ void wlt_update_outputs_state(wlt_run_time_config_t *config)
                     gpio_put(output->gpio_num, 0); // Set GPIO low
                     output_rt->gpio_state = false;
                     output_rt->counter = 0; // Reset counter after deactivation
+                    changed = true;
                     PRINT_DEBUG("Deactivate output %d (GPIO=%d)\n", i, output->gpio_num);
                 } else {
                     output_rt->counter++; // Increment counter while condition is not met
@@ -84,22 +96,23 @@ void wlt_update_outputs_state(wlt_run_time_config_t *config)
             }
         }
     }
+    return changed;
 }
 
 /*
  * Function: wlt_send_to_uart()
- * Send to UART the temperature and humidity in the requested format.
+ * Send to UART the temperature and humidity (hundredths of degree Celsius and of %RH) in the requested format.
  */
-void wlt_send_to_uart(float temperature, float humidity, uint8_t temp_format, uint8_t out_format)
+void wlt_send_to_uart(int32_t temperature, int32_t humidity, uint8_t temp_format, uint8_t out_format)
 {
-    char app_string[24];
-    float temp;
+    char app_string[32];
+    int32_t temp = temperature;
+    int32_t hum = humidity;
 
     memset(app_string,0,sizeof(app_string));
+    // fixed point values (hundredths): no float formatting
     if(temp_format == T_FORMAT_FAHRENHEIT)
-        temp = C2F(temperature);
-    else
-        temp = temperature;
+        temp = fmt_centi_c2f(temperature);
 
     switch(out_format)
     {
@@ -107,14 +120,14 @@ void wlt_send_to_uart(float temperature, float humidity, uint8_t temp_format, ui
             // add \r\n in order to be sure to print one measure on each line 
             // in the Windows/Unix terminal (without change its configuration)
             if(temp_format == T_FORMAT_FAHRENHEIT)
-                sprintf(app_string,"%.02f °F - %.02f %%RH\r\n",temp,humidity);
+                fmt_format(app_string,sizeof(app_string),"%.02f °F - %.02f %%RH\r\n",temp,hum);
             else
-                sprintf(app_string,"%.02f °C - %.02f %%RH\r\n",temp,humidity);
+                fmt_format(app_string,sizeof(app_string),"%.02f °C - %.02f %%RH\r\n",temp,hum);
             break;
 
         case OUT_FORMAT_CSV:
             // use ";" as CSV separator
-            sprintf(app_string,"%.02f;%.02f\r\n",temp,humidity);
+            fmt_format(app_string,sizeof(app_string),"%.02f;%.02f\r\n",temp,hum);
             break;
         
         default:
@@ -126,6 +139,44 @@ void wlt_send_to_uart(float temperature, float humidity, uint8_t temp_format, ui
     return;
 }
 
+/*
+ * Function: wlt_sensor_sample()
+ * Description: This function handles a new sample notified by core 1 (see wlt_core1.c): the values
+ * are already published (wlt_sample_read()), it updates the outputs status and the subscribers.
+ * DHT20_READ_IDLE means that the sensor is not available.
+ */
+void wlt_sensor_sample(const wlt_sample_msg_t *sample)
+{
+    for (int i = 0; i < OUTPUT_GPIO_MAX; i++) {
+        prtconfig->outputs_rt[i].gpio_state = sample->gpio_state[i];
+    }
+    if (sample->result == DHT20_READ_OK) {
+        char t_str[FMT_NUM_MAX_LEN];
+        char h_str[FMT_NUM_MAX_LEN];
+        wlt_sample_t snapshot;
+        uint32_t ts;
+        wlt_sample_read(&snapshot);
+        fmt_fixed(t_str, sizeof(t_str), snapshot.temperature, 2);
+        fmt_fixed(h_str, sizeof(h_str), snapshot.humidity, 2);
+        printf("DHT20 sensor data read successfully: Temperature = %s, Humidity = %s\n", t_str, h_str);
+        ts = wlt_history_time(snapshot.timestamp_ms);
+        wlt_history_add(ts, snapshot.temperature, snapshot.humidity);
+        wlt_journal_add(ts, snapshot.temperature, snapshot.humidity);
+        // Push the new data to the subscribers of the event stream
+        tcp_server_notify(TCP_SSE_SAMPLE);
+        if (sample->outputs_changed) {
+            tcp_server_notify(TCP_SSE_OUTPUTS);
+        }
+    } else if (sample->result == DHT20_READ_ERROR) {
+        printf("Failed to read DHT20 sensor data\n");
+    }
+    // new sample (or sensor error): the cached pages must be rendered again
+    wlt_sample_gen++;
+    // complete the requests waiting for it (/api/v1/info?since=)
+    tcp_server_wake();
+    return;
+}
+
 /*
  * Function: wlt_init_uart() 
 */
@@ -183,148 +234,6 @@ void wlt_init_port_sensor(void)
 }
 
 
-/*
- * High level EEPROM functions
-*/ 
-
-/*
- * Function: wlt_read_config()
- * Description: This function reads the configuration from the EEPROM.
- * It returns EE_SUCCESS if the configuration is read correctly, otherwise it returns EE_ERROR. 
-*/
-int wlt_read_config(BYTE *config, int len)
-{
-    int ret;
-
-    PRINT_DEBUG_N("Read config from EEPROM\n");
-
-    ret = i2c_eeprom_read(EEPROM_START_ADDR, config, len);
-
-#if DEBUG
-    int i;
-
-    // print the content of memory read
-    for(i=0; i<len; i++)
-    {
-        printf("0x%02X ",config[i]);
-        if((i + 1) % 8 == 0)
-            printf("\n");
-    }
-#endif
-
-    return ret;
-}
-
-/*
- * Function: wlt_write_config()
- * Description: This function writes the configuration to the EEPROM.
- * It returns EE_SUCCESS if the configuration is written correctly, otherwise it returns EE_ERROR.
-*/
-int wlt_write_config(BYTE *config, int len)
-{
-    int ret = EE_SUCCESS;
-
-    PRINT_DEBUG_N("Write config to EEPROM\n");
-
-    ret = i2c_eeprom_write(EEPROM_START_ADDR, config, len);
-
-    return ret;
-}
-
-/*
- * Function: check_config()
- * Description: This function checks the configuration read from the EEPROM.
- * It returns EE_SUCCESS if the configuration is valid, otherwise it returns EE_ERROR.
- * The configuration is valid if the control word matches the expected value.
-*/
-int wlt_check_config(BYTE *signature, int len)
-{
-    if (signature == NULL || len < EEPROM_CTRL_WORD_LEN) {
-        return EE_ERROR;
-    }
-
-    // Check the control word
-    if (memcmp(signature, EEPROM_CTRL_WORD, EEPROM_CTRL_WORD_LEN) != 0) {
-        return EE_ERROR;
-    }
-
-    return EE_SUCCESS;
-}
-
-/**
- * Function: wlt_update_config()
- * Description: This function updates the configuration (saved in the EEPROM)
- * with the provided runtime configuration data.
- */
-void wlt_update_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config)
-{
-    if (rt_config == NULL || config == NULL) {
-        printf("Invalid argument: rt_config or config is NULL\n");
-        return;
-    }
-    strncpy(config->devicename,rt_config->net_config.devicename, sizeof(config->devicename) - 1);
-    config->devicename[sizeof(config->devicename) - 1] = '\0'; // Ensure null termination
-    strncpy(config->wifi_ssid, rt_config->net_config.wifi_ssid, sizeof(config->wifi_ssid) - 1);
-    config->wifi_ssid[sizeof(config->wifi_ssid) - 1] = '\0'; // Ensure null termination
-    strncpy(config->wifi_pass, rt_config->net_config.wifi_pass, sizeof(config->wifi_pass) - 1);
-    config->wifi_pass[sizeof(config->wifi_pass) - 1] = '\0'; // Ensure null termination
-    config->settings.all_options = rt_config->data.settings.all_options;
-    memcpy((void *)&(config->outputs[0]),(void *)&(rt_config->data.outputs[0]), sizeof(outputs_t));
-    memcpy((void *)&(config->outputs[1]), (void *)&(rt_config->data.outputs[1]), sizeof(outputs_t));
-    // Copy the signature (includes \0 at the end)
-    strncpy(config->signature, EEPROM_CTRL_WORD, EEPROM_CTRL_WORD_LEN);
- 
-    return;
-}
-
-/*
- * Function: wlt_load_config()
- * Description: This function loads the configuration from the EEPROM into the runtime configuration.
- * It does not return any value.
- */
-void wlt_load_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config)
-{
-    if (rt_config == NULL || config == NULL) {
-        printf("Invalid argument: rt_config or config is NULL\n");
-        return;
-    }
-    // Copy the device name
-    strncpy(rt_config->net_config.devicename, config->devicename, sizeof(rt_config->net_config.devicename) - 1);
-    rt_config->net_config.devicename[sizeof(rt_config->net_config.devicename) - 1] = '\0'; // Ensure null termination
-    // Copy the WiFi SSID and password
-    strncpy(rt_config->net_config.wifi_ssid, config->wifi_ssid, sizeof(rt_config->net_config.wifi_ssid) - 1);
-    rt_config->net_config.wifi_ssid[sizeof(rt_config->net_config.wifi_ssid) - 1] = '\0'; // Ensure null termination
-    strncpy(rt_config->net_config.wifi_pass, config->wifi_pass, sizeof(rt_config->net_config.wifi_pass) - 1);
-    rt_config->net_config.wifi_pass[sizeof(rt_config->net_config.wifi_pass) - 1] = '\0'; // Ensure null termination
-    rt_config->data.settings.all_options = config->settings.all_options;
-
-    memcpy((void *)&(rt_config->data.outputs[0]),(void *)&(config->outputs[0]), sizeof(outputs_t));
-    memcpy((void *)&(rt_config->data.outputs[1]), (void *)&(config->outputs[1]), sizeof(outputs_t));
-
-    return;
-}
-
-/**
- * Function: wlt_update_and_save_config()
- * Description: This function updates the runtime configuration with the provided configuration data
- * and saves it to the EEPROM.
- * It does not return any value.
- */
-void wlt_update_and_save_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config)
-{
-    wlt_update_config(prtconfig, pconfig);
-    // I don't want to save some runtime data located in settings field (TODO change their position)
-    pconfig->settings.options.sens_avail = SENS_NOT_AVAILABLE;
-    pconfig->settings.options.data_valid = SENS_DATA_NOT_VALID;
-    // Save the configuration to EEPROM
-    if (wlt_write_config((BYTE *)pconfig, sizeof(wlt_config_data_t)) != EE_SUCCESS) {
-        printf("*** ERROR ****\nUnable to write EEPROM (I2C) Memory\n");
-    } else {
-        printf("Configuration written to EEPROM\n");
-    }
-    return;
-}         
-
 /*
 * Function: wlt_init_run_time_config()
 * Description: This function initializes the runtime configuration with default values. 
@@ -347,18 +256,18 @@ void wlt_init_run_time_config(wlt_run_time_config_t *config)
     config->data.settings.options.trd_hyst = 3; // Default threshold hysteresis is 3 consecutive reads
     config->data.settings.options.sens_avail = SENS_NOT_AVAILABLE; // Sensor not available by default
     config->data.settings.options.data_valid = SENS_DATA_NOT_VALID; // Data not valid by default
-    config->data.temperature = 0.0f; // Initialize temperature
-    config->data.humidity = 0.0f; // Initialize humidity
-    config->data.pressure = 0.0f; // Initialize pressure
+    config->data.temperature = 0; // Initialize temperature
+    config->data.humidity = 0; // Initialize humidity
+    config->data.pressure = 0; // Initialize pressure
 
     config->data.outputs[0].data_type = WLT_DATA_TYPE_TEMP; // Initialize output 1 type to TEMPERATURE
     config->data.outputs[0].gpio_num = GPIO_OUTPUT_1; // Initialize output 1 GPIO number to GPIO_OUTPUT_1
-    config->data.outputs[0].threshold = 0.0f; // Initialize output 1 threshold to 0
+    config->data.outputs[0].threshold = 0; // Initialize output 1 threshold to 0
     config->data.outputs[0].trigger = TRD_TRIGGER_HIGH; // Initialize output 1 trigger to high (output will be triggered when the temperature is above the threshold)
 
     config->data.outputs[1].data_type = WLT_DATA_TYPE_HUMIDITY; // Initialize output 2 type to HUMIDITY
     config->data.outputs[1].gpio_num = GPIO_OUTPUT_2; // Initialize output 2 GPIO number to GPIO_OUTPUT_2
-    config->data.outputs[1].threshold = 0.0f; // Initialize output 2 threshold to 0
+    config->data.outputs[1].threshold = 0; // Initialize output 2 threshold to 0
     config->data.outputs[1].trigger = TRD_TRIGGER_HIGH; // Initialize output 2 trigger to high (output will be triggered when the humidity is above the threshold)
 
     config->outputs_rt[0].gpio_state = false; // Initialize GPIO output state to false
@@ -531,7 +440,7 @@ void wlt_update_rgb_led(uint8_t mode, wlt_rgb_led_t *led_status, int64_t tick)
                 } else {
                     color = RGB_LED_ON_FAIL; // Default to red if mode is unknown
                 }
-                printf("Timeout led = %.02f [s] - Led was OFF, switch on to color %d\n", (float)(delta/1000000), (color & ~RGB_BLINK_OPT));
+                printf("Timeout led = %u [s] - Led was OFF, switch on to color %d\n", (unsigned int)(delta/1000000), (color & ~RGB_BLINK_OPT));
                 wlt_set_led_color(color, led_status); // Turn on the LED
             }
         }
@@ -542,7 +451,7 @@ void wlt_update_rgb_led(uint8_t mode, wlt_rgb_led_t *led_status, int64_t tick)
                 return;
             } else {
                 // Timer has expired, turn off the LED
-                printf("Timeout led = %.02f [s] - Led was ON with color %d, switch OFF\n", (float)(delta/1000000), led_status->color);
+                printf("Timeout led = %u [s] - Led was ON with color %d, switch OFF\n", (unsigned int)(delta/1000000), led_status->color);
                 wlt_set_led_color(RGB_COLOR_OFF, led_status); // Turn off the LED
             }
         }
@@ -606,6 +515,7 @@ void wlt_goto_error(int led_color)
 int main()
 {
     int ret;
+    wlt_sample_msg_t sample;
     wlt_run_time_config_t run_time_config;
     wlt_config_data_t config;
     wlt_rgb_led_t rgb_led;
@@ -613,7 +523,8 @@ int main()
     dns_server_t dns_server;
     wls_server_t wls_server;
     char led_on = 1;
-    volatile int64_t tick, pre_tick;
+    volatile int64_t tick;
+    uint64_t led_toggle_time;
 
     prtconfig = &run_time_config;
     pconfig = &config;
@@ -637,35 +548,28 @@ int main()
     wlt_set_led_color(RGB_LED_ON_BOOT,&rgb_led); // Set the LED color on boot
 
     // search config reading from memory
-    ret = 0;
     // set default configuration
     wlt_init_run_time_config(prtconfig);
     memset(&config, 0x0, sizeof(config));
-    if (wlt_read_config((BYTE *)&config, sizeof(config)) != EE_SUCCESS) {
+    ret = wlt_config_read(pconfig);
+    if (ret == EE_ERROR) {
         printf("*** ERROR ****\nUnable to read EEPROM (I2C) Memory\n");
         wlt_goto_error(RGB_LED_ON_FAIL);
+    } else if (ret == EE_SUCCESS) {
+        printf("Configuration read successfully from EEPROM\n");
+        // configuration read successfully, initialize the runtime configuration loading data from EEPROM
+        wlt_load_config(prtconfig, pconfig);
     } else {
-        printf("Config data CTRL WORD: %s\n", (char *)&config.signature);
-        // check if the configuration read is valid
-        if (wlt_check_config((char *)pconfig->signature, sizeof(config.signature)) != EE_SUCCESS) {
-            printf("*** ERROR ****\nInvalid configuration read from EEPROM (I2C) Memory\n");
-            wlt_goto_error(RGB_LED_ON_FAIL);
-        } else {
-            printf("Configuration read successfully from EEPROM\n");
-            // configuration read successfully, initialize the runtime configuration loading data from EEPROM
-            wlt_load_config(prtconfig, pconfig);
-        }
-    }
-    if (ret != 0) {
+        // no valid configuration in both slots (e.g. first boot)
         printf("Failed to read configuration, using default values\n");
         wlt_update_config(prtconfig, pconfig);
-        // save the default configuration to EEPROM
-        if (wlt_write_config((BYTE *)&config, sizeof(config)) != EE_SUCCESS) {
-            printf("*** ERROR ****\nUnable to write EEPROM (I2C) Memory\n");
-            wlt_goto_error(RGB_LED_ON_FAIL);
-        } else {
-            printf("Default configuration written to EEPROM\n");
-        }
+        // save the default configuration to EEPROM (written by the main loop)
+        wlt_config_write(pconfig);
+    }
+
+    // restore the history from the journal: the device time goes on from its last sample
+    if (wlt_journal_init(wlt_history_add)) {
+        wlt_history_set_epoch(wlt_journal_last_ts() + 1);
     }
 
     if (DHT20_init() != 0) {
@@ -773,46 +677,37 @@ int main()
     }
     printf("Server opened successfully\n");
 
-    pre_tick = time_us_64();
+    // sensor, outputs and UART run on core 1 from now on
+    wlt_core1_launch(prtconfig);
 
+    led_toggle_time = time_us_64();
     while (wls_server.state->complete == false) {
 
         cyw43_arch_poll();
-        cyw43_arch_wait_for_work_until(make_timeout_time_ms(1000));
-        led_on = !led_on; // Toggle the LED state
-        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_on);
+        // the EEPROM is polled every millisecond while a write is in progress
+        cyw43_arch_wait_for_work_until(make_timeout_time_ms(i2c_eeprom_busy() ? 1 : WLT_HEARTBEAT_TIME_MS));
+        // the loop wakes up more often (network, core 1, EEPROM): the LED blinks at its own pace
+        if (time_us_64() - led_toggle_time >= (WLT_HEARTBEAT_TIME_MS * 1000ULL)) {
+            led_toggle_time = time_us_64();
+            led_on = !led_on; // Toggle the LED state
+            cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_on);
+        }
 
 //        printf("Waiting for work...\n");
+        // publish the samples of core 1 (it wakes up the loop when it sends one)
+        while (wlt_core1_get_sample(&sample)) {
+            wlt_sensor_sample(&sample);
+        }
+        // configuration changes not yet accepted by core 1
+        wlt_core1_flush_config();
+        // configuration changes to save (end of the quiet period)
+        wlt_check_config_commit();
+        // pages of the configuration and of the journal to write
+        i2c_eeprom_process();
+
         tick = time_us_64();
         // Update the LED color based on the current mode
         wlt_update_rgb_led(prtconfig->net_config.wifi_mode, &rgb_led, tick);
-
-        if ((tick - pre_tick) > prtconfig->data.settings.options.poll_time * 1000000) {
-            // If more than poll_time second has passed, we can read the sensor data
-            printf("Reading sensor data after %llu microseconds\n", (tick - pre_tick));
-            // read the sensor data and update the DB
-            if (prtconfig->data.settings.options.sens_avail == SENS_AVAILABLE) {
-                if (DHT20_read_data(&(prtconfig->data.temperature), &(prtconfig->data.humidity)) != 0) {
-                    printf("Failed to read DHT20 sensor data\n");
-                    prtconfig->data.settings.options.data_valid = SENS_DATA_NOT_VALID; // Data not valid
-                } else {
-                    printf("DHT20 sensor data read successfully: Temperature = %.2f, Humidity = %.2f\n", 
-                           prtconfig->data.temperature,
-                           prtconfig->data.humidity);
-                    prtconfig->data.settings.options.data_valid = SENS_DATA_VALID; // Data valid
-                    // Send the data to UART
-                    wlt_send_to_uart(prtconfig->data.temperature,
-                                     prtconfig->data.humidity,
-                                     prtconfig->data.settings.options.t_format,
-                                     prtconfig->data.settings.options.out_format);
-                    // Update the outputs state based on the new sensor data
-                    wlt_update_outputs_state(prtconfig);
-                }
-            } else {
-                printf("Sensor not available, using default values\n");
-            }
-            pre_tick = time_us_64(); // Update the pre_tick to current time 
-        }
     }
 
     if(run_time_config.net_config.wifi_mode == WLT_WIFI_MODE_AP) {
@@ -0,0 +1,192 @@
+#include <string.h>
+#include "include/wlt_codec.h"
+
+/*
+ * Function: wlt_codec_zigzag()
+ * Description: This function maps a signed value to an unsigned one: 0, -1, 1, -2... become 0, 1, 2, 3...
+ */
+static inline uint32_t wlt_codec_zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/*
+ * Function: wlt_codec_unzigzag()
+ * Description: This function is the reverse of wlt_codec_zigzag().
+ */
+static inline int32_t wlt_codec_unzigzag(uint32_t u)
+{
+    return (int32_t)((u >> 1) ^ (0 - (u & 1)));
+}
+
+/*
+ * Function: wlt_codec_put()
+ * Description: This function writes a varint, it returns the number of bytes (WLT_CODEC_VARINT_MAX at most).
+ */
+static int wlt_codec_put(uint8_t *buf, uint32_t u)
+{
+    int n = 0;
+
+    while (u >= 0x80) {
+        buf[n++] = (uint8_t)(u | 0x80);
+        u >>= 7;
+    }
+    buf[n++] = (uint8_t)u;
+    return n;
+}
+
+/*
+ * Function: wlt_codec_get()
+ * Description: This function reads a varint at *pos (moved after it).
+ * It returns false if the varint goes past len.
+ */
+static bool wlt_codec_get(const uint8_t *buf, uint16_t len, uint16_t *pos, uint32_t *u)
+{
+    uint32_t v = 0;
+
+    for (int shift = 0; (shift < 7 * WLT_CODEC_VARINT_MAX) && (*pos < len); shift += 7) {
+        uint8_t b = buf[(*pos)++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *u = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Function: wlt_codec_reset()
+ * Description: This function sets the state before the first sample of a buffer starting at ts.
+ */
+void wlt_codec_reset(wlt_codec_state_t *state, uint8_t channels, uint32_t ts)
+{
+    memset(state, 0, sizeof(wlt_codec_state_t));
+    state->channels = (channels > WLT_CODEC_CHANNELS_MAX) ? WLT_CODEC_CHANNELS_MAX : channels;
+    state->ts = ts;
+}
+
+/*
+ * Function: wlt_codec_encode()
+ * Description: This function writes a sample (state->channels values) in buf, the timestamps must not go
+ * backwards. It returns the number of bytes written, 0 if the sample doesn't fit in max bytes
+ * (nothing is written).
+ */
+int wlt_codec_encode(uint8_t *buf, int max, wlt_codec_state_t *state, uint32_t ts, const int32_t *values)
+{
+    uint8_t tmp[WLT_CODEC_VARINT_MAX * (1 + WLT_CODEC_CHANNELS_MAX)];
+    uint32_t delta = ts - state->ts;
+    int n;
+
+    // the differences are computed modulo 2^32: the values wrap back exactly when decoded
+    n = wlt_codec_put(tmp, wlt_codec_zigzag((int32_t)(delta - state->delta)));
+    for (int i = 0; i < state->channels; i++) {
+        n += wlt_codec_put(tmp + n, wlt_codec_zigzag((int32_t)((uint32_t)values[i] - (uint32_t)state->values[i])));
+    }
+    if (n > max) {
+        return 0;
+    }
+    memcpy(buf, tmp, n);
+    state->ts = ts;
+    state->delta = delta;
+    memcpy(state->values, values, state->channels * sizeof(int32_t));
+    return n;
+}
+
+/*
+ * Function: wlt_codec_decode()
+ * Description: This function reads a sample from the first len bytes of buf.
+ * It returns the number of bytes read, 0 if the sample is truncated (the state is not changed).
+ */
+int wlt_codec_decode(const uint8_t *buf, int len, wlt_codec_state_t *state, uint32_t *ts, int32_t *values)
+{
+    uint16_t pos = 0;
+    int32_t v[WLT_CODEC_CHANNELS_MAX];
+    uint32_t delta;
+    uint32_t u;
+
+    if ((len <= 0) || !wlt_codec_get(buf, (len > UINT16_MAX) ? UINT16_MAX : (uint16_t)len, &pos, &u)) {
+        return 0;
+    }
+    delta = state->delta + (uint32_t)wlt_codec_unzigzag(u);
+    for (int i = 0; i < state->channels; i++) {
+        if (!wlt_codec_get(buf, (uint16_t)len, &pos, &u)) {
+            return 0;
+        }
+        v[i] = (int32_t)((uint32_t)state->values[i] + (uint32_t)wlt_codec_unzigzag(u));
+    }
+    state->delta = delta;
+    state->ts += delta;
+    memcpy(state->values, v, state->channels * sizeof(int32_t));
+    *ts = state->ts;
+    memcpy(values, v, state->channels * sizeof(int32_t));
+    return pos;
+}
+
+/*
+ * Function: wlt_codec_rewind()
+ * Description: This function sets the state before the first sample of a block (to decode it).
+ */
+void wlt_codec_rewind(const wlt_codec_block_t *block, wlt_codec_state_t *state, uint8_t channels)
+{
+    wlt_codec_reset(state, channels, block->ts);
+}
+
+/*
+ * Function: wlt_codec_begin()
+ * Description: This function starts an empty block whose first sample will be at ts.
+ */
+void wlt_codec_begin(wlt_codec_block_t *block, wlt_codec_state_t *state, uint8_t channels, uint32_t seq, uint32_t ts)
+{
+    block->seq = seq;
+    block->ts = ts;
+    block->count = 0;
+    block->len = 0;
+    wlt_codec_rewind(block, state, channels);
+}
+
+/*
+ * Function: wlt_codec_append()
+ * Description: This function adds a sample at the end of a block (state->channels values).
+ * The timestamps must not go backwards.
+ * It returns false if the block is full, nothing is written: the sample goes in a new block.
+ */
+bool wlt_codec_append(wlt_codec_block_t *block, wlt_codec_state_t *state, uint32_t ts, const int32_t *values)
+{
+    int n;
+
+    if (block->count == UINT16_MAX) {
+        return false;
+    }
+    n = wlt_codec_encode(block->data + block->len, WLT_CODEC_BLOCK_BYTES - block->len, state, ts, values);
+    if (n == 0) {
+        return false;
+    }
+    block->len += n;
+    block->count++;
+    state->index = block->count;
+    state->pos = block->len;
+    return true;
+}
+
+/*
+ * Function: wlt_codec_next()
+ * Description: This function reads the next sample of a block.
+ * It returns false at the end of the block (or if the block is corrupted).
+ */
+bool wlt_codec_next(const wlt_codec_block_t *block, wlt_codec_state_t *state, uint32_t *ts, int32_t *values)
+{
+    uint16_t len = (block->len > WLT_CODEC_BLOCK_BYTES) ? WLT_CODEC_BLOCK_BYTES : block->len;
+    int n;
+
+    if ((state->index >= block->count) || (state->pos >= len)) {
+        return false;
+    }
+    n = wlt_codec_decode(block->data + state->pos, len - state->pos, state, ts, values);
+    if (n == 0) {
+        return false;
+    }
+    state->pos += n;
+    state->index++;
+    return true;
+}
@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "include/general.h"
+#include "include/eeprom_24LC256.h"
+#include "include/wlt.h"
+#include "include/wlt_fmt.h"
+#include "include/wlt_global.h"
+#include "include/wlt_schema.h"
+#include "include/wlt_core1.h"
+#include "include/wlt_config.h"
+
+// a record is queued at once when the EEPROM is free: i2c_eeprom_write_async() doesn't wait
+_Static_assert(WLT_CONFIG_RECORD_LEN <= EEPROM_QUEUE_PAGES * EEPROM_PAGE_LEN, "the record must fit in the queue of the EEPROM");
+
+static const int wlt_config_slot_addr[WLT_CONFIG_SLOTS] = { WLT_CONFIG_SLOT_A_ADDR, WLT_CONFIG_SLOT_B_ADDR };
+
+static int wlt_config_slot = 0;         // slot of the current configuration (the next write goes to the other)
+static uint32_t wlt_config_gen = 0;     // generation of the current configuration
+static bool wlt_config_current = false; // the current slot holds a record of the current layout
+
+// copy of the records in the EEPROM: only the pages that change are written
+static BYTE wlt_config_shadow[WLT_CONFIG_SLOTS][WLT_CONFIG_RECORD_LEN];
+static bool wlt_config_shadow_valid[WLT_CONFIG_SLOTS];
+static wlt_config_stats_t wlt_config_stats;
+
+// record being written (in the background, see i2c_eeprom_write_async())
+static BYTE wlt_config_pending[WLT_CONFIG_RECORD_LEN];
+static int wlt_config_pending_slot = -1;
+static bool wlt_config_pending_error;
+
+static bool wlt_config_dirty = false;           // configuration changed, not saved yet
+static absolute_time_t wlt_config_commit_time;  // end of the quiet period: the changes are saved
+
+/*
+ * Function: wlt_config_crc32()
+ * Description: This function updates a CRC-32 with len bytes (start with WLT_CONFIG_CRC_INIT,
+ * the result is the complement of the last value).
+ */
+static uint32_t wlt_config_crc32(uint32_t crc, const BYTE *data, int len)
+{
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ WLT_CONFIG_CRC_POLY : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+/*
+ * Function: wlt_config_header_crc()
+ * Description: This function starts the CRC of a record with its header (crc field set to 0).
+ */
+static uint32_t wlt_config_header_crc(const wlt_config_header_t *header)
+{
+    wlt_config_header_t tmp = *header;
+
+    tmp.crc = 0;
+    return wlt_config_crc32(WLT_CONFIG_CRC_INIT, (const BYTE *)&tmp, sizeof(tmp));
+}
+
+/*
+ * Function: wlt_config_read_slot()
+ * Description: This function reads the record of a slot: the payload is copied in config (up to
+ * its size, the fields missing in the record are not changed).
+ * It returns EE_SUCCESS if the record is valid, EE_NOT_FOUND if it isn't, EE_ERROR if the EEPROM
+ * can't be read.
+ */
+static int wlt_config_read_slot(int slot, wlt_config_header_t *header, wlt_config_data_t *config)
+{
+    BYTE *shadow = wlt_config_shadow[slot];
+    BYTE chunk[EEPROM_PAGE_LEN];
+    int addr = wlt_config_slot_addr[slot];
+    int len;
+    uint32_t crc;
+
+    wlt_config_shadow_valid[slot] = false;
+    if (i2c_eeprom_read(addr, shadow, WLT_CONFIG_RECORD_LEN) != EE_SUCCESS) {
+        return EE_ERROR;
+    }
+    wlt_config_shadow_valid[slot] = true;
+    memcpy(header, shadow, sizeof(wlt_config_header_t));
+    if ((header->magic != WLT_CONFIG_MAGIC) || (header->len > WLT_CONFIG_SLOT_LEN - sizeof(wlt_config_header_t))) {
+        return EE_NOT_FOUND;
+    }
+    len = (header->len > sizeof(wlt_config_data_t)) ? (int)sizeof(wlt_config_data_t) : header->len;
+    memcpy(config, shadow + sizeof(wlt_config_header_t), len);
+    crc = wlt_config_header_crc(header);
+    crc = wlt_config_crc32(crc, shadow + sizeof(wlt_config_header_t), len);
+    // the payload of a newer layout can be bigger than the structure: the rest is read a chunk at a time
+    addr += WLT_CONFIG_RECORD_LEN;
+    for (int done = len; done < header->len; ) {
+        int n = (header->len - done > (int)sizeof(chunk)) ? (int)sizeof(chunk) : header->len - done;
+        if (i2c_eeprom_read(addr, chunk, n) != EE_SUCCESS) {
+            return EE_ERROR;
+        }
+        crc = wlt_config_crc32(crc, chunk, n);
+        addr += n;
+        done += n;
+    }
+    return ((crc ^ WLT_CONFIG_CRC_INIT) == header->crc) ? EE_SUCCESS : EE_NOT_FOUND;
+}
+
+/*
+ * Function: wlt_config_read_legacy()
+ * Description: This function reads the configuration saved before the slots (at address 0, without header).
+ * It returns its version (from the signature), 0 if there isn't any.
+ */
+static int wlt_config_read_legacy(wlt_config_data_t *config)
+{
+    if (i2c_eeprom_read(EEPROM_START_ADDR, (BYTE *)config, sizeof(wlt_config_data_t)) != EE_SUCCESS) {
+        return 0;
+    }
+    if (memcmp(config->signature, EEPROM_CTRL_WORD, EEPROM_CTRL_WORD_LEN) == 0) {
+        return WLT_CONFIG_VERSION_V2;
+    }
+    if (memcmp(config->signature, EEPROM_CTRL_WORD_V1, EEPROM_CTRL_WORD_LEN) == 0) {
+        return WLT_CONFIG_VERSION_V1;
+    }
+    return 0;
+}
+
+/*
+ * Function: wlt_config_migrate()
+ * Description: This function converts a configuration from the layout of the given version to the current one.
+ * It returns EE_SUCCESS if the configuration has been converted, EE_NOT_FOUND if the version is unknown
+ * (e.g. saved by a newer firmware).
+ */
+static int wlt_config_migrate(int version, wlt_config_data_t *config)
+{
+    switch (version) {
+        case WLT_CONFIG_VERSION_V1:
+            printf("Converting configuration from the layout v%d\n", version);
+            // the field has the same size and position: only the encoding of the value changes
+            for (int i = 0; i < OUTPUT_GPIO_MAX; i++) {
+                float threshold;
+
+                memcpy(&threshold, &(config->outputs[i].threshold), sizeof(threshold));
+                config->outputs[i].threshold = fmt_centi(threshold);
+            }
+            // fall through
+        case WLT_CONFIG_VERSION_V2:
+            break;
+        default:
+            return EE_NOT_FOUND;
+    }
+    memcpy(config->signature, EEPROM_CTRL_WORD, EEPROM_CTRL_WORD_LEN);
+    return EE_SUCCESS;
+}
+
+/*
+ * Function: wlt_config_read()
+ * Description: This function reads the newest valid configuration from the EEPROM (converted to
+ * the current layout, and saved again if it was not). The fields that the record doesn't have keep
+ * the value they have in config.
+ * It returns EE_SUCCESS if a configuration has been read, EE_NOT_FOUND if there is no valid one,
+ * EE_ERROR if the EEPROM can't be read.
+ */
+int wlt_config_read(wlt_config_data_t *config)
+{
+    wlt_config_header_t header;
+    wlt_config_data_t records[WLT_CONFIG_SLOTS];
+    int version[WLT_CONFIG_SLOTS] = { 0 };
+    uint32_t gen[WLT_CONFIG_SLOTS] = { 0 };
+    int best = -1;
+    bool save;
+
+    for (int slot = 0; slot < WLT_CONFIG_SLOTS; slot++) {
+        int ret;
+
+        records[slot] = *config;
+        ret = wlt_config_read_slot(slot, &header, &records[slot]);
+        if (ret == EE_ERROR) {
+            return EE_ERROR;
+        }
+        if ((ret == EE_SUCCESS) && (wlt_config_migrate(header.version, &records[slot]) == EE_SUCCESS)) {
+            version[slot] = header.version;
+            gen[slot] = header.gen;
+            // the generation can wrap: the newest is the one ahead of the other
+            if ((best < 0) || ((int32_t)(gen[slot] - gen[best]) > 0)) {
+                best = slot;
+            }
+        } else {
+            printf("Configuration slot %c not valid\n", 'A' + slot);
+        }
+    }
+    if (best >= 0) {
+        *config = records[best];
+        wlt_config_slot = best;
+        wlt_config_gen = gen[best];
+        wlt_config_current = (version[best] == WLT_CONFIG_VERSION);
+        printf("Configuration read from slot %c (generation %u)\n", 'A' + best, (unsigned int)gen[best]);
+        save = (version[best] != WLT_CONFIG_VERSION);
+    } else {
+        // configuration saved before the slots: it's in slot A, slot B will be written first
+        records[0] = *config;
+        version[0] = wlt_config_read_legacy(&records[0]);
+        if ((version[0] == 0) || (wlt_config_migrate(version[0], &records[0]) != EE_SUCCESS)) {
+            return EE_NOT_FOUND;
+        }
+        *config = records[0];
+        wlt_config_slot = 0;
+        wlt_config_gen = 0;
+        wlt_config_current = false;
+        printf("Configuration read from the legacy record (v%d)\n", version[0]);
+        // saved in slot B: the legacy record is overwritten only by the second write
+        save = true;
+    }
+    if (save) {
+        // written in the background: if it fails, the configuration is converted again at next boot
+        wlt_config_write(config);
+    }
+    return EE_SUCCESS;
+}
+
+/*
+ * Function: wlt_config_write_done()
+ * Description: This function is called when a page of the record is written (arg is not NULL for the
+ * last one): when all the pages are written the slot becomes the current one.
+ */
+static void wlt_config_write_done(int result, void *arg)
+{
+    int slot = wlt_config_pending_slot;
+    wlt_config_header_t header;
+
+    if (result != EE_SUCCESS) {
+        wlt_config_pending_error = true;
+    }
+    if (arg == NULL) {
+        return;
+    }
+    wlt_config_pending_slot = -1;
+    if (wlt_config_pending_error) {
+        // the content of the slot is not known anymore: it will be written in full
+        wlt_config_shadow_valid[slot] = false;
+        printf("*** ERROR ****\nUnable to write the configuration to EEPROM slot %c\n", 'A' + slot);
+        // written again at the end of a quiet period
+        wlt_config_dirty = true;
+        wlt_config_commit_time = make_timeout_time_ms(WLT_CONFIG_COMMIT_DELAY_MS);
+        return;
+    }
+    memcpy(&header, wlt_config_pending, sizeof(header));
+    memcpy(wlt_config_shadow[slot], wlt_config_pending, WLT_CONFIG_RECORD_LEN);
+    wlt_config_shadow_valid[slot] = true;
+    wlt_config_slot = slot;
+    wlt_config_gen = header.gen;
+    wlt_config_current = true;
+    wlt_config_stats.writes++;
+    printf("Configuration written to EEPROM slot %c (generation %u)\n", 'A' + slot, (unsigned int)header.gen);
+}
+
+/*
+ * Function: wlt_config_write()
+ * Description: This function saves the configuration in the slot that doesn't hold the current one,
+ * with the next generation number. The slot becomes the current one only when the write is done.
+ * Only the pages that differ from the copy in RAM are written, nothing is written if the configuration
+ * is the same as the current one.
+ * It returns EE_SUCCESS if there is nothing to write, EE_PENDING if the write is queued (it goes on
+ * in the background, see i2c_eeprom_process()).
+ */
+int wlt_config_write(const wlt_config_data_t *config)
+{
+    BYTE *record = wlt_config_pending;
+    wlt_config_header_t header;
+    int slot;
+    int last = -1;
+    uint32_t crc;
+
+    // one write at a time: the slot of the next one depends on the result (it waits only at boot,
+    // wlt_save_config() writes when the EEPROM is free)
+    if (wlt_config_pending_slot >= 0) {
+        i2c_eeprom_flush();
+    }
+    if (wlt_config_current && wlt_config_shadow_valid[wlt_config_slot] &&
+        (memcmp(wlt_config_shadow[wlt_config_slot] + sizeof(wlt_config_header_t), config, sizeof(wlt_config_data_t)) == 0)) {
+        wlt_config_stats.unchanged++;
+        PRINT_DEBUG_N("Configuration not changed, nothing to write\n");
+        return EE_SUCCESS;
+    }
+    slot = (wlt_config_slot + 1) % WLT_CONFIG_SLOTS;
+    header.magic = WLT_CONFIG_MAGIC;
+    header.gen = wlt_config_gen + 1;
+    header.version = WLT_CONFIG_VERSION;
+    header.len = sizeof(wlt_config_data_t);
+    crc = wlt_config_header_crc(&header);
+    crc = wlt_config_crc32(crc, (const BYTE *)config, sizeof(wlt_config_data_t));
+    header.crc = crc ^ WLT_CONFIG_CRC_INIT;
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), config, sizeof(wlt_config_data_t));
+
+    // the slots start at the beginning of a page: the page of each chunk is written only if it changes
+    for (int offset = 0; offset < WLT_CONFIG_RECORD_LEN; offset += EEPROM_PAGE_LEN) {
+        int n = (WLT_CONFIG_RECORD_LEN - offset > EEPROM_PAGE_LEN) ? EEPROM_PAGE_LEN : WLT_CONFIG_RECORD_LEN - offset;
+        if (!wlt_config_shadow_valid[slot] || (memcmp(wlt_config_shadow[slot] + offset, record + offset, n) != 0)) {
+            last = offset;
+        }
+    }
+    wlt_config_pending_slot = slot;
+    wlt_config_pending_error = false;
+    for (int offset = 0; offset <= last; offset += EEPROM_PAGE_LEN) {
+        int n = (WLT_CONFIG_RECORD_LEN - offset > EEPROM_PAGE_LEN) ? EEPROM_PAGE_LEN : WLT_CONFIG_RECORD_LEN - offset;
+        if ((offset != last) && wlt_config_shadow_valid[slot] && (memcmp(wlt_config_shadow[slot] + offset, record + offset, n) == 0)) {
+            wlt_config_stats.pages_skipped++;
+            continue;
+        }
+        wlt_config_stats.pages_written++;
+        i2c_eeprom_write_async(wlt_config_slot_addr[slot] + offset, record + offset, n, wlt_config_write_done,
+                               (offset == last) ? (void *)record : NULL);
+    }
+    wlt_config_stats.pages_skipped += (WLT_CONFIG_RECORD_LEN - 1 - last) / EEPROM_PAGE_LEN;
+    PRINT_DEBUG("Write config to EEPROM slot %c\n", 'A' + slot);
+    return EE_PENDING;
+}
+
+/*
+ * Function: wlt_config_get_stats()
+ * Description: This function returns the counters of the configuration writes since boot.
+ */
+void wlt_config_get_stats(wlt_config_stats_t *stats)
+{
+    *stats = wlt_config_stats;
+}
+
+/*
+ * High level functions: copy between the runtime configuration and the record, write-behind
+*/ 
+
+/**
+ * Function: wlt_update_config()
+ * Description: This function updates the configuration (saved in the EEPROM)
+ * with the provided runtime configuration data: only the persisted parameters of the schema
+ * are copied (the runtime flags in settings are not saved).
+ */
+void wlt_update_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config)
+{
+    if (rt_config == NULL || config == NULL) {
+        printf("Invalid argument: rt_config or config is NULL\n");
+        return;
+    }
+    wlt_schema_pack(rt_config, config);
+    // Copy the signature (includes \0 at the end)
+    strncpy(config->signature, EEPROM_CTRL_WORD, EEPROM_CTRL_WORD_LEN);
+ 
+    return;
+}
+
+/*
+ * Function: wlt_load_config()
+ * Description: This function loads the configuration from the EEPROM into the runtime configuration
+ * (the persisted parameters of the schema).
+ * It does not return any value.
+ */
+void wlt_load_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config)
+{
+    if (rt_config == NULL || config == NULL) {
+        printf("Invalid argument: rt_config or config is NULL\n");
+        return;
+    }
+    wlt_schema_unpack(config, rt_config);
+
+    return;
+}
+
+/**
+ * Function: wlt_update_and_save_config()
+ * Description: This function updates the runtime configuration with the provided configuration data.
+ * With persist the configuration is saved to the EEPROM at the end of the quiet period (no other
+ * change for WLT_CONFIG_COMMIT_DELAY_MS, see wlt_check_config_commit()): a burst of changes costs
+ * a single write. Without persist the changes are lost at reboot, unless a later change or
+ * wlt_commit_config() saves the configuration.
+ * It returns EE_SUCCESS if the configuration is already saved (not changed), WLT_CONFIG_DEFERRED
+ * if it will be saved, WLT_CONFIG_TRANSIENT if it's not saved.
+ */
+int wlt_update_and_save_config(wlt_run_time_config_t *rt_config, wlt_config_data_t *config, bool persist)
+{
+    wlt_config_data_t saved;
+
+    // the control loop on core 1 works on its own copy of settings and outputs
+    wlt_core1_send_config(&(rt_config->data));
+    // the cached pages show the configuration too
+    wlt_sample_gen++;
+    if (!persist) {
+        return WLT_CONFIG_TRANSIENT;
+    }
+    memcpy(&saved, config, sizeof(saved));
+    wlt_update_config(rt_config, config);
+    if (!wlt_config_dirty && (memcmp(&saved, config, sizeof(saved)) == 0)) {
+        printf("Configuration not changed\n");
+        return EE_SUCCESS;
+    }
+    // every change restarts the quiet period
+    wlt_config_dirty = true;
+    wlt_config_commit_time = make_timeout_time_ms(WLT_CONFIG_COMMIT_DELAY_MS);
+    return WLT_CONFIG_DEFERRED;
+}
+
+/*
+ * Function: wlt_save_config()
+ * Description: This function saves the configuration to the EEPROM (in the background). While the
+ * EEPROM is writing (the previous record or the journal) the configuration stays dirty and the main
+ * loop saves it when the EEPROM is free: it never waits, it's called by the network callbacks too.
+ * It returns EE_SUCCESS if the configuration is already saved (not changed), EE_PENDING if it's
+ * being written or it will be.
+ */
+static int wlt_save_config(wlt_config_data_t *config)
+{
+    int ret;
+
+    if (i2c_eeprom_busy()) {
+        wlt_config_dirty = true;
+        wlt_config_commit_time = get_absolute_time();
+        return EE_PENDING;
+    }
+    wlt_config_dirty = false;
+    // Save the configuration to EEPROM: the pages are written by the main loop
+    ret = wlt_config_write(config);
+    if (ret == EE_SUCCESS) {
+        printf("Configuration not changed\n");
+    }
+    return ret;
+}
+
+/*
+ * Function: wlt_commit_config()
+ * Description: This function saves the runtime configuration now (the changes applied without
+ * persist too), without waiting for the end of the quiet period.
+ * It returns EE_SUCCESS if the configuration is already saved (not changed), EE_PENDING if it's
+ * being written.
+ */
+int wlt_commit_config(void)
+{
+    wlt_update_config(prtconfig, pconfig);
+    return wlt_save_config(pconfig);
+}
+
+/*
+ * Function: wlt_check_config_commit()
+ * Description: This function saves the configuration changed when the quiet period is over and
+ * the EEPROM is free.
+ * It's called by the main loop.
+ */
+void wlt_check_config_commit(void)
+{
+    if (wlt_config_dirty && time_reached(wlt_config_commit_time) && !i2c_eeprom_busy()) {
+        printf("Saving the configuration\n");
+        wlt_save_config(pconfig);
+    }
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "include/wlt.h"
+#include "include/wlt_global.h"
+#include "include/dht20.h"
+#include "include/wlt_sample.h"
+#include "include/wlt_core1.h"
+
+// rings between the cores (initialized before core 1 is launched)
+static wlt_sample_msg_t wlt_sample_items[WLT_SAMPLE_RING_SLOTS];
+static wlt_ctrl_msg_t wlt_ctrl_items[WLT_CTRL_RING_SLOTS];
+static spsc_ring_t wlt_sample_ring;         // core 1 -> core 0
+static spsc_ring_t wlt_ctrl_ring;           // core 0 -> core 1
+
+// core 1: its own copy of the data used by the control loop
+static wlt_run_time_config_t core1_config;
+
+// core 0: last configuration not yet accepted by the ring
+static wlt_ctrl_msg_t wlt_ctrl_pending;
+static bool wlt_ctrl_is_pending = false;
+
+/*
+ * Function: wlt_core1_sample()
+ * Description: This function completes a sensor read on core 1: it updates the outputs and the UART,
+ * publishes the snapshot of the reading and notifies core 0.
+ */
+static void wlt_core1_sample(int result, int32_t temperature, int32_t humidity)
+{
+    static uint32_t gen = 0;
+    wlt_sample_msg_t sample;
+    wlt_sample_t snapshot;
+
+    memset(&sample, 0, sizeof(sample));
+    sample.result = (int8_t)result;
+    if (result == DHT20_READ_OK) {
+        core1_config.data.temperature = temperature;
+        core1_config.data.humidity = humidity;
+        // Send the data to UART
+        wlt_send_to_uart(temperature,
+                         humidity,
+                         core1_config.data.settings.options.t_format,
+                         core1_config.data.settings.options.out_format);
+        // Update the outputs state based on the new sensor data
+        sample.outputs_changed = wlt_update_outputs_state(&core1_config);
+    }
+    // the last good values are kept when the read fails
+    snapshot.temperature = core1_config.data.temperature;
+    snapshot.humidity = core1_config.data.humidity;
+    snapshot.timestamp_ms = time_us_64() / 1000;
+    snapshot.gen = ++gen;
+    snapshot.valid = (result == DHT20_READ_OK);
+    wlt_sample_publish(&snapshot);
+
+    for (int i = 0; i < OUTPUT_GPIO_MAX; i++) {
+        sample.gpio_state[i] = core1_config.outputs_rt[i].gpio_state;
+    }
+    if (!spsc_push(&wlt_sample_ring, &sample)) {
+        printf("Sample dropped: core 0 is late (%u samples dropped)\n", (unsigned int)wlt_sample_ring.dropped);
+    }
+    // wake up core 0 if it's waiting for work
+    __sev();
+    return;
+}
+
+/*
+ * Function: wlt_core1_main()
+ * Description: This function is the control loop running on core 1: it applies the configuration
+ * received from core 0 and reads the sensor every poll time.
+ */
+static void wlt_core1_main(void)
+{
+    wlt_ctrl_msg_t ctrl;
+    int32_t temperature;
+    int32_t humidity;
+    uint64_t tick, pre_tick;
+    int ret;
+
+    pre_tick = time_us_64();
+    while (true) {
+        // apply the configuration changes made on core 0
+        while (spsc_pop(&wlt_ctrl_ring, &ctrl)) {
+            core1_config.data.settings.all_options = ctrl.settings.all_options;
+            memcpy(core1_config.data.outputs, ctrl.outputs, sizeof(core1_config.data.outputs));
+        }
+
+        // advance the sensor acquisition
+        ret = DHT20_process(&temperature, &humidity);
+        if ((ret == DHT20_READ_OK) || (ret == DHT20_READ_ERROR)) {
+            wlt_core1_sample(ret, temperature, humidity);
+        }
+
+        tick = time_us_64();
+        if ((tick - pre_tick) > core1_config.data.settings.options.poll_time * 1000000) {
+            // If more than poll_time second has passed, we can read the sensor data
+            printf("Reading sensor data after %llu microseconds\n", (tick - pre_tick));
+            // start the measure: the result is collected by DHT20_process() when it's ready
+            if (core1_config.data.settings.options.sens_avail == SENS_AVAILABLE) {
+                ret = DHT20_start();
+                if (ret != DHT20_READ_BUSY) {
+                    wlt_core1_sample(ret, 0, 0);
+                }
+            } else {
+                printf("Sensor not available, using default values\n");
+                wlt_core1_sample(DHT20_READ_IDLE, 0, 0);
+            }
+            pre_tick = time_us_64(); // Update the pre_tick to current time
+        }
+        sleep_ms(WLT_CORE1_TICK_MS);
+    }
+}
+
+/*
+ * Function: wlt_core1_launch()
+ * Description: This function starts the control loop on core 1 with a copy of the current configuration.
+ */
+void wlt_core1_launch(const wlt_run_time_config_t *config)
+{
+    spsc_init(&wlt_sample_ring, wlt_sample_items, WLT_SAMPLE_RING_SLOTS, sizeof(wlt_sample_msg_t));
+    spsc_init(&wlt_ctrl_ring, wlt_ctrl_items, WLT_CTRL_RING_SLOTS, sizeof(wlt_ctrl_msg_t));
+    memcpy(&core1_config, config, sizeof(core1_config));
+    multicore_launch_core1(wlt_core1_main);
+    return;
+}
+
+/*
+ * Function: wlt_core1_flush_config()
+ * Description: This function sends to core 1 the configuration not yet accepted by the ring (core 0).
+ */
+void wlt_core1_flush_config(void)
+{
+    if (wlt_ctrl_is_pending && spsc_push(&wlt_ctrl_ring, &wlt_ctrl_pending)) {
+        wlt_ctrl_is_pending = false;
+    }
+    return;
+}
+
+/*
+ * Function: wlt_core1_send_config()
+ * Description: This function sends the settings and the outputs configuration to core 1 (core 0).
+ * If the ring is full the configuration is kept and sent again by wlt_core1_flush_config().
+ */
+void wlt_core1_send_config(const wlt_data_t *data)
+{
+    wlt_ctrl_pending.settings.all_options = data->settings.all_options;
+    memcpy(wlt_ctrl_pending.outputs, data->outputs, sizeof(wlt_ctrl_pending.outputs));
+    wlt_ctrl_is_pending = true;
+    wlt_core1_flush_config();
+    return;
+}
+
+/*
+ * Function: wlt_core1_get_sample()
+ * Description: This function returns the oldest sample sent by core 1 (core 0).
+ * It returns false if there are no samples.
+ */
+bool wlt_core1_get_sample(wlt_sample_msg_t *sample)
+{
+    return spsc_pop(&wlt_sample_ring, sample);
+}
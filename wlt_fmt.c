@@ -0,0 +1,306 @@
+#include <string.h>
+#include "include/wlt_fmt.h"
+
+static const char fmt_hex_digits[] = "0123456789abcdef";
+
+/*
+ * Function: fmt_centi()
+ * Description: This function converts a value to hundredths, rounded to the nearest.
+ * The readings are already in hundredths, it's only needed to convert the legacy float values.
+ */
+int32_t fmt_centi(float value)
+{
+    return (int32_t)((value >= 0.0f) ? (value * 100.0f + 0.5f) : (value * 100.0f - 0.5f));
+}
+
+/*
+ * Function: fmt_centi_c2f()
+ * Description: This function converts hundredths of degree Celsius to hundredths of degree Fahrenheit
+ * (rounded to the nearest), with integer math.
+ */
+int32_t fmt_centi_c2f(int32_t centi_c)
+{
+    int32_t t = centi_c * 9;
+    return ((t >= 0) ? (t + 2) / 5 : (t - 2) / 5) + 3200;
+}
+
+/*
+ * Function: fmt_parse_centi()
+ * Description: This function parses a decimal number (e.g. "-12.5", "+30", "45.678") into hundredths,
+ * rounded to the nearest, with integer math.
+ * It returns true if the whole text is a valid number in the range of an int32_t in hundredths.
+ */
+bool fmt_parse_centi(const char *text, int32_t *value)
+{
+    const char *p = text;
+    bool negative = false;
+    bool digits = false;
+    uint32_t result = 0;
+    uint8_t decimals = 0;
+    bool round_up = false;
+
+    if ((text == NULL) || (value == NULL)) {
+        return false;
+    }
+    while ((*p == ' ') || (*p == '\t')) {
+        p++;
+    }
+    if ((*p == '-') || (*p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    // integer part
+    while ((*p >= '0') && (*p <= '9')) {
+        result = result * 10 + (*p++ - '0');
+        digits = true;
+        if (result > FMT_CENTI_INT_MAX) {
+            return false;
+        }
+    }
+    // fractional part: the first two digits are kept, the third one rounds
+    if (*p == '.') {
+        p++;
+        while ((*p >= '0') && (*p <= '9')) {
+            if (decimals < 2) {
+                result = result * 10 + (*p - '0');
+                decimals++;
+            } else if (decimals == 2) {
+                round_up = (*p >= '5');
+                decimals++;
+            }
+            p++;
+            digits = true;
+        }
+    }
+    while ((*p == ' ') || (*p == '\t')) {
+        p++;
+    }
+    if (!digits || (*p != '\0')) {
+        return false;
+    }
+    while (decimals < 2) {
+        result *= 10;
+        decimals++;
+    }
+    if (round_up) {
+        result++;
+    }
+    *value = negative ? -(int32_t)result : (int32_t)result;
+    return true;
+}
+
+/*
+ * Function: fmt_utoa()
+ * Description: This function writes an unsigned number in the given base, right aligned on
+ * at least width digits (filled with pad).
+ * It returns the length of the number (the buffer is not terminated).
+ */
+static int fmt_utoa(char *out, uint32_t value, uint8_t base, int width, char pad)
+{
+    char tmp[FMT_NUM_MAX_LEN];
+    int n = 0;
+    int len;
+
+    do {
+        tmp[n++] = fmt_hex_digits[value % base];
+        value /= base;
+    } while (value != 0);
+    if (width > FMT_NUM_MAX_LEN - 1) {
+        width = FMT_NUM_MAX_LEN - 1;
+    }
+    while (n < width) {
+        tmp[n++] = pad;
+    }
+    len = n;
+    while (n > 0) {
+        *out++ = tmp[--n];
+    }
+    return len;
+}
+
+/*
+ * Function: fmt_fixed_num()
+ * Description: This function writes a fixed point number (value scaled by 10^decimals).
+ * It returns the length of the number (the buffer is not terminated).
+ */
+static int fmt_fixed_num(char *out, int32_t value, uint8_t decimals)
+{
+    uint32_t div = 1;
+    uint32_t abs_value;
+    int n = 0;
+
+    if (decimals > 3) {
+        decimals = 3;
+    }
+    for (uint8_t i = 0; i < decimals; i++) {
+        div *= 10;
+    }
+    if (value < 0) {
+        out[n++] = '-';
+        abs_value = 0u - (uint32_t)value;
+    } else {
+        abs_value = (uint32_t)value;
+    }
+    n += fmt_utoa(out + n, abs_value / div, 10, 0, ' ');
+    if (decimals > 0) {
+        out[n++] = '.';
+        n += fmt_utoa(out + n, abs_value % div, 10, decimals, '0');
+    }
+    return n;
+}
+
+/*
+ * Function: fmt_put()
+ * Description: This function appends text to the output, writing only what fits in the buffer.
+ */
+static inline void fmt_put(char *buf, size_t max, size_t *pos, const char *text, size_t len)
+{
+    if (*pos < max) {
+        size_t room = max - *pos;
+        memcpy(buf + *pos, text, (len < room) ? len : room);
+    }
+    *pos += len;
+}
+
+/*
+ * Function: fmt_fixed()
+ * Description: This function formats a fixed point number (value scaled by 10^decimals, max 3 decimals).
+ * It returns the length of the number (snprintf semantic).
+ */
+int fmt_fixed(char *buf, size_t max, int32_t value, uint8_t decimals)
+{
+    char num[FMT_NUM_MAX_LEN];
+    size_t pos = 0;
+
+    fmt_put(buf, max, &pos, num, fmt_fixed_num(num, value, decimals));
+    if (max > 0) {
+        buf[(pos < max) ? pos : max - 1] = '\0';
+    }
+    return pos;
+}
+
+/*
+ * Function: fmt_vformat()
+ * Description: This function expands the template (see wlt_fmt.h for the directives).
+ * It returns the length of the whole text (snprintf semantic).
+ */
+int fmt_vformat(char *buf, size_t max, const char *tmpl, va_list args)
+{
+    char num[FMT_NUM_MAX_LEN];
+    size_t pos = 0;
+    const char *p = tmpl;
+
+    while (*p != '\0') {
+        const char *start = p;
+        const char *directive;
+        char pad = ' ';
+        int width = 0;
+        int decimals = -1;
+        int n;
+
+        // copy the literal text up to the next directive
+        while ((*p != '\0') && (*p != '%')) {
+            p++;
+        }
+        if (p > start) {
+            fmt_put(buf, max, &pos, start, p - start);
+        }
+        if (*p == '\0') {
+            break;
+        }
+        directive = p++;
+        if (*p == '0') {
+            pad = '0';
+            p++;
+        }
+        while ((*p >= '0') && (*p <= '9')) {
+            width = width * 10 + (*p++ - '0');
+        }
+        if (*p == '.') {
+            p++;
+            decimals = 0;
+            while ((*p >= '0') && (*p <= '9')) {
+                decimals = decimals * 10 + (*p++ - '0');
+            }
+        }
+        switch (*p) {
+            case 's':
+                {
+                    const char *s = va_arg(args, const char *);
+                    if (s == NULL) {
+                        s = "(null)";
+                    }
+                    fmt_put(buf, max, &pos, s, strlen(s));
+                }
+                break;
+
+            case 'c':
+                num[0] = (char)va_arg(args, int);
+                fmt_put(buf, max, &pos, num, 1);
+                break;
+
+            case 'd':
+                {
+                    int v = va_arg(args, int);
+                    n = 0;
+                    if (v < 0) {
+                        num[n++] = '-';
+                        width--;
+                    }
+                    n += fmt_utoa(num + n, (v < 0) ? 0u - (unsigned int)v : (unsigned int)v, 10, width, pad);
+                    fmt_put(buf, max, &pos, num, n);
+                }
+                break;
+
+            case 'u':
+                n = fmt_utoa(num, va_arg(args, unsigned int), 10, width, pad);
+                fmt_put(buf, max, &pos, num, n);
+                break;
+
+            case 'x':
+                n = fmt_utoa(num, va_arg(args, unsigned int), 16, width, pad);
+                fmt_put(buf, max, &pos, num, n);
+                break;
+
+            case 'f':
+                n = fmt_fixed_num(num, va_arg(args, int32_t), (decimals < 0) ? 2 : decimals);
+                fmt_put(buf, max, &pos, num, n);
+                break;
+
+            case '%':
+                fmt_put(buf, max, &pos, "%", 1);
+                break;
+
+            default:
+                // unknown directive: copied as it is
+                if (*p == '\0') {
+                    fmt_put(buf, max, &pos, directive, p - directive);
+                    continue;
+                }
+                fmt_put(buf, max, &pos, directive, p - directive + 1);
+                break;
+        }
+        p++;
+    }
+    // terminate (truncated) text
+    if (max > 0) {
+        buf[(pos < max) ? pos : max - 1] = '\0';
+    }
+    return pos;
+}
+
+/*
+ * Function: fmt_format()
+ * Description: This function expands the template with the given arguments (see wlt_fmt.h).
+ * It returns the length of the whole text (snprintf semantic).
+ */
+int fmt_format(char *buf, size_t max, const char *tmpl, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, tmpl);
+    len = fmt_vformat(buf, max, tmpl, args);
+    va_end(args);
+    return len;
+}
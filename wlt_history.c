@@ -0,0 +1,374 @@
+#include <string.h>
+#include "include/wlt_codec.h"
+#include "include/wlt_history.h"
+
+// interval being accumulated (aggregate tiers)
+typedef struct wlt_hist_acc {
+    bool open;
+    uint32_t ts;
+    uint32_t count;
+    int32_t t_sum;
+    int32_t h_sum;
+    int16_t t_min;
+    int16_t t_max;
+    uint16_t h_min;
+    uint16_t h_max;
+} wlt_hist_acc_t;
+
+// values of an entry in the blocks
+#define WLT_HIST_RAW_CHANNELS               2       // T, H
+#define WLT_HIST_AGG_CHANNELS               7       // count, T min, max, mean, H min, max, mean
+
+typedef struct wlt_hist_ring {
+    uint32_t res;               // resolution (seconds), 0 for the raw samples
+    uint8_t channels;
+    wlt_codec_block_t *blocks;
+    uint32_t nblocks;
+    uint32_t blocks_total;      // blocks started since boot (the last one is being filled)
+    uint32_t total;             // entries written since boot (sequence number of the next one)
+    wlt_codec_state_t enc;      // end of the last block
+    wlt_codec_state_t dec;      // last entry read (the entries are usually read in order)
+    const wlt_codec_block_t *dec_block;
+    uint32_t dec_seq;           // sequence number of the first entry of dec_block when it was read
+    wlt_hist_acc_t acc;         // interval in progress (aggregate tiers)
+} wlt_hist_ring_t;
+
+static wlt_codec_block_t wlt_hist_raw[WLT_HIST_RAW_BLOCKS];
+static wlt_codec_block_t wlt_hist_1m[WLT_HIST_1M_BLOCKS];
+static wlt_codec_block_t wlt_hist_15m[WLT_HIST_15M_BLOCKS];
+
+static uint32_t wlt_hist_epoch;     // device time at boot
+
+static wlt_hist_ring_t wlt_hist_rings[WLT_HIST_TIERS] = {
+    { .res = WLT_HIST_RES_RAW, .channels = WLT_HIST_RAW_CHANNELS, .blocks = wlt_hist_raw, .nblocks = WLT_HIST_RAW_BLOCKS },
+    { .res = WLT_HIST_RES_1M, .channels = WLT_HIST_AGG_CHANNELS, .blocks = wlt_hist_1m, .nblocks = WLT_HIST_1M_BLOCKS },
+    { .res = WLT_HIST_RES_15M, .channels = WLT_HIST_AGG_CHANNELS, .blocks = wlt_hist_15m, .nblocks = WLT_HIST_15M_BLOCKS },
+};
+
+/*
+ * Function: wlt_hist_store()
+ * Description: This function appends an entry to a tier, in a new block (overwriting the oldest one)
+ * when the last block is full.
+ */
+static void wlt_hist_store(wlt_hist_ring_t *ring, uint32_t ts, const int32_t *values)
+{
+    wlt_codec_block_t *block = &ring->blocks[(ring->blocks_total + ring->nblocks - 1) % ring->nblocks];
+
+    if ((ring->blocks_total == 0) || !wlt_codec_append(block, &ring->enc, ts, values)) {
+        block = &ring->blocks[ring->blocks_total % ring->nblocks];
+        wlt_codec_begin(block, &ring->enc, ring->channels, ring->total, ts);
+        wlt_codec_append(block, &ring->enc, ts, values);
+        ring->blocks_total++;
+    }
+    ring->total++;
+}
+
+/*
+ * Function: wlt_hist_load()
+ * Description: This function decodes a stored entry of a tier (seq must be between wlt_history_first()
+ * and ring->total). The blocks are searched by sequence number, then the block is decoded up to
+ * the entry, from the last entry read when it's in the same block and not after seq.
+ */
+static bool wlt_hist_load(wlt_hist_ring_t *ring, uint32_t seq, uint32_t *ts, int32_t *values)
+{
+    uint32_t lo = (ring->blocks_total > ring->nblocks) ? ring->blocks_total - ring->nblocks : 0;
+    uint32_t hi = ring->blocks_total;
+    const wlt_codec_block_t *block;
+
+    // last block starting at or before seq
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ring->blocks[mid % ring->nblocks].seq <= seq) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    block = &ring->blocks[lo % ring->nblocks];
+    if ((ring->dec_block != block) || (ring->dec_seq != block->seq) || (block->seq + ring->dec.index > seq)) {
+        wlt_codec_rewind(block, &ring->dec, ring->channels);
+        ring->dec_block = block;
+        ring->dec_seq = block->seq;
+    }
+    do {
+        if (!wlt_codec_next(block, &ring->dec, ts, values)) {
+            ring->dec_block = NULL;
+            return false;
+        }
+    } while (block->seq + ring->dec.index <= seq);
+    return true;
+}
+
+/*
+ * Function: wlt_hist_mean()
+ * Description: This function returns sum / count rounded to the nearest.
+ */
+static int32_t wlt_hist_mean(int32_t sum, uint32_t count)
+{
+    int32_t n = (int32_t)count;
+
+    return (sum >= 0) ? (sum + n / 2) / n : (sum - n / 2) / n;
+}
+
+/*
+ * Function: wlt_hist_acc_merge()
+ * Description: This function adds to an interval the samples of another one (or a single sample).
+ */
+static void wlt_hist_acc_merge(wlt_hist_acc_t *acc, const wlt_hist_acc_t *from)
+{
+    if (acc->count == 0) {
+        acc->t_min = from->t_min;
+        acc->t_max = from->t_max;
+        acc->h_min = from->h_min;
+        acc->h_max = from->h_max;
+    } else {
+        if (from->t_min < acc->t_min) {
+            acc->t_min = from->t_min;
+        }
+        if (from->t_max > acc->t_max) {
+            acc->t_max = from->t_max;
+        }
+        if (from->h_min < acc->h_min) {
+            acc->h_min = from->h_min;
+        }
+        if (from->h_max > acc->h_max) {
+            acc->h_max = from->h_max;
+        }
+    }
+    acc->count += from->count;
+    acc->t_sum += from->t_sum;
+    acc->h_sum += from->h_sum;
+}
+
+/*
+ * Function: wlt_hist_acc_to_agg()
+ * Description: This function converts an interval to the aggregate stored in the ring.
+ */
+static void wlt_hist_acc_to_agg(const wlt_hist_acc_t *acc, wlt_hist_agg_t *agg)
+{
+    agg->ts = acc->ts;
+    agg->count = (acc->count > UINT16_MAX) ? UINT16_MAX : (uint16_t)acc->count;
+    agg->t_min = acc->t_min;
+    agg->t_max = acc->t_max;
+    agg->t_mean = (int16_t)wlt_hist_mean(acc->t_sum, acc->count);
+    agg->h_min = acc->h_min;
+    agg->h_max = acc->h_max;
+    agg->h_mean = (uint16_t)wlt_hist_mean(acc->h_sum, acc->count);
+}
+
+/*
+ * Function: wlt_hist_push()
+ * Description: This function closes the interval in progress of an aggregate tier: it's stored
+ * in the ring and downsampled to the next tier.
+ */
+static void wlt_hist_push(int tier)
+{
+    wlt_hist_ring_t *ring = &wlt_hist_rings[tier];
+    wlt_hist_agg_t agg;
+    int32_t values[WLT_HIST_AGG_CHANNELS];
+
+    wlt_hist_acc_to_agg(&ring->acc, &agg);
+    values[0] = agg.count;
+    values[1] = agg.t_min;
+    values[2] = agg.t_max;
+    values[3] = agg.t_mean;
+    values[4] = agg.h_min;
+    values[5] = agg.h_max;
+    values[6] = agg.h_mean;
+    wlt_hist_store(ring, agg.ts, values);
+    if (tier + 1 < WLT_HIST_TIERS) {
+        wlt_hist_ring_t *next = &wlt_hist_rings[tier + 1];
+        uint32_t ts = ring->acc.ts - (ring->acc.ts % next->res);
+
+        if (next->acc.open && (next->acc.ts != ts)) {
+            wlt_hist_push(tier + 1);
+        }
+        if (!next->acc.open) {
+            memset(&next->acc, 0, sizeof(next->acc));
+            next->acc.open = true;
+            next->acc.ts = ts;
+        }
+        wlt_hist_acc_merge(&next->acc, &ring->acc);
+    }
+    ring->acc.open = false;
+}
+
+/*
+ * Function: wlt_history_set_epoch()
+ * Description: This function sets the device time at boot (seconds).
+ */
+void wlt_history_set_epoch(uint32_t epoch)
+{
+    wlt_hist_epoch = epoch;
+}
+
+/*
+ * Function: wlt_history_time()
+ * Description: This function returns the device time (seconds) of a time since boot (milliseconds).
+ */
+uint32_t wlt_history_time(uint64_t ms_since_boot)
+{
+    return wlt_hist_epoch + (uint32_t)(ms_since_boot / 1000);
+}
+
+/*
+ * Function: wlt_history_add()
+ * Description: This function adds a sample (hundredths of degree Celsius and of %RH) to the history.
+ * The samples must be added in time order.
+ */
+void wlt_history_add(uint32_t ts, int32_t temperature, int32_t humidity)
+{
+    wlt_hist_ring_t *raw = &wlt_hist_rings[WLT_HIST_TIER_RAW];
+    wlt_hist_ring_t *ring = &wlt_hist_rings[WLT_HIST_TIER_1M];
+    int32_t values[WLT_HIST_RAW_CHANNELS] = { (int16_t)temperature, (uint16_t)humidity };
+    wlt_hist_acc_t sample;
+    uint32_t bucket = ts - (ts % ring->res);
+
+    wlt_hist_store(raw, ts, values);
+
+    // a new interval closes the one in progress (and the coarser ones when they roll over too)
+    if (ring->acc.open && (ring->acc.ts != bucket)) {
+        wlt_hist_push(WLT_HIST_TIER_1M);
+    }
+    if (!ring->acc.open) {
+        memset(&ring->acc, 0, sizeof(ring->acc));
+        ring->acc.open = true;
+        ring->acc.ts = bucket;
+    }
+    sample.count = 1;
+    sample.t_sum = sample.t_min = sample.t_max = (int16_t)temperature;
+    sample.h_sum = sample.h_min = sample.h_max = (uint16_t)humidity;
+    wlt_hist_acc_merge(&ring->acc, &sample);
+}
+
+/*
+ * Function: wlt_history_tier()
+ * Description: This function returns the tier with the given resolution (seconds), -1 if there is none.
+ */
+int wlt_history_tier(uint32_t res)
+{
+    for (int i = 0; i < WLT_HIST_TIERS; i++) {
+        if (wlt_hist_rings[i].res == res) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Function: wlt_history_res()
+ * Description: This function returns the resolution of a tier (seconds, 0 for the raw samples).
+ */
+uint32_t wlt_history_res(int tier)
+{
+    return wlt_hist_rings[tier].res;
+}
+
+/*
+ * Function: wlt_history_first()
+ * Description: This function returns the sequence number of the oldest entry still stored in a tier.
+ */
+uint32_t wlt_history_first(int tier)
+{
+    const wlt_hist_ring_t *ring = &wlt_hist_rings[tier];
+
+    // once the ring is full, the oldest block is the next one to be overwritten
+    return (ring->blocks_total >= ring->nblocks) ? ring->blocks[ring->blocks_total % ring->nblocks].seq : 0;
+}
+
+/*
+ * Function: wlt_history_end()
+ * Description: This function returns the sequence number after the last entry of a tier
+ * (the interval in progress included).
+ */
+uint32_t wlt_history_end(int tier)
+{
+    const wlt_hist_ring_t *ring = &wlt_hist_rings[tier];
+
+    return ring->total + (ring->acc.open ? 1 : 0);
+}
+
+/*
+ * Function: wlt_history_get()
+ * Description: This function returns an entry of a tier as an aggregate.
+ * It returns false if the entry is not stored (anymore).
+ */
+bool wlt_history_get(int tier, uint32_t seq, wlt_hist_agg_t *agg)
+{
+    wlt_hist_ring_t *ring = &wlt_hist_rings[tier];
+    int32_t values[WLT_HIST_AGG_CHANNELS];
+    uint32_t ts;
+
+    if ((seq < wlt_history_first(tier)) || (seq >= wlt_history_end(tier))) {
+        return false;
+    }
+    if (seq == ring->total) {
+        // interval in progress: it includes the samples of the finer tier not yet downsampled
+        wlt_hist_acc_t acc = ring->acc;
+        const wlt_hist_acc_t *finer = &wlt_hist_rings[tier - 1].acc;
+        if ((tier > WLT_HIST_TIER_1M) && finer->open && ((finer->ts - (finer->ts % ring->res)) == acc.ts)) {
+            wlt_hist_acc_merge(&acc, finer);
+        }
+        wlt_hist_acc_to_agg(&acc, agg);
+    } else if (!wlt_hist_load(ring, seq, &ts, values)) {
+        return false;
+    } else if (tier == WLT_HIST_TIER_RAW) {
+        agg->ts = ts;
+        agg->count = 1;
+        agg->t_min = agg->t_max = agg->t_mean = (int16_t)values[0];
+        agg->h_min = agg->h_max = agg->h_mean = (uint16_t)values[1];
+    } else {
+        agg->ts = ts;
+        agg->count = (uint16_t)values[0];
+        agg->t_min = (int16_t)values[1];
+        agg->t_max = (int16_t)values[2];
+        agg->t_mean = (int16_t)values[3];
+        agg->h_min = (uint16_t)values[4];
+        agg->h_max = (uint16_t)values[5];
+        agg->h_mean = (uint16_t)values[6];
+    }
+    return true;
+}
+
+/*
+ * Function: wlt_history_find()
+ * Description: This function returns the first entry of a tier that ends after "from" (binary search,
+ * the entries are in time order), wlt_history_end() if there is none.
+ */
+uint32_t wlt_history_find(int tier, uint32_t from)
+{
+    uint32_t lo = wlt_history_first(tier);
+    uint32_t hi = wlt_history_end(tier);
+    uint32_t res = wlt_history_res(tier);
+    wlt_hist_agg_t agg;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        wlt_history_get(tier, mid, &agg);
+        // an interval ends at ts + res, a raw sample is an instant
+        if ((res > 0) ? (agg.ts + res <= from) : (agg.ts < from)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Function: wlt_history_select()
+ * Description: This function returns the finest tier that still covers "from": nothing has been
+ * overwritten yet or the oldest entry is not newer (the coarsest tier if none does).
+ */
+int wlt_history_select(uint32_t from)
+{
+    wlt_hist_agg_t agg;
+
+    for (int i = 0; i < WLT_HIST_TIERS; i++) {
+        if ((wlt_history_first(i) == 0) ||
+            (wlt_history_get(i, wlt_history_first(i), &agg) && (agg.ts <= from))) {
+            return i;
+        }
+    }
+    return WLT_HIST_TIERS - 1;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "include/wlt_http.h"
+
+/*
+ * Function: http_has_token()
+ * Description: This function checks (case insensitive) if a header value contains the given token.
+ * The token must be written in lower case.
+ */
+static bool http_has_token(const char *value, const char *token)
+{
+    size_t tlen = strlen(token);
+
+    for (; *value; value++) {
+        size_t i = 0;
+        while ((i < tlen) && (value[i] != '\0') && (tolower((unsigned char)value[i]) == token[i])) {
+            i++;
+        }
+        if (i == tlen) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Function: http_header_name_is()
+ * Description: This function checks (case insensitive) the name of the header stored in line.
+ * It returns a pointer to the header value (leading spaces skipped) or NULL if the name doesn't match.
+ */
+static const char *http_header_name_is(const char *line, const char *name)
+{
+    size_t nlen = strlen(name);
+
+    for (size_t i = 0; i < nlen; i++) {
+        if (tolower((unsigned char)line[i]) != name[i]) {
+            return NULL;
+        }
+    }
+    if (line[nlen] != ':') {
+        return NULL;
+    }
+    line += nlen + 1;
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    return line;
+}
+
+/*
+ * Function: http_parse_header_line()
+ * Description: This function processes a complete header line and stores the fields used by the server.
+ */
+static void http_parse_header_line(http_request_t *req)
+{
+    const char *value;
+
+    if ((value = http_header_name_is(req->line, HTTP_HDR_CONTENT_LENGTH)) != NULL) {
+        req->content_length = atoi(value);
+        if (req->content_length < 0) {
+            req->content_length = 0;
+        }
+    } else if ((value = http_header_name_is(req->line, HTTP_HDR_IF_NONE_MATCH)) != NULL) {
+        strncpy(req->if_none_match, value, sizeof(req->if_none_match) - 1);
+        req->if_none_match[sizeof(req->if_none_match) - 1] = '\0';
+    } else if ((value = http_header_name_is(req->line, HTTP_HDR_ACCEPT_ENCODING)) != NULL) {
+        req->accept_gzip = http_has_token(value, "gzip");
+    } else if ((value = http_header_name_is(req->line, HTTP_HDR_CONNECTION)) != NULL) {
+        req->conn_close = http_has_token(value, "close");
+        req->conn_keep_alive = http_has_token(value, "keep-alive");
+        req->conn_upgrade = http_has_token(value, "upgrade");
+    } else if ((value = http_header_name_is(req->line, HTTP_HDR_UPGRADE)) != NULL) {
+        req->upgrade_websocket = http_has_token(value, "websocket");
+    } else if ((value = http_header_name_is(req->line, HTTP_HDR_WS_KEY)) != NULL) {
+        strncpy(req->ws_key, value, sizeof(req->ws_key) - 1);
+        req->ws_key[sizeof(req->ws_key) - 1] = '\0';
+    } else if ((value = http_header_name_is(req->line, HTTP_HDR_WS_VERSION)) != NULL) {
+        req->ws_version = atoi(value);
+    }
+}
+
+/*
+ * Function: http_parser_init()
+ * Description: This function initializes the parser to receive a new request.
+ * Parameters:
+ * req - pointer to the parser state
+ * body - buffer where the body of the request is stored
+ * body_max - size of the body buffer (one byte is reserved for the terminator)
+ */
+void http_parser_init(http_request_t *req, char *body, int body_max)
+{
+    memset(req, 0, sizeof(http_request_t));
+    req->state = HTTP_PARSE_METHOD;
+    req->body = body;
+    req->body_max = body_max;
+}
+
+/*
+ * Function: http_parser_feed()
+ * Description: This function parses a block of data of the request.
+ * It can be called many times, the parsing continues from the point where it stopped.
+ * It returns the number of bytes used: the data after the end of the request is not used.
+ */
+int http_parser_feed(http_request_t *req, const char *data, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        char c = data[i];
+
+        switch (req->state) {
+            case HTTP_PARSE_METHOD:
+                if (c == ' ') {
+                    req->state = (req->pos > 0) ? HTTP_PARSE_PATH : HTTP_PARSE_ERROR;
+                    req->pos = 0;
+                } else if ((c == '\r') || (c == '\n')) {
+                    // ignore empty lines before the request line
+                    if (req->pos > 0) {
+                        req->state = HTTP_PARSE_ERROR;
+                    }
+                } else if (req->pos < sizeof(req->method) - 1) {
+                    req->method[req->pos++] = c;
+                } else {
+                    req->state = HTTP_PARSE_ERROR;
+                }
+                break;
+
+            case HTTP_PARSE_PATH:
+                if (c == ' ') {
+                    req->state = HTTP_PARSE_VERSION;
+                    req->path_len = req->pos;
+                    req->pos = 0;
+                } else if (c == '?') {
+                    req->state = HTTP_PARSE_QUERY;
+                    req->path_len = req->pos;
+                    req->pos = 0;
+                } else if ((c == '\r') || (c == '\n')) {
+                    req->state = HTTP_PARSE_ERROR;
+                } else if (req->pos < sizeof(req->path) - 1) {
+                    req->path[req->pos++] = c;
+                } else {
+                    printf("Request path too long\n");
+                    req->state = HTTP_PARSE_ERROR;
+                }
+                break;
+
+            case HTTP_PARSE_QUERY:
+                if (c == ' ') {
+                    req->state = HTTP_PARSE_VERSION;
+                    req->pos = 0;
+                } else if ((c == '\r') || (c == '\n')) {
+                    req->state = HTTP_PARSE_ERROR;
+                } else if (req->pos < sizeof(req->query) - 1) {
+                    req->query[req->pos++] = c;
+                } else {
+                    printf("Request query too long\n");
+                    req->state = HTTP_PARSE_ERROR;
+                }
+                break;
+
+            case HTTP_PARSE_VERSION:
+                if (c == '\n') {
+                    req->line[req->pos] = '\0';
+                    req->http_1_0 = (strcmp(req->line, "HTTP/1.0") == 0);
+                    req->state = HTTP_PARSE_HEADER;
+                    req->pos = 0;
+                } else if ((c != '\r') && (req->pos < sizeof(req->line) - 1)) {
+                    req->line[req->pos++] = c;
+                }
+                break;
+
+            case HTTP_PARSE_HEADER:
+                if (c == '\n') {
+                    if (req->pos == 0) {
+                        // empty line: end of headers
+                        if (req->content_length == 0) {
+                            req->state = HTTP_PARSE_DONE;
+                            return i + 1;
+                        }
+                        if (req->content_length > req->body_max - 1) {
+                            printf("Request body too large (%d bytes)\n", req->content_length);
+                            req->state = HTTP_PARSE_ERROR;
+                            return i + 1;
+                        }
+                        req->state = HTTP_PARSE_BODY;
+                    } else {
+                        req->line[req->pos] = '\0';
+                        http_parse_header_line(req);
+                        req->pos = 0;
+                    }
+                } else if ((c != '\r') && (req->pos < sizeof(req->line) - 1)) {
+                    req->line[req->pos++] = c;
+                }
+                break;
+
+            case HTTP_PARSE_BODY:
+                {
+                    // copy as much body as available in one step
+                    int n = len - i;
+                    if (n > req->content_length - req->body_len) {
+                        n = req->content_length - req->body_len;
+                    }
+                    memcpy(req->body + req->body_len, data + i, n);
+                    req->body_len += n;
+                    i += n - 1;
+                    if (req->body_len == req->content_length) {
+                        req->body[req->body_len] = '\0';
+                        req->state = HTTP_PARSE_DONE;
+                        return i + 1;
+                    }
+                }
+                break;
+
+            case HTTP_PARSE_DONE:
+            case HTTP_PARSE_ERROR:
+            default:
+                return i;
+        }
+        if (req->state == HTTP_PARSE_ERROR) {
+            return i + 1;
+        }
+    }
+    return len;
+}
+
+/*
+ * Function: http_parser_feed_pbuf()
+ * Description: This function parses the data received in a pbuf chain, walking the chain in place.
+ * The number of bytes of the chain used by the request is stored in used: the bytes after the
+ * end of the request (the next pipelined request) are not parsed.
+ * It returns the state of the parser after the data has been processed.
+ */
+http_parse_state_t http_parser_feed_pbuf(http_request_t *req, struct pbuf *p, u16_t *used)
+{
+    *used = 0;
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        if ((req->state == HTTP_PARSE_DONE) || (req->state == HTTP_PARSE_ERROR)) {
+            break;
+        }
+        *used += http_parser_feed(req, (const char *)q->payload, q->len);
+    }
+    return req->state;
+}
+
+/*
+ * Function: http_etag_match()
+ * Description: This function checks if the If-None-Match header of the request matches the ETag of the content.
+ * The comparison is weak (as required for If-None-Match): "W/" prefixes are ignored.
+ * It returns true if the client copy is still valid.
+ */
+bool http_etag_match(const char *if_none_match, const char *etag)
+{
+    if (if_none_match[0] == '\0') {
+        return false;
+    }
+    if (strcmp(if_none_match, "*") == 0) {
+        return true;
+    }
+    // the ETag is quoted, so it can't match part of another validator of the list
+    return strstr(if_none_match, etag) != NULL;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "include/general.h"
+#include "include/wlt_journal.h"
+
+typedef struct wlt_journal {
+    uint32_t next_seq;                  // sequence number of the next page to write
+    uint32_t last_ts;                   // time of the last sample (added, or read at boot)
+    wlt_journal_page_t page;            // page being filled
+    wlt_codec_state_t enc;
+} wlt_journal_t;
+
+static wlt_journal_t wlt_journal;
+
+/*
+ * Function: wlt_journal_crc()
+ * Description: This function returns the CRC-16 of a page, computed with the crc field set to 0.
+ */
+static uint16_t wlt_journal_crc(const wlt_journal_page_t *page)
+{
+    wlt_journal_page_t tmp = *page;
+    const uint8_t *data = (const uint8_t *)&tmp;
+    uint16_t crc = WLT_JOURNAL_CRC_INIT;
+
+    tmp.crc = 0;
+    for (size_t i = 0; i < sizeof(tmp); i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ WLT_JOURNAL_CRC_POLY) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/*
+ * Function: wlt_journal_read()
+ * Description: This function reads the page in a slot of the journal.
+ * It returns false if the page can't be read or is not valid (never written, not complete,
+ * or not belonging to the slot).
+ */
+static bool wlt_journal_read(uint32_t slot, wlt_journal_page_t *page)
+{
+    if (i2c_eeprom_read(WLT_JOURNAL_START_ADDR + slot * EEPROM_PAGE_LEN, (BYTE *)page, sizeof(wlt_journal_page_t)) != EE_SUCCESS) {
+        return false;
+    }
+    return (page->crc == wlt_journal_crc(page)) && (page->seq % WLT_JOURNAL_PAGES == slot) &&
+           (page->len <= WLT_JOURNAL_DATA_LEN);
+}
+
+/*
+ * Function: wlt_journal_init()
+ * Description: This function finds the last page written (binary search: the slots before it
+ * hold the pages of the current turn, seq = seq of slot 0 + slot) and calls replay for all the
+ * samples of the journal, oldest first.
+ * It returns false if the journal is empty.
+ */
+bool wlt_journal_init(wlt_journal_cb_t replay)
+{
+    wlt_journal_page_t page;
+    wlt_codec_state_t dec;
+    uint32_t first;
+    bool found = false;
+
+    memset(&wlt_journal, 0, sizeof(wlt_journal));
+    if (wlt_journal_read(0, &page)) {
+        uint32_t anchor = page.seq;
+        uint32_t lo = 1;
+        uint32_t hi = WLT_JOURNAL_PAGES;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (wlt_journal_read(mid, &page) && (page.seq == anchor + mid)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        wlt_journal.next_seq = anchor + lo;
+    } else if (wlt_journal_read(WLT_JOURNAL_PAGES - 1, &page)) {
+        // slot 0 was being written (a full turn is done): it's the next one
+        wlt_journal.next_seq = page.seq + 1;
+    }
+
+    first = (wlt_journal.next_seq > WLT_JOURNAL_PAGES) ? wlt_journal.next_seq - WLT_JOURNAL_PAGES : 0;
+    for (uint32_t seq = first; seq < wlt_journal.next_seq; seq++) {
+        int pos = 0;
+        if (!wlt_journal_read(seq % WLT_JOURNAL_PAGES, &page) || (page.seq != seq)) {
+            continue;
+        }
+        wlt_codec_reset(&dec, WLT_JOURNAL_CHANNELS, page.ts);
+        for (int i = 0; i < page.count; i++) {
+            int32_t values[WLT_JOURNAL_CHANNELS];
+            uint32_t ts;
+            int n = wlt_codec_decode(page.data + pos, page.len - pos, &dec, &ts, values);
+            if (n == 0) {
+                break;
+            }
+            pos += n;
+            // the samples must be in time order
+            if (!found || (ts >= wlt_journal.last_ts)) {
+                if (replay != NULL) {
+                    replay(ts, values[0], values[1]);
+                }
+                wlt_journal.last_ts = ts;
+                found = true;
+            }
+        }
+    }
+    printf("Journal: next page %u, last sample at %u\n", (unsigned int)wlt_journal.next_seq, (unsigned int)wlt_journal.last_ts);
+    return found;
+}
+
+/*
+ * Function: wlt_journal_write_done()
+ * Description: This function is called when a page is written: a page that can't be written is
+ * dropped, its slot is used by the next page (if no other page has been queued in the meantime).
+ */
+static void wlt_journal_write_done(int result, void *arg)
+{
+    uint32_t seq = (uint32_t)(uintptr_t)arg;
+
+    if (result != EE_SUCCESS) {
+        printf("Unable to write the journal page %u\n", (unsigned int)seq);
+        if (wlt_journal.next_seq == seq + 1) {
+            wlt_journal.next_seq = seq;
+        }
+    }
+}
+
+/*
+ * Function: wlt_journal_flush()
+ * Description: This function queues the page being filled for writing in the EEPROM (in the slot of the
+ * oldest page) and starts a new one.
+ */
+void wlt_journal_flush(void)
+{
+    wlt_journal_page_t *page = &wlt_journal.page;
+
+    if (page->count == 0) {
+        return;
+    }
+    page->seq = wlt_journal.next_seq++;
+    page->crc = wlt_journal_crc(page);
+    // the page is copied: the next one can be filled while it's being written
+    i2c_eeprom_write_async(WLT_JOURNAL_START_ADDR + (page->seq % WLT_JOURNAL_PAGES) * EEPROM_PAGE_LEN,
+                           (const BYTE *)page, sizeof(wlt_journal_page_t), wlt_journal_write_done,
+                           (void *)(uintptr_t)page->seq);
+    page->count = 0;
+    page->len = 0;
+}
+
+/*
+ * Function: wlt_journal_add()
+ * Description: This function adds a sample (hundredths of degree Celsius and of %RH) to the journal.
+ * The page is written when it's full or when its first sample is WLT_JOURNAL_FLUSH_S seconds old.
+ */
+void wlt_journal_add(uint32_t ts, int32_t temperature, int32_t humidity)
+{
+    wlt_journal_page_t *page = &wlt_journal.page;
+    int32_t values[WLT_JOURNAL_CHANNELS] = { temperature, humidity };
+    int n = 0;
+
+    if ((page->count > 0) && (ts - page->ts >= WLT_JOURNAL_FLUSH_S)) {
+        wlt_journal_flush();
+    }
+    if ((page->count > 0) && (page->count < UINT8_MAX)) {
+        n = wlt_codec_encode(page->data + page->len, WLT_JOURNAL_DATA_LEN - page->len, &wlt_journal.enc, ts, values);
+    }
+    if (n == 0) {
+        // page full (or none): the sample starts a new one
+        wlt_journal_flush();
+        memset(page, 0, sizeof(wlt_journal_page_t));
+        page->ts = ts;
+        wlt_codec_reset(&wlt_journal.enc, WLT_JOURNAL_CHANNELS, ts);
+        n = wlt_codec_encode(page->data, WLT_JOURNAL_DATA_LEN, &wlt_journal.enc, ts, values);
+    }
+    page->len += n;
+    page->count++;
+    wlt_journal.last_ts = ts;
+}
+
+/*
+ * Function: wlt_journal_last_ts()
+ * Description: This function returns the time of the last sample of the journal (0 if it's empty).
+ */
+uint32_t wlt_journal_last_ts(void)
+{
+    return wlt_journal.last_ts;
+}
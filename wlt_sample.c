@@ -0,0 +1,46 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "include/wlt_sample.h"
+
+// sequence lock: odd while the writer updates the snapshot
+static volatile uint32_t wlt_sample_seq = 0;
+static wlt_sample_t wlt_sample_data;
+
+/*
+ * Function: wlt_sample_publish()
+ * Description: This function publishes a new snapshot of the reading (single writer).
+ */
+void wlt_sample_publish(const wlt_sample_t *sample)
+{
+    uint32_t seq = wlt_sample_seq;
+
+    // odd: update in progress
+    wlt_sample_seq = seq + 1;
+    __dmb();
+    memcpy(&wlt_sample_data, sample, sizeof(wlt_sample_data));
+    // the values must be visible before the sequence is even again
+    __dmb();
+    wlt_sample_seq = seq + 2;
+    return;
+}
+
+/*
+ * Function: wlt_sample_read()
+ * Description: This function copies a consistent snapshot of the reading, without locks:
+ * the copy is repeated if the writer has updated the values in the meantime.
+ */
+void wlt_sample_read(wlt_sample_t *sample)
+{
+    uint32_t seq;
+
+    do {
+        // wait for the end of an update in progress
+        while ((seq = wlt_sample_seq) & 1) {
+            tight_loop_contents();
+        }
+        __dmb();
+        memcpy(sample, &wlt_sample_data, sizeof(wlt_sample_data));
+        __dmb();
+    } while (seq != wlt_sample_seq);
+    return;
+}
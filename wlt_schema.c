@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/wlt.h"
+#include "include/wlt_global.h"
+#include "include/wlt_fmt.h"
+#include "include/wlt_schema.h"
+
+// members of the runtime configuration: the saved ones have the same size in the EEPROM record
+#define WLT_SCHEMA_NET(member)              .size = sizeof(((wlt_net_config_t *)0)->member), \
+                                            .offset = offsetof(wlt_run_time_config_t, net_config.member)
+#define WLT_SCHEMA_OPTION(name)             .size = sizeof(settings_t), \
+                                            .shift = SETTINGS_SHIFT_##name, .width = WLT_SETTINGS_WIDTH(name), \
+                                            .offset = offsetof(wlt_run_time_config_t, data.settings), \
+                                            .saved_offset = offsetof(wlt_config_data_t, settings)
+#define WLT_SCHEMA_OUTPUT(member)           .size = sizeof(((outputs_t *)0)->member), \
+                                            .offset = offsetof(outputs_t, member), \
+                                            .saved_offset = offsetof(outputs_t, member)
+
+static bool wlt_schema_check_pass(const char *value);
+static bool wlt_schema_check_output(const uint8_t *item);
+
+// names of the values of the enumerations (index = value)
+static const char *const wlt_schema_wifi_modes[] = { "STA", "AP", NULL };
+static const char *const wlt_schema_t_formats[] = { "C", "F", NULL };
+static const char *const wlt_schema_out_formats[] = { "CSV", "TXT", NULL };
+static const char *const wlt_schema_themes[] = { "DARK", "LIGHT", NULL };
+static const char *const wlt_schema_data_types[] = { "NULL", "T", "H", "P", NULL };
+static const char *const wlt_schema_triggers[] = { "NONE", "H", "L", NULL };
+
+// the fields of each group are sorted by key (binary search)
+static const wlt_schema_field_t wlt_schema_outputs[] = {
+    { .key = "DT", .type = WLT_SCHEMA_ENUM, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OUTPUT(data_type),
+      .names = wlt_schema_data_types },
+    // TODO: for better validation, check if the GPIO is already used by other output and check
+    // if it's not used by other functions (e.g. I2C, SPI, UART) depending on the board pinout
+    { .key = "GPIO", .type = WLT_SCHEMA_INT, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OUTPUT(gpio_num),
+      .min = 0, .max = 26 },
+    // widest range of the data types, the range of DT is checked with the item (wlt_schema_check_output)
+    { .key = "TH", .type = WLT_SCHEMA_CENTI, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OUTPUT(threshold),
+      .min = MIN_THR_TEMP_VALUE, .max = MAX_THR_TEMP_VALUE },
+    { .key = "TR", .type = WLT_SCHEMA_ENUM, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OUTPUT(trigger),
+      .names = wlt_schema_triggers },
+};
+
+static const wlt_schema_field_t wlt_schema_settings[] = {
+    { .key = "OF", .type = WLT_SCHEMA_ENUM, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OPTION(out_format),
+      .names = wlt_schema_out_formats },
+    { .key = "PT", .type = WLT_SCHEMA_INT, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OPTION(poll_time),
+      .min = POLL_READ_TIME_MIN, .max = POLL_READ_TIME_MAX },
+    { .key = "TF", .type = WLT_SCHEMA_ENUM, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OPTION(t_format),
+      .names = wlt_schema_t_formats },
+    { .key = "TH", .type = WLT_SCHEMA_INT, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OPTION(trd_hyst),
+      .min = 0, .max = (1 << WLT_SETTINGS_WIDTH(trd_hyst)) - 1 },
+    { .key = "WT", .type = WLT_SCHEMA_ENUM, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_OPTION(theme),
+      .names = wlt_schema_themes },
+};
+
+// TODO: add ip, netmask, gateway parameters when in AP mode
+static const wlt_schema_field_t wlt_schema_wifi[] = {
+    { .key = "DEVNAME", .type = WLT_SCHEMA_STRING, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_NET(devicename),
+      .saved_offset = offsetof(wlt_config_data_t, devicename) },
+    // the addresses are assigned by the network in STA mode
+    { .key = "GW", .type = WLT_SCHEMA_IPV4, .flags = WLT_SCHEMA_READ_ONLY, WLT_SCHEMA_NET(gwaddr) },
+    { .key = "IPADDR", .type = WLT_SCHEMA_IPV4, .flags = WLT_SCHEMA_READ_ONLY, WLT_SCHEMA_NET(ipaddr) },
+    // the mode is selected at boot by GPIO_SELECT_WIFI_MODE
+    { .key = "MODE", .type = WLT_SCHEMA_ENUM, .flags = 0, WLT_SCHEMA_NET(wifi_mode),
+      .names = wlt_schema_wifi_modes },
+    { .key = "NET", .type = WLT_SCHEMA_IPV4, .flags = WLT_SCHEMA_READ_ONLY, WLT_SCHEMA_NET(ipmask) },
+    { .key = "PASS", .type = WLT_SCHEMA_STRING, .flags = WLT_SCHEMA_PERSIST | WLT_SCHEMA_WRITE_ONLY, WLT_SCHEMA_NET(wifi_pass),
+      .saved_offset = offsetof(wlt_config_data_t, wifi_pass), .check = wlt_schema_check_pass },
+    { .key = "SSID", .type = WLT_SCHEMA_STRING, .flags = WLT_SCHEMA_PERSIST, WLT_SCHEMA_NET(wifi_ssid),
+      .saved_offset = offsetof(wlt_config_data_t, wifi_ssid) },
+};
+
+#define WLT_SCHEMA_FIELDS(table)            (table), (uint8_t)(sizeof(table) / sizeof((table)[0]))
+
+// sorted by key, index = params_type_t
+static const wlt_schema_group_t wlt_schema_groups[PARAMS_MAX] = {
+    [PARAMS_OUTPUTS] = { "OUTS", WLT_SCHEMA_FIELDS(wlt_schema_outputs), OUTPUT_GPIO_MAX,
+                         offsetof(wlt_run_time_config_t, data.outputs), offsetof(wlt_config_data_t, outputs), sizeof(outputs_t),
+                         wlt_schema_check_output },
+    [PARAMS_SETTINGS] = { "SETTINGS", WLT_SCHEMA_FIELDS(wlt_schema_settings), 1, 0, 0, 0 },
+    [PARAMS_WIFI] = { "WIFI", WLT_SCHEMA_FIELDS(wlt_schema_wifi), 1, 0, 0, 0 },
+};
+
+/*
+ * Function: wlt_schema_check_pass()
+ * Description: This function checks the Wi-Fi password (length and characters).
+ */
+static bool wlt_schema_check_pass(const char *value)
+{
+    return (check_wifi_password(value) == WIFI_PASS_VALID);
+}
+
+/*
+ * Function: wlt_schema_check_output()
+ * Description: This function checks the threshold of an output against the range of its data type.
+ */
+static bool wlt_schema_check_output(const uint8_t *item)
+{
+    const outputs_t *output = (const outputs_t *)item;
+
+    switch (output->data_type) {
+        case WLT_DATA_TYPE_TEMP:
+            return (output->threshold >= MIN_THR_TEMP_VALUE) && (output->threshold <= MAX_THR_TEMP_VALUE);
+        case WLT_DATA_TYPE_HUMIDITY:
+            return (output->threshold >= MIN_THR_HUM_VALUE) && (output->threshold <= MAX_THR_HUM_VALUE);
+        default:
+            return true;
+    }
+}
+
+/*
+ * Function: wlt_schema_load()
+ * Description: This function returns the value of an integer field (member or bit field) from the
+ * address of its member.
+ */
+static int32_t wlt_schema_load(const uint8_t *p, const wlt_schema_field_t *field)
+{
+    uint32_t word;
+
+    switch (field->size) {
+        case 1:
+            word = *p;
+            break;
+        case 2:
+            word = *(const uint16_t *)p;
+            break;
+        default:
+            return *(const int32_t *)p;
+    }
+    if (field->width > 0) {
+        word = (word >> field->shift) & ((1u << field->width) - 1);
+    }
+    return (int32_t)word;
+}
+
+/*
+ * Function: wlt_schema_store()
+ * Description: This function writes the value of an integer field (member or bit field) at the
+ * address of its member, the other bits of the member are kept.
+ */
+static void wlt_schema_store(uint8_t *p, const wlt_schema_field_t *field, int32_t value)
+{
+    uint32_t word = (uint32_t)value;
+
+    if (field->width > 0) {
+        uint32_t mask = ((1u << field->width) - 1) << field->shift;
+        uint32_t old = (field->size == 1) ? *p : *(const uint16_t *)p;
+        word = (old & ~mask) | ((word << field->shift) & mask);
+    }
+    switch (field->size) {
+        case 1:
+            *p = (uint8_t)word;
+            break;
+        case 2:
+            *(uint16_t *)p = (uint16_t)word;
+            break;
+        default:
+            *(uint32_t *)p = word;
+            break;
+    }
+}
+
+/*
+ * Function: wlt_schema_copy()
+ * Description: This function copies a field between the runtime configuration and the EEPROM record
+ * (addresses of the member in both).
+ */
+static void wlt_schema_copy(uint8_t *dst, const uint8_t *src, const wlt_schema_field_t *field)
+{
+    if (field->type == WLT_SCHEMA_STRING) {
+        // the rest of the text is cleared and it's always terminated
+        strncpy((char *)dst, (const char *)src, field->size - 1);
+        dst[field->size - 1] = '\0';
+    } else {
+        wlt_schema_store(dst, field, wlt_schema_load(src, field));
+    }
+}
+
+/*
+ * Function: wlt_schema_name()
+ * Description: This function returns the name of the value of an enumeration ("UNK" if unknown).
+ */
+static const char *wlt_schema_name(const wlt_schema_field_t *field, int32_t value)
+{
+    for (int32_t i = 0; field->names[i] != NULL; i++) {
+        if (i == value) {
+            return field->names[i];
+        }
+    }
+    return "UNK";
+}
+
+/*
+ * Function: wlt_schema_parse_int()
+ * Description: This function converts the text of a decimal integer.
+ * It returns false if the text is not a number.
+ */
+static bool wlt_schema_parse_int(const char *text, int32_t *value)
+{
+    char *end;
+    long n = strtol(text, &end, 10);
+
+    if ((end == text) || (*end != '\0') || (n < INT32_MIN) || (n > INT32_MAX)) {
+        return false;
+    }
+    *value = (int32_t)n;
+    return true;
+}
+
+/*
+ * Function: wlt_schema_group()
+ * Description: This function returns a group of parameters by its index (params_type_t).
+ */
+const wlt_schema_group_t *wlt_schema_group(int index)
+{
+    return ((index >= 0) && (index < PARAMS_MAX)) ? &wlt_schema_groups[index] : NULL;
+}
+
+/*
+ * Function: wlt_schema_find_group()
+ * Description: This function looks for a group of parameters by key (binary search).
+ * It returns NULL if the key is unknown.
+ */
+const wlt_schema_group_t *wlt_schema_find_group(const char *key)
+{
+    int lo = 0;
+    int hi = PARAMS_MAX;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(key, wlt_schema_groups[mid].key);
+        if (cmp == 0) {
+            return &wlt_schema_groups[mid];
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function: wlt_schema_find_field()
+ * Description: This function looks for a field of a group by key (binary search).
+ * It returns NULL if the key is unknown.
+ */
+const wlt_schema_field_t *wlt_schema_find_field(const wlt_schema_group_t *group, const char *key)
+{
+    int lo = 0;
+    int hi = group->count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(key, group->fields[mid].key);
+        if (cmp == 0) {
+            return &group->fields[mid];
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function: wlt_schema_set()
+ * Description: This function checks the value (text, without quotes) of a parameter of a group and
+ * writes it in an item of the runtime configuration.
+ * The unknown and the read-only parameters are ignored.
+ * It returns WLT_SUCCESS or WLT_INVALID_ARGUMENT if the value is not valid.
+ */
+wlt_error_t wlt_schema_set(wlt_run_time_config_t *config, const wlt_schema_group_t *group, int item, const char *key, const char *value)
+{
+    const wlt_schema_field_t *field = wlt_schema_find_field(group, key);
+    uint8_t *base = (uint8_t *)config + group->offset + item * group->stride;
+    int32_t n = 0;
+
+    if ((field == NULL) || (field->flags & WLT_SCHEMA_READ_ONLY)) {
+        printf("Parameter '%s' of %s ignored\n", key, group->key);
+        return WLT_SUCCESS;
+    }
+    if ((field->check != NULL) && !field->check(value)) {
+        printf("Invalid %s value: %s\n", key, value);
+        return WLT_INVALID_ARGUMENT;
+    }
+    switch (field->type) {
+        case WLT_SCHEMA_STRING:
+            memset(base + field->offset, 0, field->size);
+            strncpy((char *)base + field->offset, value, field->size - 1);
+            printf("Setting %s to '%s'\n", key, value);
+            return WLT_SUCCESS;
+
+        case WLT_SCHEMA_INT:
+            if (!wlt_schema_parse_int(value, &n) || (n < field->min) || (n > field->max)) {
+                printf("Invalid %s value: %s\n", key, value);
+                return WLT_INVALID_ARGUMENT;
+            }
+            break;
+
+        case WLT_SCHEMA_ENUM:
+            while ((field->names[n] != NULL) && (strcmp(value, field->names[n]) != 0)) {
+                n++;
+            }
+            if (field->names[n] == NULL) {
+                printf("Invalid %s value: %s\n", key, value);
+                return WLT_INVALID_ARGUMENT;
+            }
+            break;
+
+        case WLT_SCHEMA_CENTI:
+            if (!fmt_parse_centi(value, &n) || (n < field->min) || (n > field->max)) {
+                printf("Invalid %s value: %s\n", key, value);
+                return WLT_INVALID_ARGUMENT;
+            }
+            break;
+
+        default:
+            printf("Parameter '%s' of %s can't be set\n", key, group->key);
+            return WLT_INVALID_ARGUMENT;
+    }
+    wlt_schema_store(base + field->offset, field, n);
+    printf("Setting %s to '%s'\n", key, value);
+    return WLT_SUCCESS;
+}
+
+/*
+ * Function: wlt_schema_check()
+ * Description: This function runs the checks between the fields of an item of a group, after
+ * wlt_schema_set() has set the parameters of the item (they can come in any order).
+ * It returns WLT_SUCCESS or WLT_INVALID_ARGUMENT if the item is not valid.
+ */
+wlt_error_t wlt_schema_check(const wlt_run_time_config_t *config, const wlt_schema_group_t *group, int item)
+{
+    const uint8_t *base = (const uint8_t *)config + group->offset + item * group->stride;
+
+    if ((group->check != NULL) && !group->check(base)) {
+        printf("Invalid parameters of item %d of %s\n", item + 1, group->key);
+        return WLT_INVALID_ARGUMENT;
+    }
+    return WLT_SUCCESS;
+}
+
+/*
+ * Function: wlt_schema_copy_item()
+ * Description: This function copies the fields of an item of a group that the API can set from a
+ * runtime configuration to another one (the other members are not changed).
+ */
+void wlt_schema_copy_item(wlt_run_time_config_t *dst, const wlt_run_time_config_t *src, const wlt_schema_group_t *group, int item)
+{
+    size_t base = group->offset + item * group->stride;
+
+    for (int i = 0; i < group->count; i++) {
+        const wlt_schema_field_t *field = &group->fields[i];
+        if (!(field->flags & WLT_SCHEMA_READ_ONLY)) {
+            memcpy((uint8_t *)dst + base + field->offset, (const uint8_t *)src + base + field->offset, field->size);
+        }
+    }
+}
+
+/*
+ * Function: wlt_schema_put()
+ * Description: This function appends formatted text to a fragment, writing only what fits.
+ */
+static void wlt_schema_put(char *buf, size_t max, size_t *pos, const char *tmpl, ...)
+{
+    va_list args;
+
+    va_start(args, tmpl);
+    *pos += fmt_vformat(buf + ((*pos < max) ? *pos : max), (*pos < max) ? max - *pos : 0, tmpl, args);
+    va_end(args);
+}
+
+/*
+ * Function: wlt_schema_render()
+ * Description: This function generates a fragment of the JSON of the configuration: one fragment
+ * per object (an item of a group), the write-only fields are skipped.
+ * It returns the length of the fragment (snprintf semantic) or WLT_SCHEMA_RENDER_END when the JSON
+ * is complete.
+ */
+int wlt_schema_render(char *buf, size_t max, int part, const wlt_run_time_config_t *config)
+{
+    const wlt_schema_group_t *group = NULL;
+    const uint8_t *base;
+    const char *sep = "";
+    size_t pos = 0;
+    int g;
+
+    // group and item of the part
+    for (g = 0; g < PARAMS_MAX; g++) {
+        if (part < wlt_schema_groups[g].items) {
+            group = &wlt_schema_groups[g];
+            break;
+        }
+        part -= wlt_schema_groups[g].items;
+    }
+    if (group == NULL) {
+        return WLT_SCHEMA_RENDER_END;
+    }
+    base = (const uint8_t *)config + group->offset + part * group->stride;
+
+    if (part == 0) {
+        wlt_schema_put(buf, max, &pos, "%s\"%s\":%s", (g == 0) ? "{" : "", group->key, (group->items > 1) ? "[" : "");
+    }
+    wlt_schema_put(buf, max, &pos, "{");
+    for (int i = 0; i < group->count; i++) {
+        const wlt_schema_field_t *field = &group->fields[i];
+        const uint8_t *p = base + field->offset;
+
+        if (field->flags & WLT_SCHEMA_WRITE_ONLY) {
+            continue;
+        }
+        wlt_schema_put(buf, max, &pos, "%s\"%s\":", sep, field->key);
+        sep = ",";
+        switch (field->type) {
+            case WLT_SCHEMA_STRING:
+                wlt_schema_put(buf, max, &pos, "\"%s\"", (const char *)p);
+                break;
+
+            case WLT_SCHEMA_ENUM:
+                wlt_schema_put(buf, max, &pos, "\"%s\"", wlt_schema_name(field, wlt_schema_load(p, field)));
+                break;
+
+            case WLT_SCHEMA_CENTI:
+                wlt_schema_put(buf, max, &pos, "%.2f", wlt_schema_load(p, field));
+                break;
+
+            case WLT_SCHEMA_IPV4:
+                // network order: the first byte is the first number
+                wlt_schema_put(buf, max, &pos, "\"%u.%u.%u.%u\"", p[0], p[1], p[2], p[3]);
+                break;
+
+            default:
+                wlt_schema_put(buf, max, &pos, "%d", wlt_schema_load(p, field));
+                break;
+        }
+    }
+    wlt_schema_put(buf, max, &pos, "}");
+    if (part == group->items - 1) {
+        wlt_schema_put(buf, max, &pos, "%s%s", (group->items > 1) ? "]" : "", (g == PARAMS_MAX - 1) ? "}" : ",");
+    } else {
+        wlt_schema_put(buf, max, &pos, ",");
+    }
+    return (int)pos;
+}
+
+/*
+ * Function: wlt_schema_pack()
+ * Description: This function copies the persisted fields of the runtime configuration in the
+ * record saved in the EEPROM (the other bytes of the record are not changed).
+ */
+void wlt_schema_pack(const wlt_run_time_config_t *rt_config, wlt_config_data_t *config)
+{
+    for (int g = 0; g < PARAMS_MAX; g++) {
+        const wlt_schema_group_t *group = &wlt_schema_groups[g];
+        for (int item = 0; item < group->items; item++) {
+            const uint8_t *src = (const uint8_t *)rt_config + group->offset + item * group->stride;
+            uint8_t *dst = (uint8_t *)config + group->saved_offset + item * group->stride;
+            for (int i = 0; i < group->count; i++) {
+                const wlt_schema_field_t *field = &group->fields[i];
+                if (field->flags & WLT_SCHEMA_PERSIST) {
+                    wlt_schema_copy(dst + field->saved_offset, src + field->offset, field);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Function: wlt_schema_unpack()
+ * Description: This function copies the persisted fields of the record read from the EEPROM in the
+ * runtime configuration (the other fields are not changed).
+ */
+void wlt_schema_unpack(const wlt_config_data_t *config, wlt_run_time_config_t *rt_config)
+{
+    for (int g = 0; g < PARAMS_MAX; g++) {
+        const wlt_schema_group_t *group = &wlt_schema_groups[g];
+        for (int item = 0; item < group->items; item++) {
+            const uint8_t *src = (const uint8_t *)config + group->saved_offset + item * group->stride;
+            uint8_t *dst = (uint8_t *)rt_config + group->offset + item * group->stride;
+            for (int i = 0; i < group->count; i++) {
+                const wlt_schema_field_t *field = &group->fields[i];
+                if (field->flags & WLT_SCHEMA_PERSIST) {
+                    wlt_schema_copy(dst + field->offset, src + field->saved_offset, field);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "include/wlt_spsc.h"
+
+/*
+ * Function: spsc_init()
+ * Description: This function initializes an empty ring on the given storage (slots * item_size bytes).
+ * It must be called before the other core starts using the ring.
+ * It returns false if the number of slots is not a power of 2.
+ */
+bool spsc_init(spsc_ring_t *ring, void *items, uint32_t slots, size_t item_size)
+{
+    if ((ring == NULL) || (items == NULL) || (slots < 2) || ((slots & (slots - 1)) != 0)) {
+        return false;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = slots - 1;
+    ring->item_size = item_size;
+    ring->items = (uint8_t *)items;
+    ring->dropped = 0;
+    return true;
+}
+
+/*
+ * Function: spsc_push()
+ * Description: This function copies an item in the ring (producer side only).
+ * It returns false if the ring is full, the item is dropped.
+ */
+bool spsc_push(spsc_ring_t *ring, const void *item)
+{
+    uint32_t head = ring->head;
+
+    if (((head + 1) & ring->mask) == ring->tail) {
+        ring->dropped++;
+        return false;
+    }
+    memcpy(ring->items + head * ring->item_size, item, ring->item_size);
+    // the item must be visible before the new head
+    __dmb();
+    ring->head = (head + 1) & ring->mask;
+    return true;
+}
+
+/*
+ * Function: spsc_pop()
+ * Description: This function copies out the oldest item of the ring (consumer side only).
+ * It returns false if the ring is empty.
+ */
+bool spsc_pop(spsc_ring_t *ring, void *item)
+{
+    uint32_t tail = ring->tail;
+
+    if (tail == ring->head) {
+        return false;
+    }
+    // read the item only after having seen the head
+    __dmb();
+    memcpy(item, ring->items + tail * ring->item_size, ring->item_size);
+    // the slot is released only after the copy
+    __dmb();
+    ring->tail = (tail + 1) & ring->mask;
+    return true;
+}
+
+/*
+ * Function: spsc_empty()
+ * Description: This function tells if there are no items to read.
+ */
+bool spsc_empty(const spsc_ring_t *ring)
+{
+    return (ring->tail == ring->head);
+}
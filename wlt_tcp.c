@@ -3,114 +3,116 @@
 #include "lwip/tcp.h"
 #include "include/wlt.h"
 #include "include/wlt_global.h"
+#include "include/wlt_fmt.h"
+#include "include/wlt_sample.h"
+#include "include/wlt_history.h"
+#include "include/wlt_config.h"
+#include "include/wlt_schema.h"
 #include "json/ecjp.h"
 
 extern wlt_error_t parse_post_specific_body(char *body, int api_index);
 extern wlt_error_t parse_post_body(char *body, size_t content_length);
 
-static char *http_get_req_str[HTTP_GET_REQ_MAX] = {
-    HTTP_NONE_URL,
-    STYLE_URL,
-    STYLE_FORM_DARK_URL,
-    STYLE_FORM_LIGHT_URL,
-    STYLE_HOME_DARK_URL,
-    STYLE_HOME_LIGHT_URL,
-    HOME_URL,
-    FAVICON_URL,
-    SETTINGS_URL,
-    SETTINGS_FORM_URL,
-    ADVANCED_URL,
-    ADVANCED_FORM_URL,
-    SET_HIGH_TEMP_URL,   
-    SET_HIGH_TEMP_FORM_URL,
-    SET_LOW_TEMP_URL,
-    SET_LOW_TEMP_FORM_URL, 
-    SET_HIGH_HUM_URL,      
-    SET_HIGH_HUM_FORM_URL, 
-    SET_LOW_HUM_URL,       
-    SET_LOW_HUM_FORM_URL,  
-    API_GET_INFO_URL,
-    API_GET_SETTINGS_URL
-};
-
-static char *http_post_req_str[HTTP_POST_REQ_MAX] = {
-    API_SET_ALL_PARAMS_URL,
-    API_SET_WIFI_PARAMS_URL,
-    API_SET_SETTING_PARAMS_URL, 
-    API_SET_OUT_PARAMS_URL
-};
+err_t tcp_server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err);
 
-/*
-* Function: get_path()
-* Description: This function extracts the path from an HTTP request string.
-*/
-int get_path(const char *req, const char **path_start, size_t *path_len)
-{
-    const char *start = req;
-    if (!start) return -1;
-
-    const char *end = strchr(start, ' ');
-    if (!end) return -1;
+// connection slots, allocated at boot: no heap allocation per connection
+static TCP_CONNECT_STATE_T tcp_conn_slots[WLT_HTTP_MAX_CONN];
+static TCP_CONNECT_STATE_T *tcp_conn_free;
+static bool tcp_conn_pool_ready = false;
+static uint32_t tcp_conn_idle_seq = 0;
 
-    *path_start = start;
-    *path_len = end - start;
+// pages rendered once per sample generation
+static tcp_render_entry_t tcp_render_cache[HTTP_RENDER_CACHE_ENTRIES];
 
-    return 0;
+/*
+ * Function: tcp_render_release()
+ * Description: This function releases the cached page sent by the connection (if any):
+ * when no connection uses it, the page can be rendered again.
+ */
+static void tcp_render_release(TCP_CONNECT_STATE_T *con_state)
+{
+    if (con_state->render != NULL) {
+        con_state->render->refs--;
+        con_state->render = NULL;
+    }
 }
 
 /*
-* Function: tcp_find_get_request()
-* Description: This function identifies the type of HTTP GET request based on the path in the request string.
-* It returns the corresponding enum value for the request type, or HTTP_GET_REQ_MAX if the request type is not recognized.
-*/
-enum http_get_req tcp_find_get_request(const char *req)
+ * Function: tcp_conn_pool_init()
+ * Description: This function links all the connection slots in the free list.
+ */
+static void tcp_conn_pool_init(void)
 {
-    enum http_get_req page;
-    const char *path;
-    size_t len;
-
-    if (get_path(req, &path, &len) != 0)
-        return HTTP_GET_REQ_MAX;
-    
-    for (page = 0; page < HTTP_GET_REQ_MAX; page++) {
-        const char *ref = http_get_req_str[page];
-        size_t ref_len = strlen(ref);
-
-        if (len == ref_len && strncmp(path, ref, len) == 0) {
-            return page;
-        }
+    tcp_conn_free = NULL;
+    for (int i = WLT_HTTP_MAX_CONN - 1; i >= 0; i--) {
+        tcp_conn_slots[i].pcb = NULL;
+        tcp_conn_slots[i].next_free = tcp_conn_free;
+        tcp_conn_free = &tcp_conn_slots[i];
     }
-    return HTTP_GET_REQ_MAX;
+    tcp_conn_pool_ready = true;
 }
 
 /*
- * Function: tcp_find_post_request()
- * Description: This function identifies the type of HTTP POST request based on the path in the request string.
- * It returns the corresponding enum value for the request type, or HTTP_POST_REQ_MAX if the request type is not recognized.
-*/
-enum http_post_req tcp_find_post_request(const char *req)
+ * Function: tcp_conn_acquire()
+ * Description: This function takes a slot from the free list.
+ * It returns NULL if all the slots are in use.
+ */
+static TCP_CONNECT_STATE_T *tcp_conn_acquire(void)
 {
-    enum http_post_req api;
-    const char *path;
-    size_t len;
+    TCP_CONNECT_STATE_T *con_state = tcp_conn_free;
 
-    if (get_path(req, &path, &len) != 0)
-        return HTTP_POST_REQ_MAX;
+    if (con_state != NULL) {
+        tcp_conn_free = con_state->next_free;
+        memset(con_state, 0, sizeof(TCP_CONNECT_STATE_T));
+    }
+    return con_state;
+}
 
-    for (api = 0; api < HTTP_POST_REQ_MAX; api++) {
-        const char *ref = http_post_req_str[api];
-        size_t ref_len = strlen(ref);
+/*
+ * Function: tcp_conn_release()
+ * Description: This function gives the slot back to the free list.
+ */
+static void tcp_conn_release(TCP_CONNECT_STATE_T *con_state)
+{
+    tcp_render_release(con_state);
+    if (con_state->rx_pending != NULL) {
+        pbuf_free(con_state->rx_pending);
+        con_state->rx_pending = NULL;
+    }
+    con_state->pcb = NULL;
+    con_state->next_free = tcp_conn_free;
+    tcp_conn_free = con_state;
+}
 
-        if (len == ref_len && strncmp(path, ref, len) == 0) {
-            return api;
+/*
+ * Function: tcp_conn_oldest_idle()
+ * Description: This function looks for the persistent connection idle for the longest time,
+ * i.e. one that has completed at least a request and is waiting for the next one.
+ * It's used only when all the slots are in use.
+ * It returns NULL if all the connections are busy.
+ */
+static TCP_CONNECT_STATE_T *tcp_conn_oldest_idle(void)
+{
+    TCP_CONNECT_STATE_T *oldest = NULL;
+
+    for (int i = 0; i < WLT_HTTP_MAX_CONN; i++) {
+        TCP_CONNECT_STATE_T *con_state = &tcp_conn_slots[i];
+        if ((con_state->pcb == NULL) || con_state->busy || (con_state->requests == 0) ||
+            (con_state->rx_pending != NULL) ||
+            (con_state->req.state != HTTP_PARSE_METHOD) || (con_state->req.pos != 0)) {
+            // free, replying, never used or with a request partially received (or pipelined)
+            continue;
+        }
+        if ((oldest == NULL) || ((int32_t)(con_state->idle_seq - oldest->idle_seq) < 0)) {
+            oldest = con_state;
         }
     }
-    return HTTP_POST_REQ_MAX;
+    return oldest;
 }
 
 /*
  * Function: tcp_close_client_connection()
- * Description: This function closes the TCP client connection and frees the connection state.
+ * Description: This function closes the TCP client connection and releases the connection slot.
  * It returns an error code.
  */
 static err_t tcp_close_client_connection(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *client_pcb, err_t close_err)
@@ -129,7 +131,7 @@ static err_t tcp_close_client_connection(TCP_CONNECT_STATE_T *con_state, struct
             close_err = ERR_ABRT;
         }
         if (con_state) {
-            free(con_state);
+            tcp_conn_release(con_state);
         }
     }
     return close_err;
@@ -149,169 +151,651 @@ void tcp_server_close(TCP_SERVER_T *state)
 }
 
 /*
- * Function: tcp_server_sent()
- * Description: This function is called when data has been sent to the client.
- * It checks if all data has been sent and closes the connection if so.
+ * Function: tcp_server_reset_state()
+ * Description: This function resets the connection state to be ready for the next request
+ * on a persistent connection.
+ */
+static void tcp_server_reset_state(TCP_CONNECT_STATE_T *con_state)
+{
+    con_state->sent_len = 0;
+    con_state->header_len = 0;
+    con_state->result_len = 0;
+    con_state->busy = false;
+    con_state->idle_polls = 0;
+    con_state->static_data = NULL;
+    con_state->static_len = 0;
+    tcp_render_release(con_state);
+    con_state->stream_fill = NULL;
+    con_state->ring_used = 0;
+    con_state->idle_seq = tcp_conn_idle_seq++;
+    // the body of a POST request is collected in the ring buffer (it's free until the reply)
+    http_parser_init(&con_state->req, con_state->ring, sizeof(con_state->ring));
+}
+
+/*
+ * Function: tcp_conn_hdr()
+ * Description: This function returns the value of the Connection header to use in the reply.
+ */
+static const char *tcp_conn_hdr(TCP_CONNECT_STATE_T *con_state)
+{
+    return con_state->keep_alive ? HTTP_CONN_KEEP_ALIVE : HTTP_CONN_CLOSE;
+}
+
+/*
+ * Function: tcp_check_keep_alive()
+ * Description: This function checks if the connection can stay open after the reply.
+ * HTTP/1.1 connections are persistent unless the client sends "Connection: close",
+ * HTTP/1.0 connections are persistent only if the client sends "Connection: keep-alive".
+ */
+static bool tcp_check_keep_alive(TCP_CONNECT_STATE_T *con_state)
+{
+    if (con_state->requests >= HTTP_KEEPALIVE_MAX_REQ) {
+        return false;
+    }
+    if (con_state->req.http_1_0) {
+        return con_state->req.conn_keep_alive;
+    }
+    return !con_state->req.conn_close;
+}
+
+/*
+ * Function: tcp_server_send_reply()
+ * Description: This function sends a reply without body (the headers prepared in the connection state).
  * It returns an error code.
-*/
-static err_t tcp_server_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+ */
+static err_t tcp_server_send_reply(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb)
 {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    printf("tcp_server_sent %u\n", len);
-    con_state->sent_len += len;
-    if (con_state->sent_len >= con_state->header_len + con_state->result_len) {
-        printf("all done\n");
-        return tcp_close_client_connection(con_state, pcb, ERR_OK);
+    err_t err;
+
+    // Send the headers to the client
+    con_state->sent_len = 0;
+    con_state->result_len = 0;
+    err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
+    if (err != ERR_OK) {
+        printf("failed to write header data %d\n", err);
+        return tcp_close_client_connection(con_state, pcb, err);
     }
     return ERR_OK;
 }
 
 /*
- * Function: tcp_server_recv()
- * Description: This function is called when data is received from the client.
- * It processes the received data and sends a response back to the client.
+ * Function: tcp_server_write_static()
+ * Description: This function writes the static asset directly from flash (no copy),
+ * as much as the send buffer allows. It's called again from tcp_server_sent() until
+ * all the asset has been written.
  * It returns an error code.
  */
-static int build_req_settings_form(char *result, size_t max_result_len)
+static err_t tcp_server_write_static(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb)
 {
-    // Build the settings form
-    // NOTE: Wireshark tell me that this packet is malformed but the browser seems to handle it correctly (no error reported)
-    // I see 3 0x00 bytes at the end of the packet, but I don't know why
-    int len = 0;
-    int len2copy = 0;
+    err_t err;
 
-    if (prtconfig == NULL) {
-        printf("prtconfig is NULL\n");
-        return 0; // Error
+    while (con_state->static_len > 0) {
+        u16_t len = tcp_sndbuf(pcb);
+        if (len == 0) {
+            break;
+        }
+        if (len > con_state->static_len) {
+            len = con_state->static_len;
+        }
+        // the data is constant and stays valid until it's acknowledged: don't copy it
+        err = tcp_write(pcb, con_state->static_data, len, 0);
+        if (err == ERR_MEM) {
+            // send queue is full, continue when some data is acknowledged
+            break;
+        }
+        if (err != ERR_OK) {
+            return err;
+        }
+        con_state->static_data += len;
+        con_state->static_len -= len;
     }
-    if (pconfig == NULL) {
-        printf("pconfig is NULL\n");
-        return 0; // Error
+    return ERR_OK;
+}
+
+/*
+ * Function: tcp_server_send_static()
+ * Description: This function sends a static asset generated at build time: the gzip content is
+ * sent if the client accepts it, the body is sent from flash without copying it.
+ * If the client copy is still valid (If-None-Match matches the ETag) only the 304 headers are sent.
+ * It returns an error code.
+ */
+static err_t tcp_server_send_static(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_web_asset_t *asset)
+{
+    err_t err;
+    const char *encoding = "";
+    const char *etag = asset->etag;
+    const uint8_t *data = asset->data;
+    int len = asset->len;
+
+    if (asset->gz_data != NULL) {
+        if (con_state->req.accept_gzip) {
+            encoding = HTTP_HDR_GZIP;
+            etag = asset->gz_etag;
+            data = asset->gz_data;
+            len = asset->gz_len;
+        } else {
+            encoding = HTTP_HDR_VARY;
+        }
     }
 
-    if (prtconfig->data.settings.options.theme == THEME_DARK) {
-        len2copy = snprintf(result + len, max_result_len - len, SETTINGS_REPLY_HEAD, STYLE_FORM_DARK_URL);
-    } else {
-        len2copy = snprintf(result + len, max_result_len - len, SETTINGS_REPLY_HEAD, STYLE_FORM_LIGHT_URL);
+    if (http_etag_match(con_state->req.if_none_match, etag)) {
+        printf("Asset not modified: %s\n", asset->path);
+        con_state->result_len = 0;
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_NOT_MODIFIED,
+                                         encoding, etag, HTTP_CACHE_MAX_AGE_S, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
     }
-    if ((len2copy > 0) && (len2copy < max_result_len)) {
-        len += len2copy;
-    } else {
-        printf("Error generating settings head content (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-        return 0; // Error
-    }   
-    // copy the wifi form
-    // we show the wifi SSID used in Station mode, the password is left blank
-    // to avoid security issues, the device name is shown as well
-    len2copy = snprintf(result + len,
-                        max_result_len - len,
-                        SETTINGS_REPLY_FORM_WIFI,
-                        pconfig->wifi_ssid,
-                        WIFI_PASS_HIDDEN,
-                        prtconfig->net_config.devicename);
-    if ((len2copy > 0) && (len2copy < (max_result_len - len))) {
-        len += len2copy;
-    } else {
-        printf("Error generating settings wifi form content (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-        return 0; // Error
-    }
-    // copy the sensor form
-    len2copy = snprintf(result + len,
-                        max_result_len - len,
-                        SETTINGS_REPLY_FORM_SENSOR,
-                        prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? "checked" : "",
-                        prtconfig->data.settings.options.t_format == T_FORMAT_FAHRENHEIT ? "checked" : "",
-                        prtconfig->data.settings.options.out_format == OUT_FORMAT_TXT ? "checked" : "",
-                        prtconfig->data.settings.options.out_format == OUT_FORMAT_CSV ? "checked" : "");
-    if ((len2copy > 0) && (len2copy < (max_result_len - len))) {
-        len += len2copy;
-    } else {
-        printf("Error generating settings wifi form content (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-        return 0; // Error
+
+    con_state->static_data = data;
+    con_state->static_len = len;
+    con_state->result_len = len;
+    con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_ASSET,
+                                     len, asset->content_type, encoding, etag, HTTP_CACHE_MAX_AGE_S, tcp_conn_hdr(con_state));
+
+    con_state->sent_len = 0;
+    err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
+    if (err == ERR_OK) {
+        err = tcp_server_write_static(con_state, pcb);
     }
-    // copy the footer
-    len2copy = strlen(SETTINGS_REPLY_FOOTER);
-    if ((len + len2copy) >= max_result_len) {
-        printf("Result buffer too small for settings footer (len=%d, len2copy=%d, max_result_len=%zu)\n", len, len2copy, max_result_len);
-        return 0; // Error
+    if (err != ERR_OK) {
+        printf("failed to write static data %d\n", err);
+        return tcp_close_client_connection(con_state, pcb, err);
     }
-    else {
-        len += snprintf(result + len, max_result_len - len, SETTINGS_REPLY_FOOTER);
+    return ERR_OK;
+}
+
+/*
+ * Function: tcp_stream_room()
+ * Description: This function returns the contiguous free space of the ring buffer where the next
+ * fragment is written. When the free space at the start of the ring is larger than the one at
+ * the end, the write position wraps (the end of the data is recorded in ring_wrap).
+ */
+static int tcp_stream_room(TCP_CONNECT_STATE_T *con_state)
+{
+    if (con_state->ring_used == 0) {
+        con_state->ring_head = 0;
+        con_state->ring_tail = 0;
+        con_state->ring_wrap = 0;
+        return sizeof(con_state->ring);
     }
-    if (len < 0) {
-        printf("Error generating settings content\n");
-        return 0; // Error
+    if ((con_state->ring_wrap == 0) && (con_state->ring_head > con_state->ring_tail)) {
+        // data in [tail, head)
+        int end = sizeof(con_state->ring) - con_state->ring_head;
+        if (con_state->ring_tail > end) {
+            con_state->ring_wrap = con_state->ring_head;
+            con_state->ring_head = 0;
+            return con_state->ring_tail;
+        }
+        return end;
     }
-    else {
-        printf("Settings content generated successfully, length: %d\n", len);
+    // data in [tail, wrap) and [0, head)
+    return con_state->ring_tail - con_state->ring_head;
+}
+
+/*
+ * Function: tcp_stream_release()
+ * Description: This function frees the bytes of the ring buffer acknowledged by the client.
+ */
+static void tcp_stream_release(TCP_CONNECT_STATE_T *con_state, int len)
+{
+    while ((len > 0) && (con_state->ring_used > 0)) {
+        int end = (con_state->ring_wrap != 0) ? con_state->ring_wrap : con_state->ring_head;
+        int n = end - con_state->ring_tail;
+        if (n > len) {
+            n = len;
+        }
+        con_state->ring_tail += n;
+        con_state->ring_used -= n;
+        len -= n;
+        if ((con_state->ring_wrap != 0) && (con_state->ring_tail == con_state->ring_wrap)) {
+            con_state->ring_tail = 0;
+            con_state->ring_wrap = 0;
+        }
     }
+}
 
-    return len;
+/*
+ * Function: tcp_stream_pump()
+ * Description: This function asks the fill function of the reply for the next fragments and writes
+ * them from the ring buffer (no copy), while the ring and the send buffer have room.
+ * Each fragment is a chunk when the reply uses "Transfer-Encoding: chunked".
+ * It's called again from tcp_server_sent() when the client acknowledges some data.
+ * It returns an error code.
+ */
+static err_t tcp_stream_pump(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb)
+{
+    int overhead = con_state->chunked ? (HTTP_CHUNK_HDR_LEN + 2) : 0;
+    err_t err;
+
+    while (con_state->stream_fill != NULL) {
+        int room = tcp_stream_room(con_state);
+        char *buf = con_state->ring + con_state->ring_head;
+        char *data = buf + (con_state->chunked ? HTTP_CHUNK_HDR_LEN : 0);
+        int n;
+
+        if (room <= overhead) {
+            break;
+        }
+        // the fill function only formats: it's called again with the same part if the fragment
+        // doesn't fit or can't be written now
+        n = con_state->stream_fill(con_state, data, room - overhead, con_state->stream_part);
+        if (n == TCP_STREAM_END) {
+            if (con_state->chunked) {
+                // last chunk (from flash)
+                err = tcp_write(pcb, HTTP_CHUNK_LAST, sizeof(HTTP_CHUNK_LAST) - 1, 0);
+                if (err == ERR_MEM) {
+                    break;
+                }
+                if (err != ERR_OK) {
+                    return err;
+                }
+                con_state->result_len += sizeof(HTTP_CHUNK_LAST) - 1;
+            }
+            con_state->stream_fill = NULL;
+            break;
+        }
+        if ((n < 0) || ((n >= room - overhead) && (con_state->ring_used == 0))) {
+            printf("Error generating fragment %u of the reply (n=%d)\n", (unsigned int)con_state->stream_part, n);
+            return ERR_VAL;
+        }
+        if (n >= room - overhead) {
+            // wait until the client acknowledges some data
+            break;
+        }
+        if (n == 0) {
+            // empty fragment: nothing to send (a zero length chunk ends the reply)
+            con_state->stream_part++;
+            continue;
+        }
+        if (con_state->chunked) {
+            char hdr[HTTP_CHUNK_HDR_LEN + 1];
+            fmt_format(hdr, sizeof(hdr), HTTP_CHUNK_HDR, n);
+            memcpy(buf, hdr, HTTP_CHUNK_HDR_LEN);
+            memcpy(data + n, "\r\n", 2);
+        }
+        err = tcp_write(pcb, buf, n + overhead, 0);
+        if (err == ERR_MEM) {
+            // send queue is full, continue when some data is acknowledged
+            break;
+        }
+        if (err != ERR_OK) {
+            return err;
+        }
+        // the bytes stay in the ring until they are acknowledged
+        con_state->ring_head += n + overhead;
+        con_state->ring_used += n + overhead;
+        con_state->result_len += n + overhead;
+        con_state->stream_part++;
+    }
+    return ERR_OK;
 }
 
 /*
- * Function: build_req_adv_settings_form()
- * Description: This function builds the advanced settings form.
- * It returns the length of the generated content or 0 in case of error.
+ * Function: tcp_server_send_stream()
+ * Description: This function starts a reply generated by fragments (the length is not known):
+ * the body is sent with "Transfer-Encoding: chunked", or delimited by the close of the connection
+ * for HTTP/1.0 clients.
+ * It returns an error code.
  */
-static int build_req_adv_settings_form(char *result, size_t max_result_len)
+static err_t tcp_server_send_stream(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, tcp_stream_fill_t fill, const char *content_type)
 {
-    // Build the advanced settings form
-    int len = 0;
-    int len2copy = 0;
+    err_t err;
 
-    if (prtconfig == NULL) {
-        printf("prtconfig is NULL\n");
-        return 0; // Error
+    con_state->chunked = !con_state->req.http_1_0;
+    if (!con_state->chunked) {
+        con_state->keep_alive = false;
+    }
+    con_state->stream_fill = fill;
+    con_state->stream_part = 0;
+    con_state->result_len = 0;
+    con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_STREAM,
+                                     content_type, con_state->chunked ? HTTP_HDR_CHUNKED : "", tcp_conn_hdr(con_state));
+
+    con_state->sent_len = 0;
+    err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
+    if (err == ERR_OK) {
+        err = tcp_stream_pump(con_state, pcb);
     }
+    if (err != ERR_OK) {
+        printf("failed to write stream data %d\n", err);
+        return tcp_close_client_connection(con_state, pcb, err);
+    }
+    return ERR_OK;
+}
 
-    len2copy = snprintf(result + len, max_result_len - len, ADVANCED_REPLY_HEAD);
-    if ((len2copy > 0) && (len2copy < max_result_len)) {
-        len += len2copy;
-    } else {
-        printf("Error generating advparams head content (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-        return 0; // Error
-    }
-
-    // copy the sensor config form
-    len2copy = snprintf(result + len, max_result_len - len,
-                        ADVANCED_REPLY_FORM_SENSOR,
-                        POLL_READ_TIME_MIN,
-                        POLL_READ_TIME_MAX,
-                        prtconfig->data.settings.options.poll_time);
-    if ((len2copy > 0) && (len2copy < max_result_len)) {
-        len += len2copy;
+/*
+ * Function: tcp_server_send_const()
+ * Description: This function sends a constant page (stored in flash) without copying it.
+ * It returns an error code.
+ */
+static err_t tcp_server_send_const(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const char *text, bool json)
+{
+    err_t err;
+
+    con_state->static_data = (const uint8_t *)text;
+    con_state->static_len = strlen(text);
+    con_state->result_len = con_state->static_len;
+    if (json) {
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_JSON, 200, con_state->result_len, "json", tcp_conn_hdr(con_state));
     } else {
-        printf("Error generating advparams content (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-        return 0; // Error
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS, 200, con_state->result_len, "html", tcp_conn_hdr(con_state));
     }
 
-    // copy the thresholds form
-    len2copy = snprintf(result + len, max_result_len - len, ADVANCED_REPLY_FORM_THRESHOLDS);
-    if ((len2copy > 0) && (len2copy < max_result_len)) {
-        len += len2copy;
-    } else {
-        printf("Error generating advparams head content (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-        return 0; // Error
+    con_state->sent_len = 0;
+    err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
+    if (err == ERR_OK) {
+        err = tcp_server_write_static(con_state, pcb);
     }
+    if (err != ERR_OK) {
+        printf("failed to write page %d\n", err);
+        return tcp_close_client_connection(con_state, pcb, err);
+    }
+    return ERR_OK;
+}
+
+/*
+ * Function: tcp_push_write()
+ * Description: This function queues data (an event, a WebSocket frame) on a connection that
+ * stays open to receive pushed data. The header and the data are copied one after the other
+ * in the ring buffer and written from there (no copy) until acknowledged.
+ * It returns ERR_MEM if the client is too slow and the ring or the send buffer is full:
+ * the caller can drop the data (the next event carries fresh data anyway).
+ */
+static err_t tcp_push_write(TCP_CONNECT_STATE_T *con_state, const void *hdr, int hdr_len, const void *data, int len)
+{
+    int room = tcp_stream_room(con_state);
+    char *buf = con_state->ring + con_state->ring_head;
+    err_t err;
 
-    // copy the footer
-    len2copy = strlen(ADVANCED_REPLY_FOOTER);
-    if ((len + len2copy) >= max_result_len) {
-        printf("Result buffer too small for settings footer (len=%d, len2copy=%d, max_result_len=%zu)\n", len, len2copy, max_result_len);
-        return 0; // Error
+    if (hdr_len + len > room) {
+        printf("push: ring full, data dropped\n");
+        return ERR_MEM;
+    }
+    if (hdr_len > 0) {
+        memcpy(buf, hdr, hdr_len);
+    }
+    if (len > 0) {
+        memcpy(buf + hdr_len, data, len);
     }
-    else {
-        len += snprintf(result + len, max_result_len - len, ADVANCED_REPLY_FOOTER);
+    err = tcp_write(con_state->pcb, buf, hdr_len + len, 0);
+    if (err != ERR_OK) {
+        if (err == ERR_MEM) {
+            printf("push: send buffer full, data dropped\n");
+        }
+        return err;
     }
-    if (len < 0) {
-        printf("Error generating settings content\n");
-        return 0; // Error
+    con_state->ring_head += hdr_len + len;
+    con_state->ring_used += hdr_len + len;
+    con_state->result_len += hdr_len + len;
+    // we can be out of a lwIP callback: send now
+    return tcp_output(con_state->pcb);
+}
+
+/*
+ * Function: tcp_push_clients()
+ * Description: This function counts the connections held open to push data: subscribed to the event stream,
+ * upgraded to WebSocket or waiting for a new sample (long poll).
+ */
+static int tcp_push_clients(void)
+{
+    int clients = 0;
+
+    for (int i = 0; i < WLT_HTTP_MAX_CONN; i++) {
+        if ((tcp_conn_slots[i].pcb != NULL) && (tcp_conn_slots[i].sse || tcp_conn_slots[i].ws || tcp_conn_slots[i].parked)) {
+            clients++;
+        }
     }
+    return clients;
+}
+
+/*
+ * Function: tcp_ws_send()
+ * Description: This function sends a WebSocket frame (single fragment).
+ * It returns an error code.
+ */
+static err_t tcp_ws_send(TCP_CONNECT_STATE_T *con_state, uint8_t opcode, const void *data, int len)
+{
+    uint8_t hdr[WS_HDR_MAX_LEN];
+
+    return tcp_push_write(con_state, hdr, ws_frame_header(hdr, opcode, len), data, len);
+}
 
+/*
+ * Function: tcp_sse_format()
+ * Description: This function formats an event of the event stream.
+ * The temperature is in the unit of the settings (the sample is in Celsius).
+ * It returns the length of the event (>= max if it doesn't fit).
+ */
+static int tcp_sse_format(tcp_sse_event_t event, char *buf, size_t max)
+{
+    int len;
+
+    if (event == TCP_SSE_SAMPLE) {
+        wlt_sample_t sample;
+        wlt_sample_read(&sample);
+        bool celsius = (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS);
+        return fmt_format(buf, max,
+                        SSE_EVENT_SAMPLE,
+                        celsius ? sample.temperature : fmt_centi_c2f(sample.temperature),
+                        celsius ? "C" : "F",
+                        sample.humidity);
+    }
+    len = fmt_format(buf, max, SSE_EVENT_OUTPUTS);
+    for (int i = 0; (i < OUTPUT_GPIO_MAX) && (len < (int)max); i++) {
+        len += fmt_format(buf + len, max - len, "%s%d", (i > 0) ? "," : "", prtconfig->outputs_rt[i].gpio_state ? 1 : 0);
+    }
+    if (len < (int)max) {
+        len += fmt_format(buf + len, max - len, SSE_EVENT_OUTPUTS_END);
+    }
     return len;
 }
 
+/*
+ * Function: tcp_ws_format()
+ * Description: This function encodes an event in the payload of a binary WebSocket frame.
+ * It returns the length of the payload.
+ */
+static int tcp_ws_format(tcp_sse_event_t event, uint8_t *buf)
+{
+    if (event == TCP_SSE_SAMPLE) {
+        wlt_sample_t sample;
+        wlt_sample_read(&sample);
+        bool celsius = (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS);
+        // the sample is in Celsius: T is sent in the unit of TF
+        int16_t t = (int16_t)(celsius ? sample.temperature : fmt_centi_c2f(sample.temperature));
+        uint16_t h = (uint16_t)sample.humidity;
+        buf[0] = WS_EVENT_SAMPLE;
+        buf[1] = (uint8_t)t;
+        buf[2] = (uint8_t)((uint16_t)t >> 8);
+        buf[3] = celsius ? 'C' : 'F';
+        buf[4] = (uint8_t)h;
+        buf[5] = (uint8_t)(h >> 8);
+        return 6;
+    }
+    buf[0] = WS_EVENT_OUTPUTS;
+    buf[1] = OUTPUT_GPIO_MAX;
+    buf[2] = 0;
+    for (int i = 0; i < OUTPUT_GPIO_MAX; i++) {
+        if (prtconfig->outputs_rt[i].gpio_state) {
+            buf[2] |= (1 << i);
+        }
+    }
+    return 3;
+}
+
+/*
+ * Function: tcp_server_notify()
+ * Description: This function sends an event to all the connections subscribed to the event stream
+ * and to the WebSocket clients. It's called from the main loop when new data is available.
+ */
+void tcp_server_notify(tcp_sse_event_t event)
+{
+    char sse[SSE_EVENT_MAX_LEN];
+    uint8_t ws[WS_EVENT_MAX_LEN];
+    int sse_len = -1;
+    int ws_len = -1;
+
+    for (int i = 0; i < WLT_HTTP_MAX_CONN; i++) {
+        TCP_CONNECT_STATE_T *con_state = &tcp_conn_slots[i];
+        err_t err;
+
+        if ((con_state->pcb == NULL) || con_state->ws_closing) {
+            continue;
+        }
+        // format the event once, only if someone is listening
+        if (con_state->sse) {
+            if (sse_len < 0) {
+                sse_len = tcp_sse_format(event, sse, sizeof(sse));
+                if (sse_len >= (int)sizeof(sse)) {
+                    printf("event stream: event too long (%d)\n", sse_len);
+                    return;
+                }
+            }
+            err = tcp_push_write(con_state, NULL, 0, sse, sse_len);
+        } else if (con_state->ws) {
+            if (ws_len < 0) {
+                ws_len = tcp_ws_format(event, ws);
+            }
+            err = tcp_ws_send(con_state, WS_OPCODE_BINARY, ws, ws_len);
+        } else {
+            continue;
+        }
+        if ((err != ERR_OK) && (err != ERR_MEM)) {
+            printf("push: write failed %d\n", err);
+            tcp_close_client_connection(con_state, con_state->pcb, err);
+        }
+    }
+}
+
+/*
+ * Function: tcp_server_sent()
+ * Description: This function is called when data has been sent to the client.
+ * When all data has been sent, it closes the connection or, if the connection is
+ * persistent, resets the connection state for the next request.
+ * It returns an error code.
+*/
+static err_t tcp_server_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
+    int body_len = len;
+    err_t err;
+
+    printf("tcp_server_sent %u\n", len);
+    // the headers are sent first, the rest is body (ring bytes to release)
+    if (con_state->sent_len < con_state->header_len) {
+        int header_left = con_state->header_len - con_state->sent_len;
+        body_len -= (header_left < len) ? header_left : len;
+    }
+    con_state->sent_len += len;
+    con_state->idle_polls = 0;
+    tcp_stream_release(con_state, body_len);
+    if (con_state->sse || con_state->ws) {
+        // the event stream never ends, the WebSocket only after the closing handshake
+        if (con_state->ws_closing && (con_state->ring_used == 0)) {
+            printf("WebSocket closed\n");
+            return tcp_close_client_connection(con_state, pcb, ERR_OK);
+        }
+        return ERR_OK;
+    }
+    if (con_state->static_len > 0) {
+        // continue to write the static asset
+        err = tcp_server_write_static(con_state, pcb);
+        if (err != ERR_OK) {
+            printf("failed to write static data %d\n", err);
+            return tcp_close_client_connection(con_state, pcb, err);
+        }
+    }
+    if (con_state->stream_fill != NULL) {
+        // continue to generate the reply
+        err = tcp_stream_pump(con_state, pcb);
+        if (err != ERR_OK) {
+            printf("failed to write stream data %d\n", err);
+            return tcp_close_client_connection(con_state, pcb, err);
+        }
+    }
+    if ((con_state->static_len == 0) && (con_state->stream_fill == NULL) &&
+        (con_state->sent_len >= con_state->header_len + con_state->result_len)) {
+        if (con_state->keep_alive) {
+            printf("all done, wait for next request\n");
+            tcp_server_reset_state(con_state);
+            if (con_state->rx_pending != NULL) {
+                // the next request came with the previous one (pipelining): it's parsed now
+                struct pbuf *p = con_state->rx_pending;
+                con_state->rx_pending = NULL;
+                return tcp_server_recv(con_state, pcb, p, ERR_OK);
+            }
+            return ERR_OK;
+        }
+        printf("all done\n");
+        return tcp_close_client_connection(con_state, pcb, ERR_OK);
+    }
+    return ERR_OK;
+}
+
+/*
+ * Function: fill_settings_form()
+ * Description: This function generates the fragments of the settings form.
+ * It returns the length of the fragment or TCP_STREAM_END when the page is complete.
+ */
+static int fill_settings_form(TCP_CONNECT_STATE_T *con_state, char *buf, size_t max, int part)
+{
+    switch (part) {
+        case 0:
+            return fmt_format(buf, max, SETTINGS_REPLY_HEAD,
+                            (prtconfig->data.settings.options.theme == THEME_DARK) ? STYLE_FORM_DARK_URL : STYLE_FORM_LIGHT_URL);
+        case 1:
+            // copy the wifi form
+            // we show the wifi SSID used in Station mode, the password is left blank
+            // to avoid security issues, the device name is shown as well
+            return fmt_format(buf, max,
+                            SETTINGS_REPLY_FORM_WIFI,
+                            pconfig->wifi_ssid,
+                            WIFI_PASS_HIDDEN,
+                            prtconfig->net_config.devicename);
+        case 2:
+            // copy the sensor form
+            return fmt_format(buf, max,
+                            SETTINGS_REPLY_FORM_SENSOR,
+                            prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? "checked" : "",
+                            prtconfig->data.settings.options.t_format == T_FORMAT_FAHRENHEIT ? "checked" : "",
+                            prtconfig->data.settings.options.out_format == OUT_FORMAT_TXT ? "checked" : "",
+                            prtconfig->data.settings.options.out_format == OUT_FORMAT_CSV ? "checked" : "");
+        case 3:
+            // copy the footer
+            return fmt_format(buf, max, SETTINGS_REPLY_FOOTER);
+        default:
+            return TCP_STREAM_END;
+    }
+}
+
+/*
+ * Function: fill_adv_settings_form()
+ * Description: This function generates the fragments of the advanced settings form.
+ * It returns the length of the fragment or TCP_STREAM_END when the page is complete.
+ */
+static int fill_adv_settings_form(TCP_CONNECT_STATE_T *con_state, char *buf, size_t max, int part)
+{
+    switch (part) {
+        case 0:
+            return fmt_format(buf, max, ADVANCED_REPLY_HEAD);
+        case 1:
+            // copy the sensor config form
+            return fmt_format(buf, max,
+                            ADVANCED_REPLY_FORM_SENSOR,
+                            POLL_READ_TIME_MIN,
+                            POLL_READ_TIME_MAX,
+                            prtconfig->data.settings.options.poll_time);
+        case 2:
+            // copy the thresholds form
+            return fmt_format(buf, max, ADVANCED_REPLY_FORM_THRESHOLDS);
+        case 3:
+            // copy the footer
+            return fmt_format(buf, max, ADVANCED_REPLY_FOOTER);
+        default:
+            return TCP_STREAM_END;
+    }
+}
+
 /*
  * Function: fill_output_info_strings()
  * Description: This function fills the output info strings based on the output number.
@@ -321,905 +805,1153 @@ void fill_output_info_strings(int out_num, char *out_type, int size_out_type, ch
     if (out_num == 0) {
         switch(prtconfig->data.outputs[0].data_type) {
             case WLT_DATA_TYPE_TEMP:
-                snprintf(out_type, size_out_type, "Temperature");
+                fmt_format(out_type, size_out_type, "Temperature");
                 break;
             case WLT_DATA_TYPE_HUMIDITY:
-                snprintf(out_type, size_out_type, "Humidity");
+                fmt_format(out_type, size_out_type, "Humidity");
                 break;
             case WLT_DATA_TYPE_PRESSURE:
-                snprintf(out_type, size_out_type, "Pressure");
+                fmt_format(out_type, size_out_type, "Pressure");
                 break;
             default:
-                snprintf(out_type, size_out_type, "Unknown");
+                fmt_format(out_type, size_out_type, "Unknown");
                 break;
         }
-        snprintf(out_class, size_out_class, "%s", (prtconfig->outputs_rt[0].gpio_state == true) ? "led on" : "led off");
+        fmt_format(out_class, size_out_class, "%s", (prtconfig->outputs_rt[0].gpio_state == true) ? "led on" : "led off");
     } else if (out_num == 1) {
         switch(prtconfig->data.outputs[1].data_type) {
             case WLT_DATA_TYPE_TEMP:
-                snprintf(out_type, size_out_type, "Temperature");
+                fmt_format(out_type, size_out_type, "Temperature");
                 break;
             case WLT_DATA_TYPE_HUMIDITY:
-                snprintf(out_type, size_out_type, "Humidity");
+                fmt_format(out_type, size_out_type, "Humidity");
                 break;
             case WLT_DATA_TYPE_PRESSURE:
-                snprintf(out_type, size_out_type, "Pressure");
+                fmt_format(out_type, size_out_type, "Pressure");
                 break;
             default:
-                snprintf(out_type, size_out_type, "Unknown");
+                fmt_format(out_type, size_out_type, "Unknown");
                 break;
         }
-        snprintf(out_class, size_out_class, "%s", (prtconfig->outputs_rt[1].gpio_state == true) ? "led on" : "led off");
+        fmt_format(out_class, size_out_class, "%s", (prtconfig->outputs_rt[1].gpio_state == true) ? "led on" : "led off");
     }
     return;
 }
 
 /*
- * Function: fill_server_content()
- * Description: This function fills the server content based on the request and parameters.
- * It returns the length of the generated content or 0 in case of error.
+ * Function: fill_home_page()
+ * Description: This function generates the fragments of the home page with the sensor data and the outputs status.
+ * It returns the length of the fragment or TCP_STREAM_END when the page is complete.
  */
-static int fill_server_content(const char *request, const char *params, char *result, size_t max_result_len)
+static int fill_home_page(TCP_CONNECT_STATE_T *con_state, char *buf, size_t max, int part)
 {
-    int len = 0;
-    int len2copy = 0;
-    int i = 0;
-    char treshold_trigger[5]; // Buffer for threshold trigger
-#if DEBUG
-    printf("%s Request: %s?%s\n", __FUNCTION__, request, params);
-    printf("max_result_len: %zu\n", max_result_len);
-#endif
+    wlt_sample_t sample;
+
+    wlt_sample_read(&sample);
+    switch (part) {
+        case 0:
+            // copy the info head
+            return fmt_format(buf, max, HOME_REPLY_HEAD,
+                            (prtconfig->data.settings.options.theme == THEME_DARK) ? "style_dark.css" : "style_light.css");
+        case 1:
+            // copy the info body
+            if (!sample.valid) {
+                // If data is not valid, show a message
+                return fmt_format(buf, max, HOME_REPLY_BODY_NOT_VALID, prtconfig->net_config.devicename);
+            }
+            // Fill in the body with the sensor data
+            return fmt_format(buf, max, HOME_REPLY_BODY,
+                            prtconfig->net_config.devicename,
+                            (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? sample.temperature : fmt_centi_c2f(sample.temperature)),
+                            (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? "&degC" : "&degF"),
+                            sample.humidity);
+        case 2:
+            if (sample.valid) {
+                // copy the outputs status
+                char out1_type[12];
+                char out1_class[8];
+                char out2_type[12];
+                char out2_class[8];
+                fill_output_info_strings(0, out1_type, sizeof(out1_type), out1_class, sizeof(out1_class));
+                fill_output_info_strings(1, out2_type, sizeof(out2_type), out2_class, sizeof(out2_class));
+
+                return fmt_format(buf, max, HOME_REPLY_BODY_OUTS, out1_type, out1_class, out2_type, out2_class);
+            }
+            return TCP_STREAM_END;
+        default:
+            return TCP_STREAM_END;
+    }
+}
 
-    if(prtconfig == NULL) {
+/*
+ * Function: settings_save()
+ * Description: This function processes the settings form submission (parameters in the query string).
+ * It returns the reply page.
+ */
+static const char *settings_save(char *params)
+{
+    const char *reply = NULL;
+
+    if (prtconfig == NULL) {
         printf("prtconfig is NULL\n");
-        return 0; // Error
+        return NULL; // Error
     }
+
+    // This is the form submission
+    if (params) {
+        // Parse the parameters
+        char *ssid = NULL;
+        char *pwd = NULL;
+        char *scale = NULL;
+        char *oform = NULL;
+        char *devname = NULL;
+
+        // Split params by '&'
+        char *param = strtok((char *)params, "&");
+        while (param) {
+            if (strncmp(param, "ssid=", 5) == 0) {
+                ssid = param + 5; // Skip "ssid="
+            } else if (strncmp(param, "pwd=", 4) == 0) {
+                pwd = param + 4; // Skip "pwd="
+            } else if (strncmp(param, "devname=",8) == 0) {
+                devname = param + 8; // Skip "devname="
+            } else if (strncmp(param, "scale=", 6) == 0) {
+                scale = param + 6; // Skip "scale="
+            } else if (strncmp(param, "oform=", 6) == 0) {
+                oform = param + 6; // Skip "oform="
+            }
+            param = strtok(NULL, "&");
+        }
 #if DEBUG
-    else {
-        printf("prtconfig is not NULL\n");
-    }
+        printf("Parsed parameters: ssid=%s, pwd=%s, devname=%s, scale=%s, oform=%s\n", 
+               ssid ? ssid : "NULL", 
+               pwd ? pwd : "NULL", 
+               devname ? devname : "NULL", 
+               scale ? scale : "NULL", 
+               oform ? oform : "NULL");
 #endif
+        // Update the configuration
+        if (ssid && pwd && devname && scale && oform) {
+            int ret;
+            strncpy((char *)prtconfig->net_config.wifi_ssid, ssid, sizeof(prtconfig->net_config.wifi_ssid) - 1);
+            ret = check_wifi_password(pwd);
+            if (ret == WIFI_PASS_NOT_CHANGE) {
+                printf("Wi-Fi password not changed\n");
+            } else if (ret == WIFI_PASS_INVALID) {
+                printf("Invalid Wi-Fi password!\n");
+                reply = SETTINGS_SAVE_NACK_EINVAL;
+                return reply; // Error
+            } else if (ret == WIFI_PASS_VALID) {
+                printf("Wi-Fi password changed (new password=%s)\n",pwd);
+                // Copy the password, ensuring we don't overflow
+                strncpy((char *)prtconfig->net_config.wifi_pass, pwd, sizeof(prtconfig->net_config.wifi_pass) - 1);
+            }
+            // when use method GET, if the original devicename contains spaces, they are replaced with '%20' or '+' in the URL,
+            // so we need to replace there with spaces
+            fix_devname(devname,strlen(devname),prtconfig->net_config.devicename, sizeof(prtconfig->net_config.devicename));
+            //strncpy((char *)pconfig->net_config.devicename, devname, sizeof(pconfig->net_config.devicename) - 1);
+            prtconfig->data.settings.options.t_format = (strcmp(scale, "C") == 0) ? T_FORMAT_CELSIUS : T_FORMAT_FAHRENHEIT;
+            prtconfig->data.settings.options.out_format = (strcmp(oform, "TXT") == 0) ? OUT_FORMAT_TXT : OUT_FORMAT_CSV;
+
+            // Save the configuration
+            wlt_update_and_save_config(prtconfig,pconfig,true);
+            
+            // Prepare success response
+            reply = SETTINGS_SAVE_ACK;
+        } else {
+            reply = SETTINGS_SAVE_NACK_EINVAL;
+        }
+    } else {
+        reply = SETTINGS_SAVE_NACK_ENOPARAM;
+    }
+    return reply;
+}
 
-    // find which request we have
-    i = tcp_find_get_request(request);
-    if(i < HTTP_GET_REQ_MAX) {
-        // We have a page request
-        printf("Page request found: %s\n", http_get_req_str[i]);
-        switch(i) {
-            case HTTP_NONE:
-                break;
+/*
+ * Function: advanced_save()
+ * Description: This function processes the advanced settings form submission (parameters in the query string).
+ * It returns the reply page.
+ */
+static const char *advanced_save(char *params)
+{
+    const char *reply = NULL;
 
-            case HTTP_REQ_STYLE:
-                // Copy the style sheet
-                len2copy = strlen(STYLE_CSS);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for style (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, STYLE_CSS);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+    if (prtconfig == NULL) {
+        printf("prtconfig is NULL\n");
+        return NULL; // Error
+    }
 
-            case HTTP_REQ_STYLE_FORM_DARK:
-                // Copy the style sheet
-                len2copy = strlen(STYLE_FORM_DARK);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for style (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, STYLE_FORM_DARK);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+    // This is the advanced form submission
+    if(params) {
+        // Parse the parameters
+        char *ptime = NULL;
+
+        // Split params by '&'
+        char *param = strtok((char *)params, "&");
+        while (param) {
+            if (strncmp(param, "ptime=", 6) == 0) {
+                ptime = param + 6; // Skip "poll_time="
+            } 
+            param = strtok(NULL, "&");
+        }
 
-            case HTTP_REQ_STYLE_FORM_LIGHT:
-                // Copy the style sheet for settings form
-                len2copy = strlen(STYLE_FORM_LIGHT);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for style form (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, STYLE_FORM_LIGHT);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+        // Update the configuration
+        if (ptime) {
+            int poll_time_val = atoi(ptime);
 
-            case HTTP_REQ_STYLE_DARK:
-                // Copy the style sheet
-                len2copy = strlen(STYLE_CSS_DARK);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for style (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, STYLE_CSS_DARK);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+            // Validate and update settings
+            if ((poll_time_val >= POLL_READ_TIME_MIN) && (poll_time_val <= POLL_READ_TIME_MAX)) {
+                prtconfig->data.settings.options.poll_time = poll_time_val;
+            }
 
-            case HTTP_REQ_STYLE_LIGHT:
-                // Copy the style sheet
-                len2copy = strlen(STYLE_CSS_LIGHT);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for style (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, STYLE_CSS_LIGHT);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+            // Save the configuration
+            wlt_update_and_save_config(prtconfig,pconfig,true);
 
-            case HTTP_REQ_HOME:
-                // copy the info head
-                if (prtconfig->data.settings.options.theme == THEME_DARK) {
-                    len += snprintf(result + len, max_result_len - len, HOME_REPLY_HEAD, "style_dark.css");
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, HOME_REPLY_HEAD, "style_light.css");
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                else if (len >= max_result_len) {
-                    printf("Result buffer too small for info head (len=%d, max_result_len=%zu)\n", len, max_result_len);
-                    return 0; // Error
-                }
-                // copy the info body
-                if (prtconfig->data.settings.options.data_valid == SENS_DATA_NOT_VALID) {
-                    // If data is not valid, show a message
-                    len += snprintf(result + len, max_result_len - len, HOME_REPLY_BODY_NOT_VALID, prtconfig->net_config.devicename);
+            // Prepare success response
+            reply = ADVANCED_SAVE_ACK;
+        }
+        else {
+            reply = ADVANCED_SAVE_NACK_EINVAL;
+        }
+    } else {
+        reply = ADVANCED_SAVE_NACK_ENOPARAM;
+    }
+    return reply;
+}
+
+/*
+ * Function: fill_api_info()
+ * Description: This function generates the reply of the info API (JSON).
+ * It returns the length of the fragment or TCP_STREAM_END when the reply is complete.
+ */
+static int fill_api_info(TCP_CONNECT_STATE_T *con_state, char *buf, size_t max, int part)
+{
+    wlt_sample_t sample;
+
+    if (part > 0) {
+        return TCP_STREAM_END;
+    }
+    wlt_sample_read(&sample);
+    // Generate API info response: the temperature in the unit of the settings (the sample is in Celsius)
+    bool celsius = (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS);
+    return fmt_format(buf, max,
+                    API_INFO_REPLY,
+                    celsius ? sample.temperature : fmt_centi_c2f(sample.temperature),
+                    celsius ? "C" : "F",
+                    sample.humidity,
+                    (unsigned int)wlt_sample_gen);
+}
+
+/*
+ * Function: fill_api_history()
+ * Description: This function generates the reply of the history API (JSON): as many entries
+ * of the tier as fit in each fragment, from the cursor set by tcp_route_api_history().
+ * It returns the length of the fragment or TCP_STREAM_END when the reply is complete.
+ */
+static int fill_api_history(TCP_CONNECT_STATE_T *con_state, char *buf, size_t max, int part)
+{
+    tcp_history_cursor_t *cur = &con_state->history;
+    wlt_hist_agg_t agg;
+    uint32_t seq;
+    uint32_t items;
+    int len = 0;
+
+    // the previous fragment has been written: move on
+    if ((uint32_t)part != cur->part) {
+        cur->part = (uint32_t)part;
+        cur->stage = cur->next_stage;
+        cur->seq = cur->next_seq;
+        cur->items = cur->next_items;
+    }
+    switch (cur->stage) {
+        case TCP_HISTORY_HEAD:
+            cur->next_stage = TCP_HISTORY_ITEMS;
+            cur->next_seq = cur->seq;
+            cur->next_items = 0;
+            return fmt_format(buf, max, API_HISTORY_HEAD, (unsigned int)wlt_history_res(cur->tier), (unsigned int)cur->now);
+
+        case TCP_HISTORY_ITEMS:
+            // the entries overwritten while the reply is being sent are skipped
+            seq = cur->seq;
+            if (seq < wlt_history_first(cur->tier)) {
+                seq = wlt_history_first(cur->tier);
+            }
+            items = cur->items;
+            cur->next_stage = TCP_HISTORY_END;
+            while (wlt_history_get(cur->tier, seq, &agg) && (agg.ts <= cur->to)) {
+                const char *sep = (items > 0) ? "," : "";
+                int n;
+
+                if (cur->tier == WLT_HIST_TIER_RAW) {
+                    n = fmt_format(buf + len, max - len, API_HISTORY_RAW, sep, (unsigned int)agg.ts,
+                                   (int32_t)agg.t_mean, (int32_t)agg.h_mean);
                 } else {
-                    // Fill in the body with the sensor data
-                    len += snprintf(result + len, max_result_len - len, HOME_REPLY_BODY,
-                                    prtconfig->net_config.devicename,
-                                    (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? prtconfig->data.temperature : C2F(prtconfig->data.temperature)),
-                                    (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? "&degC" : "&degF"),
-                                    prtconfig->data.humidity);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
+                    n = fmt_format(buf + len, max - len, API_HISTORY_AGG, sep, (unsigned int)agg.ts, (unsigned int)agg.count,
+                                   (int32_t)agg.t_min, (int32_t)agg.t_max, (int32_t)agg.t_mean,
+                                   (int32_t)agg.h_min, (int32_t)agg.h_max, (int32_t)agg.h_mean);
                 }
-                else if (len >= max_result_len) {
-                    printf("Result buffer too small for info body (len=%d, max_result_len=%zu)\n", len, max_result_len);
-                    return 0; // Error
-                }
-                if (prtconfig->data.settings.options.data_valid == SENS_AVAILABLE) {
-                    // copy the outputs status
-                    char out1_type[12];
-                    char out1_class[8];
-                    char out2_type[12];
-                    char out2_class[8];
-                    fill_output_info_strings(0, out1_type, sizeof(out1_type), out1_class, sizeof(out1_class));
-                    fill_output_info_strings(1, out2_type, sizeof(out2_type), out2_class, sizeof(out2_class));
-
-                    len += snprintf(result + len, max_result_len - len, HOME_REPLY_BODY_OUTS, out1_type, out1_class, out2_type, out2_class);
-                    if (len < 0) {
-                        printf("Error generating info content\n");
-                        return 0; // Error
-                    }
-                    else if (len >= max_result_len) {
-                        printf("Result buffer too small for outputs status (len=%d, max_result_len=%zu)\n", len, max_result_len);
-                        return 0; // Error
+                if (n >= (int)(max - len)) {
+                    if (len == 0) {
+                        // not even one entry fits: wait for room
+                        return n;
                     }
+                    cur->next_stage = TCP_HISTORY_ITEMS;
+                    break;
                 }
+                len += n;
+                seq++;
+                items++;
+            }
+            cur->next_seq = seq;
+            cur->next_items = items;
+            return len;
+
+        case TCP_HISTORY_END:
+            cur->next_stage = TCP_HISTORY_DONE;
+            return fmt_format(buf, max, API_HISTORY_END);
+
+        default:
+            return TCP_STREAM_END;
+    }
+}
+
+/*
+ * Function: fill_api_settings()
+ * Description: This function generates the fragments of the reply of the settings API (JSON), one
+ * per group of parameters (and per output) from the schema of the configuration.
+ * It returns the length of the fragment or TCP_STREAM_END when the reply is complete.
+ */
+static int fill_api_settings(TCP_CONNECT_STATE_T *con_state, char *buf, size_t max, int part)
+{
+    int n = wlt_schema_render(buf, max, part, prtconfig);
+
+    return (n == WLT_SCHEMA_RENDER_END) ? TCP_STREAM_END : n;
+}
+
+/*
+ * Function: tcp_route_params()
+ * Description: This function returns the query string of the request, NULL if there are no parameters.
+ */
+static char *tcp_route_params(TCP_CONNECT_STATE_T *con_state)
+{
+    return (con_state->req.query[0] != '\0') ? con_state->req.query : NULL;
+}
+
+/*
+ * Function: tcp_server_send_page()
+ * Description: This function starts the reply of a page (or JSON document) generated by fragments
+ * from the configuration: it sends 500 if the configuration is not available.
+ * It returns an error code.
+ */
+static err_t tcp_server_send_page(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, tcp_stream_fill_t fill, const char *content_type)
+{
+    if ((prtconfig == NULL) || (pconfig == NULL)) {
+        printf("configuration is NULL\n");
+        // send 500 Internal Server Error
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_INTERNAL_ERROR, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    return tcp_server_send_stream(con_state, pcb, fill, content_type);
+}
+
+/*
+ * Function: tcp_render_get()
+ * Description: This function returns the page rendered for the current sample generation, theme
+ * and temperature format, rendering it (once) if the cached copy is missing or stale.
+ * A stale copy still being sent to some client is kept, the page is rendered in another entry.
+ * It returns NULL if the page can't be cached (no free entry or page too long).
+ */
+static tcp_render_entry_t *tcp_render_get(TCP_CONNECT_STATE_T *con_state, tcp_stream_fill_t fill, const char *content_type)
+{
+    uint8_t theme = prtconfig->data.settings.options.theme;
+    uint8_t t_format = prtconfig->data.settings.options.t_format;
+    tcp_render_entry_t *entry = NULL;
+    int best = -1;
+    int len = 0;
+
+    for (int i = 0; i < HTTP_RENDER_CACHE_ENTRIES; i++) {
+        tcp_render_entry_t *e = &tcp_render_cache[i];
+        if ((e->fill == fill) && (e->gen == wlt_sample_gen) && (e->theme == theme) && (e->t_format == t_format)) {
+            return e;
+        }
+        // reuse the stale copy of the same page, or an empty entry, or any entry not in use
+        if (e->refs == 0) {
+            int rank = (e->fill == fill) ? 2 : ((e->fill == NULL) ? 1 : 0);
+            if (rank > best) {
+                best = rank;
+                entry = e;
+            }
+        }
+    }
+    if (entry == NULL) {
+        printf("render cache full\n");
+        return NULL;
+    }
+
+    entry->fill = NULL;
+    for (int part = 0; ; part++) {
+        int n = fill(con_state, entry->body + len, sizeof(entry->body) - len, part);
+        if (n == TCP_STREAM_END) {
             break;
+        }
+        if ((n < 0) || (n >= (int)sizeof(entry->body) - len)) {
+            printf("page too long for the render cache\n");
+            return NULL;
+        }
+        len += n;
+    }
+    entry->len = len;
+    entry->hdr_len = fmt_format(entry->hdr, sizeof(entry->hdr), HTTP_RESPONSE_HEADERS_CACHED, len, content_type);
+    entry->fill = fill;
+    entry->gen = wlt_sample_gen;
+    entry->theme = theme;
+    entry->t_format = t_format;
+    printf("page rendered (generation %u, %d bytes)\n", (unsigned int)entry->gen, len);
+    return entry;
+}
 
-            case HTTP_REQ_FAVICON:
-                // Copy the favicon icon
-                len2copy = favicon_ico_len;
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for favicon (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    memcpy(result, favicon_ico, len2copy);
-                    len = len2copy; // Set the length to the length of the favicon
-                }
-                if (len < 0) {
-                    printf("Error generating favicon content\n");
-                    return 0; // Error
-                }
-                break;
+/*
+ * Function: tcp_server_send_cached_page()
+ * Description: This function sends a page that depends only on the last sample and on the configuration:
+ * the page is rendered once per sample generation and sent from the cache (without copy) with its
+ * Content-Length. If it can't be cached, it's generated for this request as any other page.
+ * It returns an error code.
+ */
+static err_t tcp_server_send_cached_page(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, tcp_stream_fill_t fill, const char *content_type)
+{
+    tcp_render_entry_t *entry;
+    const char *conn;
+    int conn_len;
+    err_t err;
 
-            case HTTP_REQ_SETTINGS:
+    if ((prtconfig == NULL) || (pconfig == NULL)) {
+        return tcp_server_send_page(con_state, pcb, fill, content_type);
+    }
+    entry = tcp_render_get(con_state, fill, content_type);
+    if (entry == NULL) {
+        return tcp_server_send_page(con_state, pcb, fill, content_type);
+    }
+
+    // the entry can't be rendered again until the body has been acknowledged
+    entry->refs++;
+    con_state->render = entry;
+    con_state->static_data = (const uint8_t *)entry->body;
+    con_state->static_len = entry->len;
+    con_state->result_len = entry->len;
+    conn = tcp_conn_hdr(con_state);
+    conn_len = strlen(conn);
+    memcpy(con_state->headers, entry->hdr, entry->hdr_len);
+    memcpy(con_state->headers + entry->hdr_len, conn, conn_len);
+    memcpy(con_state->headers + entry->hdr_len + conn_len, "\r\n\r\n", 4);
+    con_state->header_len = entry->hdr_len + conn_len + 4;
+
+    con_state->sent_len = 0;
+    err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
+    if (err == ERR_OK) {
+        err = tcp_server_write_static(con_state, pcb);
+    }
+    if (err != ERR_OK) {
+        printf("failed to write cached page %d\n", err);
+        return tcp_close_client_connection(con_state, pcb, err);
+    }
+    return ERR_OK;
+}
+
+/*
+ * Route handlers (see web/routes.txt): they are called by the router with the matched route.
+ */
+err_t tcp_route_redirect(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    printf("No Request, redirect to home page\n");
+    // send 302 Redirect
+    con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_REDIRECT, ipaddr_ntoa(con_state->gw), tcp_conn_hdr(con_state));
+    return tcp_server_send_reply(con_state, pcb);
+}
+
+err_t tcp_route_asset(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    return tcp_server_send_static(con_state, pcb, route->asset);
+}
+
+err_t tcp_route_home(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    return tcp_server_send_cached_page(con_state, pcb, fill_home_page, HTTP_CONTENT_TYPE_HTML);
+}
+
+err_t tcp_route_settings(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
 #if 1 //DEBUG
-                // copy the settings form (fill in different step to check the buffer size)
-                len = build_req_settings_form(result, max_result_len);
+    return tcp_server_send_page(con_state, pcb, fill_settings_form, HTTP_CONTENT_TYPE_HTML);
 #else
-                // this page is available only when in AP mode
-                if (prtconfig->net_config.wifi_mode != WLT_WIFI_MODE_AP) {
-                    printf("Settings page not available in STA mode\n");
-                    len2copy = strlen(SETTINGS_REPLY_NACK);
-                    if (len2copy >= max_result_len) {
-                        printf("Result buffer too small (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                        return 0; // Error
-                    }
-                    else {
-                        len += snprintf(result + len, max_result_len - len, SETTINGS_REPLY_NACK);
-                    }
-                }
-                else {
-                    printf("Settings page requested in AP mode\n");
-                    len = build_req_settings_form(result, max_result_len);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
+    // this page is available only when in AP mode
+    if ((prtconfig != NULL) && (prtconfig->net_config.wifi_mode != WLT_WIFI_MODE_AP)) {
+        printf("Settings page not available in STA mode\n");
+        return tcp_server_send_const(con_state, pcb, SETTINGS_REPLY_NACK, false);
+    }
+    printf("Settings page requested in AP mode\n");
+    return tcp_server_send_page(con_state, pcb, fill_settings_form, HTTP_CONTENT_TYPE_HTML);
 #endif
-                break;
+}
 
-            case HTTP_REQ_SETTINGS_FORM:
-                // This is the form submission
-                if (params) {
-                    // Parse the parameters
-                    char *ssid = NULL;
-                    char *pwd = NULL;
-                    char *scale = NULL;
-                    char *oform = NULL;
-                    char *devname = NULL;
-
-                    // Split params by '&'
-                    char *param = strtok((char *)params, "&");
-                    while (param) {
-                        if (strncmp(param, "ssid=", 5) == 0) {
-                            ssid = param + 5; // Skip "ssid="
-                        } else if (strncmp(param, "pwd=", 4) == 0) {
-                            pwd = param + 4; // Skip "pwd="
-                        } else if (strncmp(param, "devname=",8) == 0) {
-                            devname = param + 8; // Skip "devname="
-                        } else if (strncmp(param, "scale=", 6) == 0) {
-                            scale = param + 6; // Skip "scale="
-                        } else if (strncmp(param, "oform=", 6) == 0) {
-                            oform = param + 6; // Skip "oform="
-                        }
-                        param = strtok(NULL, "&");
-                    }
-#if DEBUG
-                    printf("Parsed parameters: ssid=%s, pwd=%s, devname=%s, scale=%s, oform=%s\n", 
-                           ssid ? ssid : "NULL", 
-                           pwd ? pwd : "NULL", 
-                           devname ? devname : "NULL", 
-                           scale ? scale : "NULL", 
-                           oform ? oform : "NULL");
-#endif
-                    // Update the configuration
-                    if (ssid && pwd && devname && scale && oform) {
-                        int ret;
-                        strncpy((char *)prtconfig->net_config.wifi_ssid, ssid, sizeof(prtconfig->net_config.wifi_ssid) - 1);
-                        ret = check_wifi_password(pwd);
-                        if (ret == WIFI_PASS_NOT_CHANGE) {
-                            printf("Wi-Fi password not changed\n");
-                        } else if (ret == WIFI_PASS_INVALID) {
-                            printf("Invalid Wi-Fi password!\n");
-                            len = snprintf(result, max_result_len, SETTINGS_SAVE_NACK_EINVAL);
-                            return len; // Error
-                        } else if (ret == WIFI_PASS_VALID) {
-                            printf("Wi-Fi password changed (new password=%s)\n",pwd);
-                            // Copy the password, ensuring we don't overflow
-                            strncpy((char *)prtconfig->net_config.wifi_pass, pwd, sizeof(prtconfig->net_config.wifi_pass) - 1);
-                        }
-                        // when use method GET, if the original devicename contains spaces, they are replaced with '%20' or '+' in the URL,
-                        // so we need to replace there with spaces
-                        fix_devname(devname,strlen(devname),prtconfig->net_config.devicename, sizeof(prtconfig->net_config.devicename));
-                        //strncpy((char *)pconfig->net_config.devicename, devname, sizeof(pconfig->net_config.devicename) - 1);
-                        prtconfig->data.settings.options.t_format = (strcmp(scale, "C") == 0) ? T_FORMAT_CELSIUS : T_FORMAT_FAHRENHEIT;
-                        prtconfig->data.settings.options.out_format = (strcmp(oform, "TXT") == 0) ? OUT_FORMAT_TXT : OUT_FORMAT_CSV;
-
-                        // Save the configuration
-                        wlt_update_and_save_config(prtconfig,pconfig);
-                        
-                        // Prepare success response
-                        len = snprintf(result, max_result_len, SETTINGS_SAVE_ACK);
-                    } else {
-                        len = snprintf(result, max_result_len, SETTINGS_SAVE_NACK_EINVAL);
-                    }
-                } else {
-                    len = snprintf(result, max_result_len, SETTINGS_SAVE_NACK_ENOPARAM);
-                }
-                if (len >= max_result_len) {
-                    printf("Result buffer too small for settings form response (len=%d, max_result_len=%zu)\n", len, max_result_len);
-                } 
-            break;
+err_t tcp_route_settings_save(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    const char *reply = settings_save(tcp_route_params(con_state));
 
-            case HTTP_REQ_ADVANCED:
-                // copy the advanced settings form (fill in different step to check the buffer size)
-                len = build_req_adv_settings_form(result, max_result_len);
-                break;
-            
-            case HTTP_REQ_ADVANCED_FORM:
-                // This is the advanced form submission
-                if(params) {
-                    // Parse the parameters
-                    char *ptime = NULL;
-
-                    // Split params by '&'
-                    char *param = strtok((char *)params, "&");
-                    while (param) {
-                        if (strncmp(param, "ptime=", 6) == 0) {
-                            ptime = param + 6; // Skip "poll_time="
-                        } 
-                        param = strtok(NULL, "&");
-                    }
+    if (reply == NULL) {
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_INTERNAL_ERROR, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    return tcp_server_send_const(con_state, pcb, reply, false);
+}
 
-                    // Update the configuration
-                    if (ptime) {
-                        int poll_time_val = atoi(ptime);
- 
-                        // Validate and update settings
-                        if ((poll_time_val >= POLL_READ_TIME_MIN) && (poll_time_val <= POLL_READ_TIME_MAX)) {
-                            prtconfig->data.settings.options.poll_time = poll_time_val;
-                        }
+err_t tcp_route_advanced(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    return tcp_server_send_page(con_state, pcb, fill_adv_settings_form, HTTP_CONTENT_TYPE_HTML);
+}
 
-                        // Save the configuration
-                        wlt_update_and_save_config(prtconfig,pconfig);
+err_t tcp_route_advanced_save(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    const char *reply = advanced_save(tcp_route_params(con_state));
 
-                        // Prepare success response
-                        len = snprintf(result, max_result_len, ADVANCED_SAVE_ACK);
-                    }
-                    else {
-                        len = snprintf(result, max_result_len, ADVANCED_SAVE_NACK_EINVAL);
-                    }
-                } else {
-                    len = snprintf(result, max_result_len, ADVANCED_SAVE_NACK_ENOPARAM);
-                }
-                if (len >= max_result_len) {
-                    printf("Result buffer too small for advanced form response (len=%d, max_result_len=%zu)\n", len, max_result_len);
-                }   
-                break;
+    if (reply == NULL) {
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_INTERNAL_ERROR, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    return tcp_server_send_const(con_state, pcb, reply, false);
+}
 
-            case HTTP_REQ_SET_HIGH_TEMP:
-            case HTTP_REQ_SET_HIGH_TEMP_FORM:
-            case HTTP_REQ_SET_LOW_TEMP:
-            case HTTP_REQ_SET_LOW_TEMP_FORM:
-            case HTTP_REQ_SET_HIGH_HUM:
-            case HTTP_REQ_SET_HIGH_HUM_FORM:
-            case HTTP_REQ_SET_LOW_HUM:
-            case HTTP_REQ_SET_LOW_HUM_FORM:
-                len2copy = strlen(REPLY_NOT_YET_IMPLEMENTED);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for info head (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                else {
-                    len += snprintf(result + len, max_result_len - len, REPLY_NOT_YET_IMPLEMENTED);
-                }
-                if (len < 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+err_t tcp_route_not_implemented(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    return tcp_server_send_const(con_state, pcb, REPLY_NOT_YET_IMPLEMENTED, false);
+}
 
-            case HTTP_API_INFO:
-                // Generate API info response
-                len2copy = snprintf(result,
-                                    max_result_len,
-                                    API_INFO_REPLY,
-                                    prtconfig->data.temperature,
-                                    prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS ? "C" : "F",
-                                    prtconfig->data.humidity);
-                if (len2copy >= max_result_len) {
-                    printf("Result buffer too small for API info (len2copy=%d, max_result_len=%zu)\n", len2copy, max_result_len);
-                    return 0; // Error
-                }
-                len = len2copy;
-                break;
+/*
+ * Function: tcp_route_api_info()
+ * Description: This function sends the last sample. With the "since" parameter (the generation "G"
+ * of the last reply) the request waits until a newer sample exists, up to HTTP_LONGPOLL_TIMEOUT_S:
+ * the connection is parked and completed by tcp_server_wake() or by the poll timeout.
+ * It returns an error code.
+ */
+err_t tcp_route_api_info(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    char *params = tcp_route_params(con_state);
+    char *since = NULL;
+
+    if ((params != NULL) && (prtconfig != NULL)) {
+        // Split params by '&'
+        char *param = strtok(params, "&");
+        while (param) {
+            if (strncmp(param, "since=", 6) == 0) {
+                since = param + 6; // Skip "since="
+            }
+            param = strtok(NULL, "&");
+        }
+    }
+    // if all the slots for the pushed data are in use the client gets the data now (plain polling)
+    if ((since != NULL) && ((uint32_t)strtoul(since, NULL, 10) == wlt_sample_gen) &&
+        (tcp_push_clients() < HTTP_PUSH_MAX_CLIENTS)) {
+        printf("Request parked until generation %u\n", (unsigned int)wlt_sample_gen + 1);
+        con_state->parked = true;
+        con_state->park_polls = 0;
+        return ERR_OK;
+    }
+    return tcp_server_send_cached_page(con_state, pcb, fill_api_info, HTTP_CONTENT_TYPE_JSON);
+}
 
-            case HTTP_API_GET_SETTINGS:
-                // Generate API settings response
-                /*
-                    {
-                    "WIFI":{
-                        "DEVNAME":"studio",
-                        "SSID":"FASTWEB",
-                        "MODE":"AP",
-                        "IPADDR":"192.168.1.63",
-                        "NET":"255.255.255.0",
-                        "GW":"192.168.1.1"
-                    },
-                    "SETTINGS":{
-                        "TF":"C",
-                        "OF":"CSV",
-                        "PT":30,
-                        "TH":3,
-                        "WT":"DARK"
-                    },
-                    "OUTS": [
-                        {
-                            "GPIO": 6,
-                            "DT":"T",
-                            "TH":25.5,
-                            "TR":"H"
-                        },
-                        {
-                            "GPIO": 7,
-                            "DT":"H",
-                            "TH":55.0,
-                            "TR":"H"
-                        }
-                    ]
-                    }                   
-                */
-                if (prtconfig == NULL) {
-                    printf("prtconfig is NULL\n");
-                    return 0; // Error
-                }
-                // Start building the JSON response
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "{\"WIFI\":{\"DEVNAME\":\"%s\",\"SSID\":\"%s\",\"MODE\":\"%s\",",
-                                prtconfig->net_config.devicename,
-                                prtconfig->net_config.wifi_ssid,
-                                (prtconfig->net_config.wifi_mode == WLT_WIFI_MODE_AP) ? "AP" : "STA");
-                if ((len < 0) || (max_result_len - len) <= 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                // Add IP address, netmask, and gateway
-#if 1
-                // I believe that I found a bug in snprintf() or in ipaddr_ntoa(),
-                // if I pass all two or three parameters, the sprintf use only the last one
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "\"IPADDR\":\"%s\",",
-                                ipaddr_ntoa((ip4_addr_t *)&(prtconfig->net_config.ipaddr)));
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "\"NET\":\"%s\",",
-                                ipaddr_ntoa((ip4_addr_t *)&(prtconfig->net_config.ipmask)));
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "\"GW\":\"%s\"},",
-                                ipaddr_ntoa((ip4_addr_t *)&(prtconfig->net_config.gwaddr)));
-#else
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "\"IPADDR\":\"%s\",\"NET\":\"%s\",\"GW\":\"%s\"},",
-                                ipaddr_ntoa((ip4_addr_t *)&(prtconfig->net_config.ipaddr)),
-                                ipaddr_ntoa((ip4_addr_t *)&(prtconfig->net_config.ipmask)),
-                                ipaddr_ntoa((ip4_addr_t *)&(prtconfig->net_config.gwaddr)));
-#endif
-                if ((len < 0) || (max_result_len - len) <= 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                // Add parameters
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "\"SETTINGS\":{\"TF\":\"%s\",\"OF\":\"%s\",\"PT\":%d,\"TH\":%d,\"WT\":\"%s\"},",
-                                (prtconfig->data.settings.options.t_format == T_FORMAT_CELSIUS) ? "C" : "F",
-                                (prtconfig->data.settings.options.out_format == OUT_FORMAT_TXT) ? "TXT" : "CSV",
-                                prtconfig->data.settings.options.poll_time,
-                                prtconfig->data.settings.options.trd_hyst,
-                                (prtconfig->data.settings.options.theme == THEME_DARK) ? "DARK" : "LIGHT");
-                if ((len < 0) || (max_result_len - len) <= 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                // Add outputs
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "\"OUTS\":[");
-                if((len < 0) || (max_result_len - len) <= 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                for(int i = 0; i < OUTPUT_GPIO_MAX; i++) {
-                    char *dt_str = NULL;
-                    switch(prtconfig->data.outputs[i].data_type) {
-                        case WLT_DATA_TYPE_TEMP:
-                            dt_str = "T";
-                            break;
-                        case WLT_DATA_TYPE_HUMIDITY:
-                            dt_str = "H";
-                            break;
-                        case WLT_DATA_TYPE_PRESSURE:
-                            dt_str = "P";
-                            break;
-                        case WLT_DATA_TYPE_NULL:
-                        default:
-                            dt_str = "UNK";
-                            break;
-                    }
-                    len += snprintf(result + len,
-                                    max_result_len - len,
-                                    "{\"GPIO\":%d,\"DT\":\"%s\",\"TH\":%.02f,\"TR\":\"%s\"}%s",
-                                    prtconfig->data.outputs[i].gpio_num,
-                                    dt_str,
-                                    prtconfig->data.outputs[i].threshold,
-                                    (prtconfig->data.outputs[i].trigger == TRD_TRIGGER_HIGH) ? "H" :
-                                    (prtconfig->data.outputs[i].trigger == TRD_TRIGGER_LOW) ? "L" : "NONE",
-                                    (i < OUTPUT_GPIO_MAX - 1) ? "," : "");
-                    if ((len < 0) || (max_result_len - len) <= 0) {
-                        printf("Error generating info content\n");
-                        return 0; // Error
-                    }
-                }
-                len += snprintf(result + len,
-                                max_result_len - len,
-                                "]}");
-                if ((len < 0) || (max_result_len - len) <= 0) {
-                    printf("Error generating info content\n");
-                    return 0; // Error
-                }
-                break;
+/*
+ * Function: tcp_longpoll_complete()
+ * Description: This function sends the reply of a parked /api/v1/info request.
+ * It returns an error code.
+ */
+static err_t tcp_longpoll_complete(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb)
+{
+    err_t err;
 
-            default:
-                printf("Unknown request type %d\n", i);
-                // return empty result
-                len = 0;
-                result[0] = '\0'; // No content for other requests
+    con_state->parked = false;
+    err = tcp_server_send_cached_page(con_state, pcb, fill_api_info, HTTP_CONTENT_TYPE_JSON);
+    if (err != ERR_OK) {
+        // the connection has been closed
+        return err;
+    }
+    // we can be out of a lwIP callback: send now
+    return tcp_output(pcb);
+}
+
+/*
+ * Function: tcp_server_wake()
+ * Description: This function completes the /api/v1/info requests waiting for a new sample.
+ * It's called from the main loop after the sensor has been read.
+ */
+void tcp_server_wake(void)
+{
+    for (int i = 0; i < WLT_HTTP_MAX_CONN; i++) {
+        TCP_CONNECT_STATE_T *con_state = &tcp_conn_slots[i];
+        if ((con_state->pcb != NULL) && con_state->parked) {
+            tcp_longpoll_complete(con_state, con_state->pcb);
         }
-    } else {
-        // Check API (POST) requests
-        i = tcp_find_post_request(request);
-        if (i < HTTP_POST_REQ_MAX) {
-            // We have an API request
-            switch(i) {
-                case HTTP_API_SET_ALL_PARAMS:
-                case HTTP_API_SET_WIFI_PARAMS:
-                case HTTP_API_SET_SETTING_PARAMS:
-                case HTTP_API_SET_OUT_PARAMS:
-                    len = snprintf(result, max_result_len, "{\"status\":\"ok\"}");
-                    if (len >= max_result_len) {
-                        printf("Result buffer too small for API set params (len=%d, max_result_len=%zu)\n", len, max_result_len);
-                        return 0; // Error
-                    }
-                    break;
+    }
+}
+
+err_t tcp_route_api_settings(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    return tcp_server_send_page(con_state, pcb, fill_api_settings, HTTP_CONTENT_TYPE_JSON);
+}
 
-                default:
-                    printf("Unknown API request type %d\n", i);
-                    len = 0; // No content for other requests
-                    result[0] = '\0'; // No content for other requests
+/*
+ * Function: tcp_route_api_history()
+ * Description: This function sends the history of the readings: /api/v1/history?from=&to=&res=
+ * (from and to in seconds since boot, res in seconds: 0 raw samples, 60 or 900 aggregates).
+ * Without res the finest tier still covering "from" is used.
+ * It returns an error code.
+ */
+err_t tcp_route_api_history(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    char *params = tcp_route_params(con_state);
+    tcp_history_cursor_t *cur = &con_state->history;
+    uint32_t now = wlt_history_time(time_us_64() / 1000);
+    uint32_t from = 0;
+    uint32_t to = now;
+    int tier = -1;
+    bool valid = true;
+
+    if (params != NULL) {
+        // Split params by '&'
+        char *param = strtok(params, "&");
+        while (param && valid) {
+            char *value = strchr(param, '=');
+            char *end = NULL;
+            unsigned long n = 0;
+
+            if (value != NULL) {
+                n = strtoul(value + 1, &end, 10);
+                valid = (end != value + 1) && (*end == '\0');
             }
-        } else {
-            // No matching request found
-            printf("No matching request found\n");
-            len = 0; // No content for unknown requests
+            if (strncmp(param, "from=", 5) == 0) {
+                from = (uint32_t)n;
+            } else if (strncmp(param, "to=", 3) == 0) {
+                to = (uint32_t)n;
+            } else if (strncmp(param, "res=", 4) == 0) {
+                tier = wlt_history_tier((uint32_t)n);
+                valid = valid && (tier >= 0);
+            }
+            param = strtok(NULL, "&");
         }
     }
+    if (!valid) {
+        printf("Invalid history request\n");
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_BAD_REQUEST, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    if (tier < 0) {
+        tier = wlt_history_select(from);
+    }
+    memset(cur, 0, sizeof(tcp_history_cursor_t));
+    cur->tier = (uint8_t)tier;
+    cur->stage = cur->next_stage = TCP_HISTORY_HEAD;
+    cur->seq = cur->next_seq = wlt_history_find(tier, from);
+    cur->to = to;
+    cur->now = now;
+    return tcp_server_send_page(con_state, pcb, fill_api_history, HTTP_CONTENT_TYPE_JSON);
+}
 
-#if DEBUG
-    printf("Generated content length: %d\n", len);
-    printf("Content: %s\n", result);
-#endif
+/*
+ * Function: tcp_route_api_stream()
+ * Description: This function subscribes the connection to the event stream ("text/event-stream"):
+ * the connection stays open and tcp_server_notify() pushes the new data.
+ * The first event carries the current data.
+ * It returns an error code.
+ */
+err_t tcp_route_api_stream(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    char buf[SSE_EVENT_MAX_LEN];
+    err_t err;
 
-    return len;
+    con_state->keep_alive = false;
+    if ((tcp_push_clients() >= HTTP_PUSH_MAX_CLIENTS) || (prtconfig == NULL)) {
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_UNAVAILABLE);
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_SSE);
+    err = tcp_server_send_reply(con_state, pcb);
+    if (err != ERR_OK) {
+        return err;
+    }
+    con_state->sse = true;
+    err = tcp_push_write(con_state, NULL, 0, buf, tcp_sse_format(TCP_SSE_SAMPLE, buf, sizeof(buf)));
+    if (err != ERR_OK) {
+        return tcp_close_client_connection(con_state, pcb, err);
+    }
+    return ERR_OK;
 }
 
 /*
- * Function: tcp_server_recv()
- * Description: This function is called when data is received from the client.
- * It processes the received data and sends a response back to the client.
+ * Function: tcp_route_api_ws()
+ * Description: This function upgrades the connection to WebSocket (RFC 6455 handshake).
+ * After the upgrade the readings and the state of the outputs are pushed in binary frames
+ * (see tcp_server_notify()) and the client can send the same JSON of /api/v1/setallparams
+ * in text frames: each one is answered with a text frame.
+ * The first frame carries the current data.
  * It returns an error code.
  */
-err_t tcp_server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) 
+err_t tcp_route_api_ws(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
 {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    if (!p) {
-        printf("connection closed\n");
-        return tcp_close_client_connection(con_state, pcb, ERR_OK);
+    char accept[WS_ACCEPT_LEN + 1];
+    uint8_t buf[WS_EVENT_MAX_LEN];
+    err_t err;
+
+    if (!con_state->req.upgrade_websocket || !con_state->req.conn_upgrade ||
+        !ws_accept_key(con_state->req.ws_key, accept, sizeof(accept))) {
+        printf("Invalid WebSocket handshake\n");
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_BAD_REQUEST, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
     }
-    assert(con_state && con_state->pcb == pcb);
-    if (p->tot_len > 0) {
-        printf("tcp_server_recv %d err %d\n", p->tot_len, err);
-#if 0
-        for (struct pbuf *q = p; q != NULL; q = q->next) {
-            DEBUG_printf("in: %.*s\n", q->len, q->payload);
-        }
-#endif
-        // Copy the request into the buffer
-        pbuf_copy_partial(p, con_state->headers, p->tot_len > sizeof(con_state->headers) - 1 ? sizeof(con_state->headers) - 1 : p->tot_len, 0);
-
-        // Handle GET request
-        if (strncmp(HTTP_GET, con_state->headers, sizeof(HTTP_GET) - 1) == 0) {
-            int http_req_index = -1;
-            char *request = con_state->headers + sizeof(HTTP_GET); // + space
-            char *params = strchr(request, '?');
-            if (params) {
-                if (*params) {
-                    char *space = strchr(request, ' ');
-                    *params++ = 0;
-                    if (space) {
-                        *space = 0;
-                    }
-                } else {
-                    params = NULL;
-                }
-            }
+    if (con_state->req.ws_version != 13) {
+        printf("Unsupported WebSocket version %d\n", con_state->req.ws_version);
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_WS_VERSION, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    con_state->keep_alive = false;
+    if ((tcp_push_clients() >= HTTP_PUSH_MAX_CLIENTS) || (prtconfig == NULL) || (pconfig == NULL)) {
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_UNAVAILABLE);
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_WS_UPGRADE, accept);
+    err = tcp_server_send_reply(con_state, pcb);
+    if (err != ERR_OK) {
+        return err;
+    }
+    // from now on the connection receives frames (the request is no longer needed)
+    con_state->ws = true;
+    ws_parser_init(&con_state->ws_rx);
+    err = tcp_ws_send(con_state, WS_OPCODE_BINARY, buf, tcp_ws_format(TCP_SSE_SAMPLE, buf));
+    if (err != ERR_OK) {
+        return tcp_close_client_connection(con_state, pcb, err);
+    }
+    return ERR_OK;
+}
 
-            printf("Received request: %s\n", request);
+/*
+ * Function: tcp_server_post_body()
+ * Description: This function returns the body of a POST request (already stored by the parser),
+ * NULL if the request has no body.
+ */
+static char *tcp_server_post_body(TCP_CONNECT_STATE_T *con_state)
+{
+    if (con_state->req.content_length == 0) {
+        printf("No Content-Length header found in POST request\n");
+        return NULL;
+    }
+    printf("Content-Length: %d\n", con_state->req.content_length);
+    printf("Body: %.*s\n", con_state->req.content_length, con_state->req.body);
+    return con_state->req.body;
+}
 
-            http_req_index = tcp_find_get_request(request);
-            if (http_req_index == 0) {
-                // FIXME: provare 
-                printf("No Request, redirect to home page\n");
-                // send 302 Redirect
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_REDIRECT, ipaddr_ntoa(con_state->gw));
-                err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write unsupported request data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
-                pbuf_free(p);
-                return ERR_OK;
-            } else if (http_req_index < HTTP_GET_REQ_MAX) {
-                printf("Request matches page: %s\n", http_get_req_str[http_req_index]);
-            } else {
-                printf("Unsupported HTTP request: %s (http_req_index: %d)\n", request, http_req_index);
-                // send 404 Not Found
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_NOT_FOUND);
-                err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write unsupported request data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
-                pbuf_free(p);
-                return ERR_OK;
+/*
+ * Function: tcp_server_persist()
+ * Description: This function tells if the configuration changed by a POST API request must be saved:
+ * with ?persist=false it's only applied (transient tuning).
+ */
+static bool tcp_server_persist(TCP_CONNECT_STATE_T *con_state)
+{
+    char *params = tcp_route_params(con_state);
+    bool persist = true;
+
+    if (params != NULL) {
+        // Split params by '&'
+        char *param = strtok(params, "&");
+        while (param) {
+            if (strncmp(param, "persist=", 8) == 0) {
+                persist = (strcmp(param + 8, "false") != 0);
             }
+            param = strtok(NULL, "&");
+        }
+    }
+    return persist;
+}
 
-            // Generate content
-            memset(con_state->result, 0, sizeof(con_state->result));
-            con_state->result_len = fill_server_content(request, params, con_state->result, sizeof(con_state->result));
+/*
+ * Function: tcp_server_saved_reply()
+ * Description: This function returns the reply of a configuration change from the result of the save.
+ */
+static const char *tcp_server_saved_reply(int ret)
+{
+    switch (ret) {
+        case EE_PENDING:
+            return API_SET_PARAMS_ACK_PENDING;
+        case WLT_CONFIG_DEFERRED:
+            return API_SET_PARAMS_ACK_DEFERRED;
+        case WLT_CONFIG_TRANSIENT:
+            return API_SET_PARAMS_ACK_TRANSIENT;
+        default:
+            return API_SET_PARAMS_ACK;
+    }
+}
 
-            // Check we had enough buffer space
-            if (con_state->result_len > sizeof(con_state->result) - 1) {
-                printf("Too much result data %d\n", con_state->result_len);
-                // send 500 Internal Server Error
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_INTERNAL_ERROR);
-                err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write unsupported request data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
-            }
+/*
+ * Function: tcp_server_post_reply()
+ * Description: This function applies (and saves, unless ?persist=false) the configuration and sends
+ * the reply of a POST API request.
+ * It returns an error code.
+ */
+static err_t tcp_server_post_reply(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, wlt_error_t parse_result)
+{
+    if (parse_result == WLT_SUCCESS) {
+        // Save the configuration: it's written at the end of the quiet period
+        int ret = wlt_update_and_save_config(prtconfig, pconfig, tcp_server_persist(con_state));
 
-            // Generate web page
-            if (con_state->result_len > 0) {
-                if(strstr(request,".css") != NULL) {
-                    // If the request is for a CSS file, set content type to text/css
-                    con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS, 200, con_state->result_len, "css");
-                } else {
-                    if(strstr(request, ".ico") != NULL) {
-                        // If the request is for a favicon.ico file, set content type to image/x-icon
-                        con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_IMAGE, 200, con_state->result_len, "x-icon");
-                    }
-                    else if(strstr(request, "/api/") != NULL) {
-                        // If the request is an API set content type to application/json
-                        con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_JSON, 200, con_state->result_len,"json");
-                    }
-                    else
-                        // Otherwise, set content type to text/html
-                        con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS, 200, con_state->result_len, "html");
-                }
-                if (con_state->header_len > sizeof(con_state->headers) - 1) {
-                    printf("Too much header data %d\n", con_state->header_len);
-                    // send 500 Internal Server Error
-                    con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_INTERNAL_ERROR);
-                    err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-                    if (err != ERR_OK) {
-                        printf("failed to write unsupported request data %d\n", err);
-                        pbuf_free(p);
-                        return tcp_close_client_connection(con_state, pcb, err);
-                    }
-                }
-            } else {
-                // Send 404 Not Found
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_NOT_FOUND);
-                printf("Sending 404 %s", con_state->headers);
-                err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write unsupported request data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
-            }
+        // send 200 OK
+        return tcp_server_send_const(con_state, pcb, tcp_server_saved_reply(ret), true);
+    }
+    // send 400 Bad Request
+    con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_BAD_REQUEST, tcp_conn_hdr(con_state));
+    return tcp_server_send_reply(con_state, pcb);
+}
 
-            // Send the headers to the client
-            con_state->sent_len = 0;
-            err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-            if (err != ERR_OK) {
-                printf("failed to write header data %d\n", err);
-                pbuf_free(p);
-                return tcp_close_client_connection(con_state, pcb, err);
-            }
+err_t tcp_route_api_set_all_params(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    // in this case we need to parse all parameters that are in the body
+    char *body = tcp_server_post_body(con_state);
+    return tcp_server_post_reply(con_state, pcb, body ? parse_post_body(body, con_state->req.content_length) : WLT_GENERIC_ERROR);
+}
 
-            // Send the body to the client
-            if (con_state->result_len) {
-                err = tcp_write(pcb, con_state->result, con_state->result_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write result data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
-            }
-        }
-        else if (strncmp(HTTP_POST, con_state->headers, sizeof(HTTP_POST) - 1) == 0) {
-            // Handle POST request
-            char *request = con_state->headers + sizeof(HTTP_POST); // + space
-            char *params = NULL;
-            char parse_result = false;
-            int api_index = -1;
-
-            api_index = tcp_find_post_request(request);
-            if (api_index < HTTP_POST_REQ_MAX) {
-                printf("Request matches POST: %s\n", http_post_req_str[api_index]);
-            } else {
-                printf("Unsupported POST request: %s\n", request);
-                // send 404 Not Found
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_NOT_FOUND);
-                err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write unsupported request data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
-                pbuf_free(p);
+err_t tcp_route_api_set_wifi_params(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    // in this case we expect ONLY a specific type of parameters in the body
+    char *body = tcp_server_post_body(con_state);
+    return tcp_server_post_reply(con_state, pcb, body ? parse_post_specific_body(body, PARAMS_WIFI) : WLT_GENERIC_ERROR);
+}
+
+err_t tcp_route_api_set_setting_params(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    // in this case we expect ONLY a specific type of parameters in the body
+    char *body = tcp_server_post_body(con_state);
+    return tcp_server_post_reply(con_state, pcb, body ? parse_post_specific_body(body, PARAMS_SETTINGS) : WLT_GENERIC_ERROR);
+}
+
+err_t tcp_route_api_set_out_params(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    // in this case we expect ONLY a specific type of parameters in the body
+    char *body = tcp_server_post_body(con_state);
+    return tcp_server_post_reply(con_state, pcb, body ? parse_post_specific_body(body, PARAMS_OUTPUTS) : WLT_GENERIC_ERROR);
+}
+
+/*
+ * Function: tcp_route_api_commit()
+ * Description: This function saves the configuration now, without waiting for the end of the quiet
+ * period (the changes applied with ?persist=false are saved too).
+ * It returns an error code.
+ */
+err_t tcp_route_api_commit(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, const wlt_route_t *route)
+{
+    if ((prtconfig == NULL) || (pconfig == NULL)) {
+        printf("configuration is NULL\n");
+        // send 500 Internal Server Error
+        con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_INTERNAL_ERROR, tcp_conn_hdr(con_state));
+        return tcp_server_send_reply(con_state, pcb);
+    }
+    return tcp_server_send_const(con_state, pcb, tcp_server_saved_reply(wlt_commit_config()), true);
+}
+
+/*
+ * Function: tcp_ws_close()
+ * Description: This function starts the closing handshake of the WebSocket: it sends a close frame
+ * and the connection is closed when the frame is acknowledged.
+ * It returns an error code.
+ */
+static err_t tcp_ws_close(TCP_CONNECT_STATE_T *con_state, uint16_t code)
+{
+    uint8_t payload[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+
+    con_state->ws_closing = true;
+    return tcp_ws_send(con_state, WS_OPCODE_CLOSE, payload, sizeof(payload));
+}
+
+/*
+ * Function: tcp_ws_command()
+ * Description: This function applies the parameters sent by a WebSocket client in a text message
+ * (same JSON of /api/v1/setallparams) and answers with a text frame.
+ * It returns an error code.
+ */
+static err_t tcp_ws_command(TCP_CONNECT_STATE_T *con_state, char *msg, int len)
+{
+    const char *reply = API_SET_PARAMS_NACK;
+    err_t err;
+
+    printf("WebSocket command: %s\n", msg);
+    if (parse_post_body(msg, len) == WLT_SUCCESS) {
+        // Save the configuration: it's written at the end of the quiet period
+        reply = tcp_server_saved_reply(wlt_update_and_save_config(prtconfig, pconfig, true));
+    }
+    err = tcp_ws_send(con_state, WS_OPCODE_TEXT, reply, strlen(reply));
+    // the command is done anyway: a reply that doesn't fit now is lost
+    return (err == ERR_MEM) ? ERR_OK : err;
+}
+
+/*
+ * Function: tcp_ws_frame()
+ * Description: This function handles a frame received from a WebSocket client.
+ * It returns an error code.
+ */
+static err_t tcp_ws_frame(TCP_CONNECT_STATE_T *con_state)
+{
+    ws_frame_parser_t *ws = &con_state->ws_rx;
+    err_t err;
+
+    switch (ws->opcode) {
+        case WS_OPCODE_PING:
+            err = tcp_ws_send(con_state, WS_OPCODE_PONG, ws->ctrl, ws->ctrl_len);
+            return (err == ERR_MEM) ? ERR_OK : err;
+
+        case WS_OPCODE_PONG:
+            return ERR_OK;
+
+        case WS_OPCODE_CLOSE:
+            // echo the status code of the client
+            return tcp_ws_close(con_state, (ws->ctrl_len >= 2) ? (((uint8_t)ws->ctrl[0] << 8) | (uint8_t)ws->ctrl[1]) : WS_CLOSE_NORMAL);
+
+        default:
+            if (!ws_parser_message(ws)) {
+                // wait for the other fragments of the message
                 return ERR_OK;
             }
-
-            char *content_length_ptr = strstr(p->payload, "Content-Length:");
-            if (content_length_ptr != NULL) {
-                // We have content length, so we can read the body
-                char *content_length_str = content_length_ptr + 15;
-                int content_length = atoi(content_length_str);
-                printf("Content-Length: %d\n", content_length);
-                // Here we would normally read the body and process it
-                // search /r/n/r/n to find the end of headers
-                char *body = strstr(p->payload, "\r\n\r\n");
-                if (body) {
-                    body += 4; // skip the \r\n\r\n
-                    int body_length = p->tot_len - (body - (char *)p->payload);
-                    printf("Body length: %d\n", body_length);
-                    if (body_length >= content_length) {
-                        // Null-terminate the body for safety
-                        body[content_length] = 0;
-                        // We have the full body
-                        printf("Body: %.*s\n", content_length, body);
-                        // Here we would process the body content depending on the API
-                        switch (api_index)
-                        {
-                            case HTTP_API_SET_WIFI_PARAMS:
-                                // in this case we expect ONLY a specific type of parameters in the body
-                                parse_result = parse_post_specific_body(body, PARAMS_WIFI);
-                                break;
-
-                            case HTTP_API_SET_SETTING_PARAMS:
-                                // in this case we expect ONLY a specific type of parameters in the body
-                                parse_result = parse_post_specific_body(body, PARAMS_SETTINGS);
-                                break;
-
-                            case HTTP_API_SET_OUT_PARAMS:
-                                // in this case we expect ONLY a specific type of parameters in the body
-                                parse_result = parse_post_specific_body(body, PARAMS_OUTPUTS);
-                                break;
-
-                            case HTTP_API_SET_ALL_PARAMS:
-                                // in this case we need to parse all parameters that are in the body
-                                printf("Processing SET_ALL_PARAMS API request\n");
-                                parse_result = parse_post_body(body, content_length);
-                                break;
-
-                            default:
-                                printf("Unknown API POST request\n");
-                                parse_result = WLT_GENERIC_ERROR;
-                                break;
-                        }
-                    } else {
-                        printf("Incomplete body received\n");
-                        parse_result = WLT_GENERIC_ERROR;
-                    }
-                } else {
-                    printf("No body found in POST request\n");
-                    parse_result = WLT_GENERIC_ERROR;
-                }
+            if (ws->msg_opcode != WS_OPCODE_TEXT) {
+                printf("WebSocket binary messages are not supported\n");
+                return tcp_ws_close(con_state, WS_CLOSE_UNSUPPORTED);
             }
-            else {
-                printf("No Content-Length header found in POST request\n");
-                parse_result = WLT_GENERIC_ERROR;
+            return tcp_ws_command(con_state, ws->payload, ws->msg_len);
+    }
+}
+
+/*
+ * Function: tcp_ws_recv()
+ * Description: This function parses the frames received on a connection upgraded to WebSocket,
+ * walking the pbuf chain in place.
+ * It returns an error code.
+ */
+static err_t tcp_ws_recv(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *pcb, struct pbuf *p)
+{
+    ws_frame_parser_t *ws = &con_state->ws_rx;
+    err_t err = ERR_OK;
+
+    tcp_recved(pcb, p->tot_len);
+    con_state->idle_polls = 0;
+    for (struct pbuf *q = p; (q != NULL) && (err == ERR_OK); q = q->next) {
+        int off = 0;
+        // after the close frame the data is discarded
+        while ((off < q->len) && (err == ERR_OK) && !con_state->ws_closing) {
+            off += ws_parser_feed(ws, (const uint8_t *)q->payload + off, q->len - off);
+            if (ws->state == WS_PARSE_ERROR) {
+                err = tcp_ws_close(con_state, ws->close_code);
+            } else if (ws->state == WS_PARSE_DONE) {
+                err = tcp_ws_frame(con_state);
+                ws_parser_next(ws);
             }
+        }
+    }
+    pbuf_free(p);
+    if (err != ERR_OK) {
+        printf("WebSocket error %d\n", err);
+        // the data is consumed: only an aborted connection is reported to lwIP
+        return (tcp_close_client_connection(con_state, pcb, err) == ERR_ABRT) ? ERR_ABRT : ERR_OK;
+    }
+    return ERR_OK;
+}
+
+/*
+ * Function: tcp_route_method()
+ * Description: This function converts the method of the request for the router.
+ */
+static wlt_route_method_t tcp_route_method(const char *method)
+{
+    if (strcmp(HTTP_GET, method) == 0) {
+        return WLT_ROUTE_GET;
+    }
+    if (strcmp(HTTP_POST, method) == 0) {
+        return WLT_ROUTE_POST;
+    }
+    return WLT_ROUTE_NONE;
+}
+
+/*
+ * Function: tcp_server_recv()
+ * Description: This function is called when data is received from the client.
+ * The data is passed to the request parser; when the request is complete
+ * it's processed and a response is sent back to the client.
+ * Only the bytes of the request are acknowledged: the bytes after it (the next pipelined request)
+ * are kept and parsed when the reply is complete (see tcp_server_sent()).
+ * It returns an error code.
+ */
+err_t tcp_server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) 
+{
+    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
+    http_parse_state_t state;
+
+    if (!p) {
+        printf("connection closed\n");
+        return tcp_close_client_connection(con_state, pcb, ERR_OK);
+    }
+    assert(con_state && con_state->pcb == pcb);
+    if (con_state->ws) {
+        return tcp_ws_recv(con_state, pcb, p);
+    }
+    if (con_state->sse) {
+        // the event stream doesn't expect any data: it's acknowledged and dropped
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    if (con_state->busy) {
+        // the reply to the previous request is still in flight: refuse the data,
+        // lwIP will pass it again when we are ready
+        printf("tcp_server_recv: reply in progress, request deferred\n");
+        return ERR_MEM;
+    }
+    if (p->tot_len > 0) {
+        u16_t used;
 
-            if (parse_result == WLT_SUCCESS) {
+        printf("tcp_server_recv %d err %d\n", p->tot_len, err);
+        con_state->idle_polls = 0;
+
+        // the request can be split in many segments: wait until it's complete
+        state = http_parser_feed_pbuf(&con_state->req, p, &used);
+        if ((state != HTTP_PARSE_DONE) && (state != HTTP_PARSE_ERROR)) {
+            tcp_recved(pcb, p->tot_len);
+            pbuf_free(p);
+            return ERR_OK;
+        }
+        if ((state == HTTP_PARSE_DONE) && (used < p->tot_len)) {
+            // the rest belongs to the next request: it waits for the reply to this one
+            tcp_recved(pcb, used);
+            con_state->rx_pending = pbuf_free_header(p, used);
+            p = NULL;
+        } else {
+            // after a malformed request the rest of the stream is dropped
+            tcp_recved(pcb, p->tot_len);
+        }
 
-                // Save the configuration
-                wlt_update_and_save_config(prtconfig,pconfig);
+        con_state->busy = true;
+        con_state->requests++;
+        con_state->keep_alive = tcp_check_keep_alive(con_state);
 
-                // Generate content reply
-                memset(con_state->result, 0, sizeof(con_state->result));
-                printf("Filling server content for request: %s with params: %s\n", request, params ? params : "NULL");
-                con_state->result_len = fill_server_content(request, params, con_state->result, sizeof(con_state->result));
-                // send 200 OK
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS_JSON, 200, con_state->result_len,"json");
+        if (state == HTTP_PARSE_ERROR) {
+            // send 400 Bad Request, we can't trust the rest of the stream
+            con_state->keep_alive = false;
+            con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_BAD_REQUEST, tcp_conn_hdr(con_state));
+            printf("Malformed request %s", con_state->headers);
+            err = tcp_server_send_reply(con_state, pcb);
+        }
+        else {
+            // one lookup: the matched route is passed to its handler
+            const wlt_route_t *route = wlt_route_find(tcp_route_method(con_state->req.method), con_state->req.path, con_state->req.path_len);
+            if (route != NULL) {
+                printf("Request %s %s\n", con_state->req.method, route->path);
+                err = route->handler(con_state, pcb, route);
             } else {
-                // send 400 Bad Request
-                con_state->result_len = 0;
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_BAD_REQUEST);
-            }   
-            err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-            if (err != ERR_OK) {
-                printf("failed to write unsupported request data %d\n", err);
-                pbuf_free(p);
-                return tcp_close_client_connection(con_state, pcb, err);
+                // Unsupported request, send 404 Not Found
+                con_state->header_len = fmt_format(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_NOT_FOUND, tcp_conn_hdr(con_state));
+                printf("Unsupported request %s %s\n", con_state->req.method, con_state->req.path);
+                err = tcp_server_send_reply(con_state, pcb);
             }
-
-            // Send the body to the client
-            if (con_state->result_len) {
-                err = tcp_write(pcb, con_state->result, con_state->result_len, 0);
-                if (err != ERR_OK) {
-                    printf("failed to write result data %d\n", err);
-                    pbuf_free(p);
-                    return tcp_close_client_connection(con_state, pcb, err);
+            if ((con_state->pcb == pcb) && (con_state->rx_pending != NULL) && (con_state->ws || con_state->sse)) {
+                // no more requests on the connection: the frames that follow the upgrade
+                // go to the WebSocket, the event stream doesn't expect any data
+                struct pbuf *q = con_state->rx_pending;
+                con_state->rx_pending = NULL;
+                if (con_state->ws) {
+                    return tcp_ws_recv(con_state, pcb, q);
                 }
+                tcp_recved(pcb, q->tot_len);
+                pbuf_free(q);
             }
         }
-        else {
-            // Unsupported request, send 404 Not Found
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_NOT_FOUND);
-            printf("Unsupported request %s", con_state->headers);
-            err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-            if (err != ERR_OK) {
-                printf("failed to write unsupported request data %d\n", err);
-                pbuf_free(p);
-                return tcp_close_client_connection(con_state, pcb, err);
-            }
+        if (p != NULL) {
+            pbuf_free(p);
         }
-        tcp_recved(pcb, p->tot_len);
+        // the data is consumed: only an aborted connection is reported to lwIP,
+        // any other error would make it keep the pbuf (already freed)
+        return (err == ERR_ABRT) ? ERR_ABRT : ERR_OK;
     }
     pbuf_free(p);
     return ERR_OK;
 }
 
 /*
- * Function: tcp_server_sent()
- * Description: This function is called when data has been sent to the client.
- * It can be used to handle any post-send actions, such as closing the connection.
+ * Function: tcp_server_poll()
+ * Description: This function is called periodically by lwIP (every POLL_TIME_S seconds).
+ * It closes the connection when it has been idle (or the reply is stalled) for HTTP_KEEPALIVE_TIMEOUT_S seconds.
+ * On the event stream and on the WebSocket it sends a heartbeat instead, unless the client doesn't acknowledge the data.
  * It returns an error code.
 */
 static err_t tcp_server_poll(void *arg, struct tcp_pcb *pcb)
 {
     TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
     printf("tcp_server_poll_fn\n");
-    return tcp_close_client_connection(con_state, pcb, ERR_OK); // Just disconnect clent?
+    if (con_state->parked) {
+        // no new sample in time: the client gets the current data
+        if (++con_state->park_polls >= (HTTP_LONGPOLL_TIMEOUT_S / POLL_TIME_S)) {
+            return tcp_longpoll_complete(con_state, pcb);
+        }
+        return ERR_OK;
+    }
+    con_state->idle_polls++;
+    if ((con_state->sse || con_state->ws) && !con_state->ws_closing &&
+        (con_state->idle_polls >= (HTTP_KEEPALIVE_TIMEOUT_S / POLL_TIME_S)) && (con_state->ring_used == 0)) {
+        // no event for a while: a comment line (or a ping) keeps the connection (and the proxies) alive
+        err_t err;
+        con_state->idle_polls = 0;
+        if (con_state->ws) {
+            err = tcp_ws_send(con_state, WS_OPCODE_PING, NULL, 0);
+        } else {
+            err = tcp_push_write(con_state, NULL, 0, SSE_HEARTBEAT, sizeof(SSE_HEARTBEAT) - 1);
+        }
+        if (err != ERR_OK) {
+            return tcp_close_client_connection(con_state, pcb, ERR_OK);
+        }
+        return ERR_OK;
+    }
+    if (con_state->idle_polls >= (HTTP_KEEPALIVE_TIMEOUT_S / POLL_TIME_S)) {
+        printf("connection idle for %d s, closing\n", con_state->idle_polls * POLL_TIME_S);
+        return tcp_close_client_connection(con_state, pcb, ERR_OK);
+    }
+    return ERR_OK;
 }
 
 /*
  * Function: tcp_server_err()
- * Description: This function is called when an error occurs on the TCP connection.
- * It handles the error and closes the connection if necessary.
+ * Description: This function is called when an error occurs on the TCP connection
+ * (reset by the peer or aborted), after the pcb has been freed.
  * It returns nothing.
  */
 static void tcp_server_err(void *arg, err_t err)
 {
     TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    if (err != ERR_ABRT) {
-        printf("tcp_client_err_fn %d\n", err);
-        tcp_close_client_connection(con_state, con_state->pcb, err);
+    printf("tcp_client_err_fn %d\n", err);
+    // lwIP has already freed the pcb: only the slot has to be released
+    if (con_state) {
+        tcp_conn_release(con_state);
+    }
+}
+
+/*
+ * Function: tcp_server_refuse()
+ * Description: This function answers 503 Service Unavailable to a client when all the connection
+ * slots are busy, then closes the connection. The reply is sent from flash, no slot is needed.
+ * It returns an error code.
+ */
+static err_t tcp_server_refuse(struct tcp_pcb *client_pcb)
+{
+    printf("no free connection slot, sending 503\n");
+    tcp_arg(client_pcb, NULL);
+    err_t err = tcp_write(client_pcb, HTTP_RESPONSE_UNAVAILABLE, sizeof(HTTP_RESPONSE_UNAVAILABLE) - 1, 0);
+    if (err == ERR_OK) {
+        err = tcp_close(client_pcb);
+    }
+    if (err != ERR_OK) {
+        printf("failed to send 503 %d, calling abort\n", err);
+        tcp_abort(client_pcb);
+        return ERR_ABRT;
     }
+    return ERR_OK;
 }
 
 /*
@@ -1237,14 +1969,22 @@ static err_t tcp_server_accept(void *arg, struct tcp_pcb *client_pcb, err_t err)
     }
     printf("client connected\n");
 
-    // Create the state for the connection
-    TCP_CONNECT_STATE_T *con_state = calloc(1, sizeof(TCP_CONNECT_STATE_T));
+    // Take a slot for the connection, shedding the oldest idle persistent connection if none is free
+    TCP_CONNECT_STATE_T *con_state = tcp_conn_acquire();
     if (!con_state) {
-        printf("failed to allocate connect state\n");
-        return ERR_MEM;
+        TCP_CONNECT_STATE_T *idle = tcp_conn_oldest_idle();
+        if (idle) {
+            printf("no free connection slot, closing idle connection\n");
+            tcp_close_client_connection(idle, idle->pcb, ERR_OK);
+            con_state = tcp_conn_acquire();
+        }
+    }
+    if (!con_state) {
+        return tcp_server_refuse(client_pcb);
     }
     con_state->pcb = client_pcb; // for checking
     con_state->gw = &state->gw;
+    tcp_server_reset_state(con_state);
 
     // setup connection to client
     tcp_arg(client_pcb, con_state);
@@ -1279,7 +2019,10 @@ bool tcp_server_open(void *arg, const char *ap_name)
         return false;
     }
 
-    state->server_pcb = tcp_listen_with_backlog(pcb, 1);
+    if (!tcp_conn_pool_ready) {
+        tcp_conn_pool_init();
+    }
+    state->server_pcb = tcp_listen_with_backlog(pcb, WLT_HTTP_BACKLOG);
     if (!state->server_pcb) {
         printf("failed to listen\n");
         if (pcb) {
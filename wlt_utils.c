@@ -1,14 +1,6 @@
 #include "include/wlt.h"
 #include "include/wlt_global.h"
 
-/*
- * Function: C2F(temperature)
- * Convert Celsius to Fahrenheit scale
-*/
-float C2F(float temperature) {
-    return temperature * (9.0f / 5) + 32;
-}
-
 /*
  * Function: check_wifi_password()
  * Description: This function checks if the provided Wi-Fi password is valid.
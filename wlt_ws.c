@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <string.h>
+#include "include/wlt_ws.h"
+
+static const char ws_base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*
+ * Function: ws_rol()
+ * Description: This function rotates a 32 bit word to the left.
+ */
+static inline uint32_t ws_rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+/*
+ * Function: ws_sha1_block()
+ * Description: This function processes a 64 bytes block of the SHA-1.
+ * The message schedule is kept in 16 words (rolling) to save stack.
+ */
+static void ws_sha1_block(uint32_t h[5], const uint8_t *block)
+{
+    uint32_t w[16];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | (uint32_t)block[4 * i + 3];
+    }
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k, t;
+        if (i >= 16) {
+            w[i & 15] = ws_rol(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        t = ws_rol(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = ws_rol(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/*
+ * Function: ws_sha1()
+ * Description: This function computes the SHA-1 digest (20 bytes) of a short message.
+ * It's used only for the handshake, so the whole message is in memory.
+ */
+static void ws_sha1(const uint8_t *data, size_t len, uint8_t digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t block[64];
+    uint64_t bits = (uint64_t)len * 8;
+    size_t i;
+
+    for (i = 0; i + 64 <= len; i += 64) {
+        ws_sha1_block(h, data + i);
+    }
+    // last block(s): remaining bytes, 0x80, padding and length in bits (big endian)
+    memset(block, 0, sizeof(block));
+    memcpy(block, data + i, len - i);
+    block[len - i] = 0x80;
+    if (len - i >= 56) {
+        ws_sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    for (int j = 0; j < 8; j++) {
+        block[63 - j] = (uint8_t)(bits >> (8 * j));
+    }
+    ws_sha1_block(h, block);
+
+    for (int j = 0; j < 5; j++) {
+        digest[4 * j] = (uint8_t)(h[j] >> 24);
+        digest[4 * j + 1] = (uint8_t)(h[j] >> 16);
+        digest[4 * j + 2] = (uint8_t)(h[j] >> 8);
+        digest[4 * j + 3] = (uint8_t)h[j];
+    }
+}
+
+/*
+ * Function: ws_base64()
+ * Description: This function encodes data in base64 (with padding).
+ * It returns the length of the string, or -1 if the output buffer is too small.
+ */
+static int ws_base64(const uint8_t *data, size_t len, char *out, size_t max)
+{
+    size_t n = 0;
+
+    if (((len + 2) / 3) * 4 + 1 > max) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)data[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            v |= data[i + 2];
+        }
+        out[n++] = ws_base64_chars[(v >> 18) & 0x3F];
+        out[n++] = ws_base64_chars[(v >> 12) & 0x3F];
+        out[n++] = (i + 1 < len) ? ws_base64_chars[(v >> 6) & 0x3F] : '=';
+        out[n++] = (i + 2 < len) ? ws_base64_chars[v & 0x3F] : '=';
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/*
+ * Function: ws_accept_key()
+ * Description: This function computes the value of the Sec-WebSocket-Accept header from the
+ * Sec-WebSocket-Key of the request: base64(SHA-1(key + GUID)).
+ * It returns false if the key is not valid.
+ */
+bool ws_accept_key(const char *key, char *accept, size_t max)
+{
+    char buf[WS_KEY_MAX_LEN + sizeof(WS_GUID)];
+    uint8_t digest[20];
+    size_t len = strlen(key);
+
+    // trailing spaces are not part of the header value
+    while ((len > 0) && ((key[len - 1] == ' ') || (key[len - 1] == '\t'))) {
+        len--;
+    }
+    if ((len == 0) || (len >= WS_KEY_MAX_LEN)) {
+        return false;
+    }
+    memcpy(buf, key, len);
+    memcpy(buf + len, WS_GUID, sizeof(WS_GUID) - 1);
+    ws_sha1((const uint8_t *)buf, len + sizeof(WS_GUID) - 1, digest);
+    return ws_base64(digest, sizeof(digest), accept, max) == WS_ACCEPT_LEN;
+}
+
+/*
+ * Function: ws_parser_init()
+ * Description: This function initializes the parser to receive the frames of a new connection.
+ */
+void ws_parser_init(ws_frame_parser_t *ws)
+{
+    memset(ws, 0, sizeof(ws_frame_parser_t));
+    ws->state = WS_PARSE_HDR;
+    ws->msg_opcode = WS_OPCODE_CONT;
+}
+
+/*
+ * Function: ws_parser_error()
+ * Description: This function stops the parser: the connection must be closed with the given code.
+ */
+static void ws_parser_error(ws_frame_parser_t *ws, uint16_t close_code)
+{
+    printf("WebSocket frame error %d\n", close_code);
+    ws->state = WS_PARSE_ERROR;
+    ws->close_code = close_code;
+}
+
+/*
+ * Function: ws_parser_header()
+ * Description: This function decodes and checks the first two bytes of a frame.
+ */
+static void ws_parser_header(ws_frame_parser_t *ws)
+{
+    uint8_t len = ws->hdr[1] & 0x7F;
+
+    ws->fin = (ws->hdr[0] & 0x80) != 0;
+    ws->opcode = ws->hdr[0] & 0x0F;
+    if ((ws->hdr[0] & 0x70) != 0) {
+        // no extension negotiated: the RSV bits must be 0
+        ws_parser_error(ws, WS_CLOSE_PROTOCOL_ERROR);
+        return;
+    }
+    if ((ws->hdr[1] & 0x80) == 0) {
+        // the frames sent by the client must be masked
+        ws_parser_error(ws, WS_CLOSE_PROTOCOL_ERROR);
+        return;
+    }
+    if (ws->opcode & 0x08) {
+        if ((ws->opcode > WS_OPCODE_PONG) || !ws->fin || (len > WS_CTRL_MAX_LEN)) {
+            ws_parser_error(ws, WS_CLOSE_PROTOCOL_ERROR);
+            return;
+        }
+    } else if ((ws->opcode > WS_OPCODE_BINARY) ||
+               ((ws->opcode == WS_OPCODE_CONT) && (ws->msg_opcode == WS_OPCODE_CONT)) ||
+               ((ws->opcode != WS_OPCODE_CONT) && (ws->msg_opcode != WS_OPCODE_CONT))) {
+        // unknown opcode, continuation without a message or new message inside a fragmented one
+        ws_parser_error(ws, WS_CLOSE_PROTOCOL_ERROR);
+        return;
+    }
+    ws->len_size = (len == 126) ? 2 : ((len == 127) ? 8 : 0);
+    ws->len = (ws->len_size == 0) ? len : 0;
+    ws->pos = 0;
+    ws->state = (ws->len_size == 0) ? WS_PARSE_MASK : WS_PARSE_LEN;
+}
+
+/*
+ * Function: ws_parser_complete()
+ * Description: This function is called when the payload of the frame has been received.
+ */
+static void ws_parser_complete(ws_frame_parser_t *ws)
+{
+    if (ws->opcode & 0x08) {
+        ws->ctrl_len = ws->len;
+    } else {
+        if (ws->opcode != WS_OPCODE_CONT) {
+            ws->msg_opcode = ws->opcode;
+        }
+        ws->msg_len += ws->len;
+    }
+    ws->state = WS_PARSE_DONE;
+}
+
+/*
+ * Function: ws_parser_feed()
+ * Description: This function parses a block of data received from the client.
+ * It can be called many times, the parsing continues from the point where it stopped.
+ * It stops at the end of each frame (WS_PARSE_DONE): the caller handles the frame, calls
+ * ws_parser_next() and feeds the rest of the data.
+ * It returns the number of bytes used.
+ */
+int ws_parser_feed(ws_frame_parser_t *ws, const uint8_t *data, int len)
+{
+    int i = 0;
+
+    while ((i < len) && (ws->state != WS_PARSE_DONE) && (ws->state != WS_PARSE_ERROR)) {
+        switch (ws->state) {
+            case WS_PARSE_HDR:
+                ws->hdr[ws->pos++] = data[i++];
+                if (ws->pos == sizeof(ws->hdr)) {
+                    ws_parser_header(ws);
+                }
+                break;
+
+            case WS_PARSE_LEN:
+                ws->len = (ws->len << 8) | data[i++];
+                if (++ws->pos == ws->len_size) {
+                    ws->pos = 0;
+                    ws->state = WS_PARSE_MASK;
+                }
+                break;
+
+            case WS_PARSE_MASK:
+                ws->mask[ws->pos++] = data[i++];
+                if (ws->pos == sizeof(ws->mask)) {
+                    if (!(ws->opcode & 0x08) && (ws->len > (uint64_t)(WS_MSG_MAX_LEN - 1 - ws->msg_len))) {
+                        ws_parser_error(ws, WS_CLOSE_TOO_BIG);
+                        break;
+                    }
+                    ws->done = 0;
+                    if (ws->len == 0) {
+                        ws_parser_complete(ws);
+                    } else {
+                        ws->state = WS_PARSE_PAYLOAD;
+                    }
+                }
+                break;
+
+            case WS_PARSE_PAYLOAD:
+                {
+                    // copy (and unmask) as much payload as available in one step
+                    char *dest = (ws->opcode & 0x08) ? ws->ctrl : (ws->payload + ws->msg_len);
+                    int n = len - i;
+                    if ((uint64_t)n > ws->len - ws->done) {
+                        n = ws->len - ws->done;
+                    }
+                    for (int k = 0; k < n; k++) {
+                        dest[ws->done + k] = data[i + k] ^ ws->mask[(ws->done + k) & 3];
+                    }
+                    ws->done += n;
+                    i += n;
+                    if (ws->done == ws->len) {
+                        ws_parser_complete(ws);
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+    return i;
+}
+
+/*
+ * Function: ws_parser_message()
+ * Description: This function checks if the frame just parsed completes a data message.
+ * The message (in payload, msg_len bytes) is terminated to be used as a string.
+ */
+bool ws_parser_message(ws_frame_parser_t *ws)
+{
+    if ((ws->state != WS_PARSE_DONE) || (ws->opcode & 0x08) || !ws->fin) {
+        return false;
+    }
+    ws->payload[ws->msg_len] = '\0';
+    return true;
+}
+
+/*
+ * Function: ws_parser_next()
+ * Description: This function prepares the parser for the next frame.
+ * The message being collected is kept until its last fragment has been handled.
+ */
+void ws_parser_next(ws_frame_parser_t *ws)
+{
+    if (!(ws->opcode & 0x08) && ws->fin) {
+        ws->msg_opcode = WS_OPCODE_CONT;
+        ws->msg_len = 0;
+    }
+    ws->state = WS_PARSE_HDR;
+    ws->pos = 0;
+}
+
+/*
+ * Function: ws_frame_header()
+ * Description: This function writes the header of a frame sent by the server
+ * (single fragment, not masked, payload shorter than 64KB).
+ * It returns the length of the header.
+ */
+int ws_frame_header(uint8_t *hdr, uint8_t opcode, size_t len)
+{
+    hdr[0] = 0x80 | opcode;
+    if (len < 126) {
+        hdr[1] = (uint8_t)len;
+        return 2;
+    }
+    hdr[1] = 126;
+    hdr[2] = (uint8_t)(len >> 8);
+    hdr[3] = (uint8_t)len;
+    return 4;
+}